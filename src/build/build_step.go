@@ -113,7 +113,7 @@ func prepareOnly(tid int, state *core.BuildState, target *core.BuildTarget) erro
 	if err := prepareDirectories(state.ProcessExecutor, target); err != nil {
 		return err
 	}
-	if err := prepareSources(state.Graph, target); err != nil {
+	if err := prepareSources(state.Graph, target, false); err != nil {
 		return err
 	}
 	// This is important to catch errors here where we will recover the panic, rather
@@ -156,7 +156,10 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 	// This must run before we can leave this function successfully by any path.
 	if target.PreBuildFunction != nil {
 		log.Debug("Running pre-build function for %s", target.Label)
-		if err := state.Parser.RunPreBuildFunction(tid, state, target); err != nil {
+		done := tracePhase(tid, state, target, "pre_build")
+		err := state.Parser.RunPreBuildFunction(tid, state, target)
+		done()
+		if err != nil {
 			return err
 		}
 		log.Debug("Finished pre-build function for %s", target.Label)
@@ -168,8 +171,9 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 	}
 
 	var postBuildOutput string
-	var cacheKey []byte
+	var cacheKey, contentKey []byte
 	var metadata *core.BuildMetadata
+	useCache := state.Cache != nil && !target.HasLabel(core.NoCacheLabel)
 
 	if target.HasLabel("go") {
 		// Create a dummy go.mod file so Go tooling ignores the contents of plz-out.
@@ -198,7 +202,7 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 			// changes from the build metadata and check if we need to build the target again
 			if target.BuildCouldModifyTarget() {
 				// needsBuilding checks that the metadata file exists so this is safe
-				metadata, err = loadTargetMetadata(target)
+				metadata, err = LoadTargetMetadata(target)
 				if err != nil {
 					return fmt.Errorf("failed to load build metadata for %s: %w", target.Label, err)
 				}
@@ -253,7 +257,7 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 		oldOutputHash := outputHashOrNil(target, target.FullOutputs(), state.PathHasher, state.PathHasher.NewHash)
 		cacheKey = mustShortTargetHash(state, target)
 
-		if state.Cache != nil && !runRemotely && !state.ShouldRebuild(target) {
+		if useCache && !runRemotely && !state.ShouldRebuild(target) {
 			// Note that ordering here is quite sensitive since the post-build function can modify
 			// what we would retrieve from the cache.
 			if target.BuildCouldModifyTarget() {
@@ -267,11 +271,11 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 						}
 					}
 					// Now that we've updated the rule, retrieve the artifacts with the new output hash
-					if retrieveArtifacts(tid, state, target, oldOutputHash) {
+					if retrieveArtifacts(tid, state, target, oldOutputHash, mustShortTargetHash(state, target)) {
 						return writeRuleHash(state, target)
 					}
 				}
-			} else if retrieveArtifacts(tid, state, target, oldOutputHash) {
+			} else if retrieveArtifacts(tid, state, target, oldOutputHash, cacheKey) {
 				return nil
 			}
 		}
@@ -279,12 +283,27 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 			return err
 		}
 		state.LogBuildResult(tid, target, core.TargetBuilding, "Preparing...")
-		if err := prepareSources(state.Graph, target); err != nil {
+		done := tracePhase(tid, state, target, "prepare_sources")
+		overlay := core.UsesSandboxOverlay(state, target)
+		var err error
+		if overlay {
+			err = prepareDirectory(state.ProcessExecutor, core.SandboxOverlayDir(target), true)
+		}
+		if err == nil {
+			err = prepareSources(state.Graph, target, overlay)
+		}
+		done()
+		if err != nil {
 			return fmt.Errorf("Error preparing sources for %s: %s", target.Label, err)
 		}
+		if useCache && !state.ShouldRebuild(target) && !target.BuildCouldModifyTarget() {
+			if contentKey = contentCacheKey(state, target); contentKey != nil && retrieveArtifacts(tid, state, target, oldOutputHash, contentKey) {
+				return nil
+			}
+		}
 
 		state.LogBuildResult(tid, target, core.TargetBuilding, target.BuildingDescription)
-		metadata, err = buildMaybeRemotely(state, target, cacheKey)
+		metadata, err = buildMaybeRemotely(tid, state, target, cacheKey)
 		if err != nil {
 			return err
 		}
@@ -300,11 +319,20 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 		if err != nil {
 			return err
 		}
+
+		if target.Depfile != "" {
+			if metadata.UsedInputs, metadata.UsedInputsHash, err = usedInputs(state, target); err != nil {
+				log.Warning("Failed to record used inputs for %s: %s", target.Label, err)
+			}
+		}
 	}
 
 	if target.PostBuildFunction != nil {
 		outs := target.Outputs()
-		if err := runPostBuildFunction(tid, state, target, string(metadata.Stdout), postBuildOutput); err != nil {
+		done := tracePhase(tid, state, target, "post_build")
+		err := runPostBuildFunction(tid, state, target, string(metadata.Stdout), postBuildOutput)
+		done()
+		if err != nil {
 			return err
 		}
 
@@ -340,7 +368,9 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 	}
 
 	state.LogBuildResult(tid, target, core.TargetBuilding, "Collecting outputs...")
+	done := tracePhase(tid, state, target, "collect_outputs")
 	outs, outputsChanged, err := moveOutputs(state, target)
+	done()
 	if err != nil {
 		return fmt.Errorf("error moving outputs for target %s: %w", target.Label, err)
 	}
@@ -353,8 +383,9 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 		target.SetState(core.Unchanged)
 	}
 	buildLinks(state, target)
-	if state.Cache != nil {
+	if useCache {
 		state.LogBuildResult(tid, target, core.TargetBuilding, "Storing...")
+		done := tracePhase(tid, state, target, "cache_store")
 		newCacheKey := mustShortTargetHash(state, target)
 
 		// If the build could modify the target, store the metadata in the cache based on the original state of the
@@ -368,12 +399,24 @@ func buildTarget(tid int, state *core.BuildState, target *core.BuildTarget, runR
 			}
 		}
 		storeInCache(state.Cache, target, newCacheKey, outs)
+		if contentKey != nil {
+			storeInCache(state.Cache, target, contentKey, outs)
+		}
+		done()
 	}
 	// Clean up the temporary directory once it's done.
 	if state.CleanWorkdirs {
 		if err := fs.ForceRemove(state.ProcessExecutor, target.TmpDir()); err != nil {
 			log.Warning("Failed to remove temporary directory for %s: %s", target.Label, err)
 		}
+		if core.UsesSandboxOverlay(state, target) {
+			if err := fs.ForceRemove(state.ProcessExecutor, target.TmpDir()+".work"); err != nil {
+				log.Warning("Failed to remove overlay work directory for %s: %s", target.Label, err)
+			}
+			if err := fs.ForceRemove(state.ProcessExecutor, core.SandboxOverlayDir(target)); err != nil {
+				log.Warning("Failed to remove overlay input directory for %s: %s", target.Label, err)
+			}
+		}
 	}
 	if outputsChanged {
 		state.LogBuildResult(tid, target, core.TargetBuilt, "Built")
@@ -402,7 +445,7 @@ func addOutDirOutsFromMetadata(target *core.BuildTarget, md *core.BuildMetadata)
 func retrieveFromCache(cache core.Cache, target *core.BuildTarget, cacheKey []byte, files []string) *core.BuildMetadata {
 	files = append(files, target.TargetBuildMetadataFileName())
 	if ok := cache.Retrieve(target, cacheKey, files); ok {
-		md, err := loadTargetMetadata(target)
+		md, err := LoadTargetMetadata(target)
 		if err != nil {
 			log.Debugf("failed to retrieve %s build metadata from cache: %v", target.Label, err)
 			return nil
@@ -419,9 +462,9 @@ func storeInCache(cache core.Cache, target *core.BuildTarget, key []byte, files
 
 // retrieveArtifacts attempts to retrieve artifacts from the cache
 //   1) if there are no declared outputs, return true; there's nothing to be done
-//   2) pull all the declared outputs from the cache has based on the short hash of the target
+//   2) pull all the declared outputs from the cache based on the given key (usually the short hash of the target)
 //   3) check that pulling the artifacts changed the output hash and set the build state accordingly
-func retrieveArtifacts(tid int, state *core.BuildState, target *core.BuildTarget, oldOutputHash []byte) bool {
+func retrieveArtifacts(tid int, state *core.BuildState, target *core.BuildTarget, oldOutputHash, cacheKey []byte) bool {
 	// If there aren't any outputs, we don't have to do anything right now.
 	// Checks later will handle the case of something with a post-build function that
 	// later tries to add more outputs.
@@ -431,8 +474,7 @@ func retrieveArtifacts(tid int, state *core.BuildState, target *core.BuildTarget
 		return true
 	}
 	state.LogBuildResult(tid, target, core.TargetBuilding, "Checking cache...")
-
-	cacheKey := mustShortTargetHash(state, target)
+	defer tracePhase(tid, state, target, "cache_retrieve")()
 
 	if md := retrieveFromCache(state.Cache, target, cacheKey, target.Outputs()); md != nil {
 		// Retrieve additional optional outputs from metadata
@@ -473,7 +515,8 @@ func retrieveArtifacts(tid int, state *core.BuildState, target *core.BuildTarget
 
 // runBuildCommand runs the actual command to build a target.
 // On success it returns the stdout of the target, otherwise an error.
-func runBuildCommand(state *core.BuildState, target *core.BuildTarget, command string, inputHash []byte) ([]byte, error) {
+// The resources used by the command are recorded in the given metadata.
+func runBuildCommand(tid int, state *core.BuildState, target *core.BuildTarget, command string, inputHash []byte, metadata *core.BuildMetadata) ([]byte, error) {
 	if target.IsRemoteFile {
 		return nil, fetchRemoteFile(state, target)
 	}
@@ -482,7 +525,17 @@ func runBuildCommand(state *core.BuildState, target *core.BuildTarget, command s
 	}
 	env := core.StampedBuildEnvironment(state, target, inputHash, path.Join(core.RepoRoot, target.TmpDir()), target.Stamp)
 	log.Debug("Building target %s\nENVIRONMENT:\n%s\n%s", target.Label, env, command)
-	out, combined, err := state.ProcessExecutor.ExecWithTimeoutShell(target, target.TmpDir(), env, target.BuildTimeout, state.ShowAllOutput, process.NewSandboxConfig(target.Sandbox, target.Sandbox), command)
+	// Memory's taken first so we don't hold CPUs that others could use while we wait for it.
+	defer state.AcquireMemory(target)()
+	defer state.AcquireCPUs(target)()
+	defer tracePhase(tid, state, target, "command")()
+	recorder := &process.UsageRecordingTarget{Target: target}
+	start := time.Now()
+	out, combined, err := state.ProcessExecutor.ExecWithTimeoutShell(recorder, target.TmpDir(), env, target.BuildTimeout, state.ShowAllOutput, process.NewSandboxConfig(target.Sandbox, target.Sandbox), command)
+	metadata.ResourceUsage = metadata.ResourceUsage.Add(recorder.Usage)
+	state.RecordMemory(target, recorder.Usage.MaxRSS)
+	state.RecordDuration(target, time.Since(start))
+	recordActionTraces(tid, state, target, start)
 	if err != nil {
 		return nil, fmt.Errorf("Error building target %s: %s\n%s", target.Label, err, combined)
 	}
@@ -560,8 +613,13 @@ func prepareDirectory(executor *process.Executor, directory string, remove bool)
 }
 
 // Symlinks the source files of this rule into its temp directory.
-func prepareSources(graph *core.BuildGraph, target *core.BuildTarget) error {
+// If overlay is true, outputs of other targets are linked into the overlay's input directory
+// instead, which the sandbox mounts underneath the temp directory.
+func prepareSources(graph *core.BuildGraph, target *core.BuildTarget, overlay bool) error {
 	for source := range core.IterSources(graph, target, false) {
+		if overlay && isOverlaidSource(target, source) {
+			source.Tmp = path.Join(core.SandboxOverlayDir(target), strings.TrimPrefix(source.Tmp, target.TmpDir()+"/"))
+		}
 		if err := core.PrepareSourcePair(source); err != nil {
 			return err
 		}
@@ -571,9 +629,25 @@ func prepareSources(graph *core.BuildGraph, target *core.BuildTarget) error {
 			return err
 		}
 	}
+	if target.HasLabel(core.LinkInputsLabel) {
+		if err := fs.WriteFile(bytes.NewReader(core.LinkInputsFile(graph, target)), path.Join(target.TmpDir(), core.LinkInputsFileName), 0644); err != nil {
+			return err
+		}
+	}
 	return nil
 }
 
+// isOverlaidSource returns true if the given source is an output of another target that will appear at
+// its location in the temp directory via the sandbox's overlay.
+func isOverlaidSource(target *core.BuildTarget, source core.SourcePair) bool {
+	for _, dir := range []string{core.GenDir, core.BinDir} {
+		if strings.HasPrefix(source.Src, dir+"/") {
+			return source.Tmp == path.Join(target.TmpDir(), strings.TrimPrefix(source.Src, dir+"/"))
+		}
+	}
+	return false
+}
+
 // addOutputDirectoriesToBuildOutput moves all the files from the output dirs into the root of the build temp dir
 // and adds them as outputs to the build target
 func addOutputDirectoriesToBuildOutput(target *core.BuildTarget) ([]string, error) {
@@ -1117,14 +1191,14 @@ func (r *progressReader) Read(b []byte) (int, error) {
 
 // buildMaybeRemotely builds a target, either sending it to a remote worker if needed,
 // or locally if not.
-func buildMaybeRemotely(state *core.BuildState, target *core.BuildTarget, inputHash []byte) (*core.BuildMetadata, error) {
+func buildMaybeRemotely(tid int, state *core.BuildState, target *core.BuildTarget, inputHash []byte) (*core.BuildMetadata, error) {
 	metadata := new(core.BuildMetadata)
 
 	workerCmd, workerArgs, localCmd, err := core.WorkerCommandAndArgs(state, target)
 	if err != nil {
 		return nil, err
 	} else if workerCmd == "" {
-		metadata.Stdout, err = runBuildCommand(state, target, localCmd, inputHash)
+		metadata.Stdout, err = runBuildCommand(tid, state, target, localCmd, inputHash, metadata)
 		return metadata, err
 	}
 	// The scheme here is pretty minimal; remote workers currently have quite a bit less info than
@@ -1162,7 +1236,7 @@ func buildMaybeRemotely(state *core.BuildState, target *core.BuildTarget, inputH
 	}
 	// Okay, now we might need to do something locally too...
 	if localCmd != "" {
-		out2, err := runBuildCommand(state, target, localCmd, inputHash)
+		out2, err := runBuildCommand(tid, state, target, localCmd, inputHash, metadata)
 		metadata.Stdout = append([]byte(out+"\n"), out2...)
 		return metadata, err
 	}
@@ -8,6 +8,7 @@
 package build
 
 import (
+	"bytes"
 	"encoding/hex"
 	"fmt"
 	"io"
@@ -30,6 +31,9 @@ import (
 
 var cache core.Cache
 
+// retrievableKey is the only key that the mock cache will retrieve //package1:cachekey for.
+var retrievableKey []byte
+
 func TestBuildTargetWithNoDeps(t *testing.T) {
 	state, target := newState("//package1:target1")
 	target.AddOutput("file1")
@@ -135,7 +139,7 @@ func TestOutputDir(t *testing.T) {
 	require.NoError(t, err)
 	assert.Equal(t, []string{"file7"}, target.Outputs())
 
-	md, err := loadTargetMetadata(target)
+	md, err := LoadTargetMetadata(target)
 	require.NoError(t, err)
 
 	assert.Len(t, md.OutputDirOuts, 1)
@@ -170,7 +174,7 @@ func TestOutputDirDoubleStar(t *testing.T) {
 	require.NoError(t, err)
 	assert.Equal(t, []string{"foo"}, target.Outputs())
 
-	md, err := loadTargetMetadata(target)
+	md, err := LoadTargetMetadata(target)
 	require.NoError(t, err)
 
 	assert.Len(t, md.OutputDirOuts, 1)
@@ -191,6 +195,16 @@ func TestOutputDirDoubleStar(t *testing.T) {
 	assert.Equal(t, info.Mode().Perm().String(), "-rwxrwxrwx")
 }
 
+func TestIsOverlaidSource(t *testing.T) {
+	_, target := newState("//package1:target9")
+	tmp := target.TmpDir()
+	assert.True(t, isOverlaidSource(target, core.SourcePair{Src: "plz-out/gen/package2/file.h", Tmp: tmp + "/package2/file.h"}))
+	assert.True(t, isOverlaidSource(target, core.SourcePair{Src: "plz-out/bin/package2/tool", Tmp: tmp + "/package2/tool"}))
+	// Sources from the repo aren't overlaid, nor are outputs that are staged at a different location.
+	assert.False(t, isOverlaidSource(target, core.SourcePair{Src: "package1/file.cc", Tmp: tmp + "/package1/file.cc"}))
+	assert.False(t, isOverlaidSource(target, core.SourcePair{Src: "plz-out/gen/package2/file.h", Tmp: tmp + "/file.h"}))
+}
+
 func TestCacheRetrieval(t *testing.T) {
 	// Test retrieving stuff from the cache
 	state, target := newState("//package1:target8")
@@ -202,6 +216,25 @@ func TestCacheRetrieval(t *testing.T) {
 	assert.Equal(t, core.Cached, target.State())
 }
 
+func TestCacheRetrievalByContentKey(t *testing.T) {
+	// The rule hash of this target isn't in the cache, but the key from its cache key command is.
+	state, target := newState("//package1:cachekey")
+	target.AddOutput("file_cachekey")
+	target.Command = "false" // Will fail if we try to build it.
+	target.CacheKeyCommand = "echo 'same output'"
+	state.Cache = cache
+	retrievableKey = contentCacheKey(state, target)
+	require.NotNil(t, retrievableKey)
+	err := buildTarget(1, state, target, false)
+	assert.NoError(t, err)
+	assert.Equal(t, core.Cached, target.State())
+
+	target.CacheKeyCommand = "echo 'different output'"
+	assert.NotEqual(t, retrievableKey, contentCacheKey(state, target))
+	target.CacheKeyCommand = "false"
+	assert.Nil(t, contentCacheKey(state, target))
+}
+
 func TestPostBuildFunctionAndCache(t *testing.T) {
 	// Test the often subtle and quick to anger interaction of post-build function and cache.
 	// In this case when it fails to retrieve the post-build output it should still call the function after building.
@@ -430,11 +463,26 @@ func TestBuildMetadatafileIsCreated(t *testing.T) {
 	require.NoError(t, err)
 	assert.True(t, target.BuildCouldModifyTarget())
 	assert.True(t, fs.FileExists(filepath.Join(target.OutDir(), target.TargetBuildMetadataFileName())))
-	md, err := loadTargetMetadata(target)
+	md, err := LoadTargetMetadata(target)
 	require.NoError(t, err)
 	assert.Equal(t, stdOut, string(md.Stdout))
 }
 
+func TestDepfileRecordsUsedInputs(t *testing.T) {
+	state, target := newState("//package1:depfile")
+	target.AddSource(core.FileLabel{File: "src5", Package: "package1"})
+	target.AddSource(core.FileLabel{File: "BUILD_FILE", Package: "package1"})
+	target.AddOutput("file1")
+	target.Depfile = "*.d"
+	target.Command = "echo 'file1: package1/src5 /usr/include/stdio.h' > file1.d && touch $OUT"
+	err := buildTarget(rand.Int(), state, target, false)
+	require.NoError(t, err)
+	md, err := LoadTargetMetadata(target)
+	require.NoError(t, err)
+	assert.Equal(t, []string{"package1/src5"}, md.UsedInputs)
+	assert.True(t, usedInputsUnchanged(state, target))
+}
+
 // Should return the hash of the first item
 func TestSha1SingleHash(t *testing.T) {
 	testCases := []struct {
@@ -559,6 +607,12 @@ func (*mockCache) Retrieve(target *core.BuildTarget, key []byte, outputs []strin
 			panic(err)
 		}
 		return true
+	} else if target.Label.Name == "cachekey" && bytes.Equal(key, retrievableKey) {
+		ioutil.WriteFile("plz-out/gen/package1/file_cachekey", []byte("retrieved from cache"), 0664)
+		if err := StoreTargetMetadata(target, &core.BuildMetadata{}); err != nil {
+			panic(err)
+		}
+		return true
 	} else if target.Label.Name == "target10" {
 		ioutil.WriteFile("plz-out/gen/package1/file10", []byte("retrieved from cache"), 0664)
 		md := &core.BuildMetadata{Stdout: []byte("retrieved from cache")}
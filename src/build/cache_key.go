@@ -0,0 +1,37 @@
+// Support for rules that can describe their outputs more precisely than their rule hash does.
+//
+// A rule can give a command whose output determines what it'll build, for example a compile step
+// can print its preprocessed source. Outputs are stored in the cache under a hash of that as well
+// as the rule hash, so they can be retrieved again after changes to the inputs that don't alter
+// it (e.g. to comments or whitespace in a header), even from other branches or machines.
+
+package build
+
+import (
+	"crypto/sha1"
+	"path"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/process"
+)
+
+// contentCacheKey runs the target's cache key command and returns the key derived from it.
+// It returns nil if the target doesn't have one or it fails, in which case it should just be built.
+// The target's sources must already be prepared in its temporary directory.
+func contentCacheKey(state *core.BuildState, target *core.BuildTarget) []byte {
+	command := target.GetCacheKeyCommand(state)
+	if command == "" {
+		return nil
+	}
+	env := core.BuildEnvironment(state, target, path.Join(core.RepoRoot, target.TmpDir()))
+	out, combined, err := state.ProcessExecutor.ExecWithTimeoutShell(target, target.TmpDir(), env, target.BuildTimeout, false, process.NewSandboxConfig(target.Sandbox, target.Sandbox), command)
+	if err != nil {
+		log.Debug("Cache key command for %s failed, will build it: %s\n%s", target.Label, err, combined)
+		return nil
+	}
+	h := sha1.New()
+	h.Write([]byte(target.GetCommand(state)))
+	h.Write(state.Hashes.Config)
+	h.Write(out)
+	return h.Sum(nil)
+}
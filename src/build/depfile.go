@@ -0,0 +1,176 @@
+// Support for rules that report which of their inputs they actually used.
+//
+// Compilers can write a Make-style dependency file listing every file they read; for rules that
+// need transitive dependencies this is usually a far smaller set than what we give them, so
+// recording it lets us avoid rebuilding when some unrelated input changes.
+
+package build
+
+import (
+	"bufio"
+	"bytes"
+	"crypto/sha1"
+	"fmt"
+	"io"
+	"os"
+	"path"
+	"sort"
+	"strings"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/fs"
+)
+
+// parseDepfile parses a Make-format dependency file and returns all the prerequisites it names.
+// Targets (i.e. anything before the colon on each rule) are ignored.
+func parseDepfile(r io.Reader) ([]string, error) {
+	var deps []string
+	var word strings.Builder
+	inPrereqs := false
+	br := bufio.NewReader(r)
+	flush := func() {
+		if word.Len() > 0 && inPrereqs {
+			deps = append(deps, word.String())
+		}
+		word.Reset()
+	}
+	for {
+		c, err := br.ReadByte()
+		if err == io.EOF {
+			flush()
+			return deps, nil
+		} else if err != nil {
+			return nil, err
+		}
+		switch c {
+		case '\\':
+			next, err := br.ReadByte()
+			if err == io.EOF {
+				flush()
+				return deps, nil
+			} else if err != nil {
+				return nil, err
+			} else if next == '\n' {
+				flush() // Line continuation
+			} else if next == '\r' {
+				br.ReadByte() // Line continuation with a CRLF
+				flush()
+			} else if next == ' ' || next == '#' || next == '\\' {
+				word.WriteByte(next)
+			} else {
+				word.WriteByte(c)
+				word.WriteByte(next)
+			}
+		case '$':
+			if next, _ := br.Peek(1); len(next) == 1 && next[0] == '$' {
+				br.ReadByte()
+			}
+			word.WriteByte(c)
+		case ':':
+			if inPrereqs {
+				word.WriteByte(c)
+			} else if next, _ := br.Peek(1); len(next) == 1 && next[0] != ' ' && next[0] != '\n' && next[0] != '\t' && next[0] != '\r' {
+				word.WriteByte(c) // Not a separator, e.g. a Windows drive letter
+			} else {
+				word.Reset()
+				inPrereqs = true
+			}
+		case '\n':
+			flush()
+			inPrereqs = false
+		case ' ', '\t', '\r':
+			flush()
+		default:
+			word.WriteByte(c)
+		}
+	}
+}
+
+// usedInputs reads the depfiles of a target after it has been built and returns the subset of its inputs
+// (as paths relative to the repo root) that they name, along with a hash of them.
+func usedInputs(state *core.BuildState, target *core.BuildTarget) ([]string, []byte, error) {
+	tmpDir := target.TmpDir()
+	inputs := map[string]string{}
+	for source := range core.IterSources(state.Graph, target, false) {
+		inputs[source.Tmp] = source.Src
+	}
+	matches := fs.Glob(state.Config.Parse.BuildFileName, tmpDir, []string{target.Depfile}, nil, true)
+	if len(matches) == 0 {
+		return nil, nil, fmt.Errorf("no depfiles matching %s were written", target.Depfile)
+	}
+	used := map[string]bool{}
+	absTmpDir := path.Join(core.RepoRoot, tmpDir)
+	for _, match := range matches {
+		f, err := os.Open(path.Join(tmpDir, match))
+		if err != nil {
+			return nil, nil, err
+		}
+		deps, err := parseDepfile(f)
+		f.Close()
+		if err != nil {
+			return nil, nil, fmt.Errorf("failed to parse depfile %s: %w", match, err)
+		}
+		for _, dep := range deps {
+			if strings.HasPrefix(dep, core.SandboxDir+"/") {
+				dep = strings.TrimPrefix(dep, core.SandboxDir+"/")
+			} else if strings.HasPrefix(dep, absTmpDir+"/") {
+				dep = strings.TrimPrefix(dep, absTmpDir+"/")
+			}
+			// Anything that isn't one of our inputs (e.g. system headers) is not our concern.
+			if src, present := inputs[path.Join(tmpDir, dep)]; present {
+				used[src] = true
+			}
+		}
+	}
+	paths := make([]string, 0, len(used))
+	for src := range used {
+		paths = append(paths, src)
+	}
+	sort.Strings(paths)
+	h, err := usedInputsHash(state, target, paths)
+	return paths, h, err
+}
+
+// usedInputsHash calculates a hash of the given inputs of a target. It's analogous to sourceHash
+// but considers only a subset of its sources.
+func usedInputsHash(state *core.BuildState, target *core.BuildTarget, paths []string) ([]byte, error) {
+	h := sha1.New()
+	for _, src := range paths {
+		result, err := state.PathHasher.Hash(src, false, true)
+		if err != nil {
+			return nil, err
+		}
+		h.Write(result)
+		h.Write([]byte(src))
+	}
+	for _, tool := range target.AllTools() {
+		for _, path := range tool.FullPaths(state.Graph) {
+			result, err := state.PathHasher.Hash(path, false, true)
+			if err != nil {
+				return nil, err
+			}
+			h.Write(result)
+		}
+	}
+	return h.Sum(nil), nil
+}
+
+// usedInputsUnchanged returns true if the target recorded which of its inputs it used the last time it
+// was built and none of those have changed since.
+// Note that this can't notice a newly added input that would have been used in preference to an
+// existing one (e.g. a header earlier on the include path), which is the usual caveat of depfiles.
+func usedInputsUnchanged(state *core.BuildState, target *core.BuildTarget) bool {
+	if target.Depfile == "" {
+		return false
+	}
+	md, err := LoadTargetMetadata(target)
+	if err != nil || len(md.UsedInputsHash) == 0 {
+		return false
+	}
+	h, err := usedInputsHash(state, target, md.UsedInputs)
+	if err != nil || !bytes.Equal(h, md.UsedInputsHash) {
+		return false
+	}
+	log.Debug("Inputs of %s have changed, but none of the %d it used last time", target.Label, len(md.UsedInputs))
+	return true
+}
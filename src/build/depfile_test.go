@@ -0,0 +1,25 @@
+package build
+
+import (
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestParseDepfile(t *testing.T) {
+	deps, err := parseDepfile(strings.NewReader(`lib.o: src/lib.cc src/lib.h \
+ /usr/include/stdio.h third_party/with\ space.h \
+  dollar$$.h
+
+src/lib.h:
+`))
+	assert.NoError(t, err)
+	assert.Equal(t, []string{"src/lib.cc", "src/lib.h", "/usr/include/stdio.h", "third_party/with space.h", "dollar$.h"}, deps)
+}
+
+func TestParseDepfileMultipleRules(t *testing.T) {
+	deps, err := parseDepfile(strings.NewReader("a.o: a.cc a.h\nb.o: b.cc\n"))
+	assert.NoError(t, err)
+	assert.Equal(t, []string{"a.cc", "a.h", "b.cc"}, deps)
+}
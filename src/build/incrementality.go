@@ -49,7 +49,7 @@ var boolFalseHashValue = []byte{1}
 func needsBuilding(state *core.BuildState, target *core.BuildTarget, postBuild bool) bool {
 	// Check the dependencies first, because they don't need any disk I/O.
 	if target.NeedsTransitiveDependencies {
-		if anyDependencyHasChanged(target) {
+		if anyDependencyHasChanged(target) && !usedInputsUnchanged(state, target) {
 			return true // one of the transitive deps has changed, need to rebuild
 		}
 	} else {
@@ -81,7 +81,7 @@ func needsBuilding(state *core.BuildState, target *core.BuildTarget, postBuild b
 		return true
 	}
 	newSourceHash, err := sourceHash(state, target)
-	if err != nil || !bytes.Equal(oldHashes.source, newSourceHash) {
+	if (err != nil || !bytes.Equal(oldHashes.source, newSourceHash)) && !usedInputsUnchanged(state, target) {
 		log.Debug("Need to rebuild %s, sources have changed (was %s, need %s)", target.Label, b64(oldHashes.source), b64(newSourceHash))
 		return true
 	}
@@ -147,7 +147,23 @@ func mustSourceHash(state *core.BuildState, target *core.BuildTarget) []byte {
 // Calculate the hash of all sources of this rule
 func sourceHash(state *core.BuildState, target *core.BuildTarget) ([]byte, error) {
 	h := sha1.New()
-	for source := range core.IterSources(state.Graph, target, false) {
+	groups := fileSourceGroups(target)
+	names := make([]string, 0, len(groups))
+	for name := range groups {
+		names = append(names, name)
+	}
+	sort.Strings(names)
+	except := make(map[string]bool, len(groups))
+	for _, name := range names {
+		result, err := state.PathHasher.HashGroup(groups[name])
+		if err != nil {
+			return nil, err
+		}
+		h.Write(result)
+		h.Write([]byte(name))
+		except[name] = true
+	}
+	for source := range core.IterSourcesExcept(state.Graph, target, false, except) {
 		result, err := state.PathHasher.Hash(source.Src, false, true)
 		if err != nil {
 			return nil, err
@@ -167,6 +183,33 @@ func sourceHash(state *core.BuildState, target *core.BuildTarget) ([]byte, error
 	return h.Sum(nil), nil
 }
 
+// fileSourceGroups returns the paths in each of the target's named groups of sources that consists only of
+// (more than one) files, rather than other rules. Each group is hashed as a whole, which is only done once
+// between all the targets that have the same one; for example, each of the per-source compile rules of a
+// cc_library has the same hdrs.
+func fileSourceGroups(target *core.BuildTarget) map[string][]string {
+	groups := map[string][]string{}
+	for name, srcs := range target.NamedSources {
+		if paths := filePaths(srcs); len(paths) > 1 {
+			groups[name] = paths
+		}
+	}
+	return groups
+}
+
+// filePaths returns the paths of the given sources, or nil if any of them aren't plain files.
+func filePaths(srcs []core.BuildInput) []string {
+	paths := make([]string, len(srcs))
+	for i, src := range srcs {
+		file, ok := src.(core.FileLabel)
+		if !ok {
+			return nil
+		}
+		paths[i] = file.Paths(nil)[0]
+	}
+	return paths
+}
+
 // RuleHash calculates a hash for the relevant bits of this rule that affect its output.
 // Optionally it can include parts of the rule that affect runtime (most obviously test-time).
 // Note that we have to hash on the declared fields, we obviously can't hash pointers etc.
@@ -241,6 +284,7 @@ func ruleHash(state *core.BuildState, target *core.BuildTarget, runtime bool) []
 	}
 
 	hashBool(h, target.NeedsTransitiveDependencies)
+	h.Write([]byte(target.Depfile))
 	hashBool(h, target.OutputIsComplete)
 	hashBool(h, target.Stamp)
 	hashBool(h, target.IsFilegroup)
@@ -396,8 +440,8 @@ func targetBuildMetadataFileName(target *core.BuildTarget) string {
 	return path.Join(target.OutDir(), target.TargetBuildMetadataFileName())
 }
 
-// loadTargetMetadata retrieves the target metadata from a file in the output directory of this target
-func loadTargetMetadata(target *core.BuildTarget) (*core.BuildMetadata, error) {
+// LoadTargetMetadata retrieves the target metadata from a file in the output directory of this target
+func LoadTargetMetadata(target *core.BuildTarget) (*core.BuildMetadata, error) {
 	file, err := os.Open(targetBuildMetadataFileName(target))
 	if err != nil {
 		return nil, err
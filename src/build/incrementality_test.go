@@ -55,6 +55,7 @@ var KnownFields = map[string]bool{
 	"Stamp":                       true,
 	"OutputDirectories":           true,
 	"ExitOnError":                 true,
+	"Depfile":                     true,
 	"EntryPoints":                 true,
 	"Env":                         true,
 
@@ -73,20 +74,25 @@ var KnownFields = map[string]bool{
 	// These fields we have thought about and decided that they shouldn't contribute to the
 	// hash because they don't affect the actual output of the target.
 	"Subrepo":                true,
+	"CacheKeyCommand":        true,
+	"CacheKeyCommands":       true,
 	"AddedPostBuild":         true,
 	"Flakiness":              true,
+	"TestShards":             true,
 	"NoTestOutput":           true,
 	"BuildTimeout":           true,
 	"TestTimeout":            true,
 	"state":                  true,
 	"Results":                true, // Recall that unsuccessful test results aren't cached...
 	"completedRuns":          true,
+	"priority":               true,
 	"BuildingDescription":    true,
 	"ShowProgress":           true,
 	"Progress":               true,
 	"PassUnsafeEnv":          true,
 	"NeededForSubinclude":    true,
 	"mutex":                  true,
+	"transitiveLabels":       true,
 	"dependenciesRegistered": true,
 	"finishedBuilding":       true,
 
@@ -0,0 +1,67 @@
+package build
+
+import (
+	"os"
+	"path"
+	"path/filepath"
+	"time"
+
+	"github.com/prometheus/client_golang/prometheus"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/metrics"
+)
+
+var phaseDurations = metrics.NewHistogramVec(
+	"build",
+	"phase_duration_seconds",
+	"Time spent in each phase of building targets locally",
+	prometheus.ExponentialBuckets(0.001, 4, 10),
+	[]string{"phase"},
+)
+
+// tracePhase starts timing a phase of building the given target. The returned function ends it,
+// recording it in the trace file (if there is one) and in the metrics.
+func tracePhase(tid int, state *core.BuildState, target *core.BuildTarget, phase string) func() {
+	start := time.Now()
+	return func() {
+		end := time.Now()
+		phaseDurations.WithLabelValues(phase).Observe(end.Sub(start).Seconds())
+		state.AddTraceSpan(core.TraceSpan{
+			Label:    target.Label,
+			ThreadID: tid,
+			Name:     phase,
+			Start:    start,
+			End:      end,
+		})
+	}
+}
+
+// recordActionTraces records any trace events written by the target's build action (see core.TraceEventsLabel),
+// which started at the given time.
+func recordActionTraces(tid int, state *core.BuildState, target *core.BuildTarget, start time.Time) {
+	if !state.Tracing {
+		return
+	}
+	for _, pattern := range target.PrefixedLabels(core.TraceEventsLabel) {
+		matches, err := filepath.Glob(path.Join(target.TmpDir(), pattern))
+		if err != nil {
+			log.Warning("Invalid trace events pattern for %s: %s", target.Label, err)
+			continue
+		}
+		for _, match := range matches {
+			b, err := os.ReadFile(match)
+			if err != nil {
+				log.Warning("Failed to read trace events for %s: %s", target.Label, err)
+				continue
+			}
+			state.AddActionTrace(core.ActionTrace{
+				Label:    target.Label,
+				ThreadID: tid,
+				Name:     path.Base(match),
+				Start:    start,
+				Data:     b,
+			})
+		}
+	}
+}
@@ -7,12 +7,16 @@ import (
 )
 
 // An asyncCache is a wrapper around a Cache interface that handles incoming
-// store requests asynchronously and attempts to return immediately.
-// The requests are handled on an internal queue, if that fills up then
-// incoming requests will start to block again until it empties.
+// store requests asynchronously and returns immediately.
+// The requests are handled on an internal queue, which only holds the names of the files
+// to store (they're read when the request is handled), so the build never waits on it however
+// slow the underlying cache is to write to.
 // Retrieval requests are still handled synchronously.
 type asyncCache struct {
-	requests  chan cacheRequest
+	requests  []cacheRequest
+	closed    bool
+	mutex     sync.Mutex
+	cond      *sync.Cond
 	realCache core.Cache
 	wg        sync.WaitGroup
 }
@@ -26,9 +30,9 @@ type cacheRequest struct {
 
 func newAsyncCache(realCache core.Cache, config *core.Configuration) core.Cache {
 	c := &asyncCache{
-		requests:  make(chan cacheRequest),
 		realCache: realCache,
 	}
+	c.cond = sync.NewCond(&c.mutex)
 	c.wg.Add(config.Cache.Workers)
 	for i := 0; i < config.Cache.Workers; i++ {
 		go c.run()
@@ -37,11 +41,14 @@ func newAsyncCache(realCache core.Cache, config *core.Configuration) core.Cache
 }
 
 func (c *asyncCache) Store(target *core.BuildTarget, key []byte, files []string) {
-	c.requests <- cacheRequest{
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	c.requests = append(c.requests, cacheRequest{
 		target: target,
 		key:    key,
 		files:  files,
-	}
+	})
+	c.cond.Signal()
 }
 
 func (c *asyncCache) Retrieve(target *core.BuildTarget, key []byte, files []string) bool {
@@ -58,15 +65,30 @@ func (c *asyncCache) CleanAll() {
 
 func (c *asyncCache) Shutdown() {
 	log.Info("Shutting down cache workers...")
-	close(c.requests)
+	c.mutex.Lock()
+	c.closed = true
+	c.cond.Broadcast()
+	c.mutex.Unlock()
 	c.wg.Wait()
 	log.Debug("Shut down all cache workers")
 }
 
 // run implements the actual async logic.
 func (c *asyncCache) run() {
-	for r := range c.requests {
+	defer c.wg.Done()
+	for {
+		c.mutex.Lock()
+		for len(c.requests) == 0 && !c.closed {
+			c.cond.Wait()
+		}
+		if len(c.requests) == 0 {
+			c.mutex.Unlock()
+			return
+		}
+		r := c.requests[0]
+		c.requests[0] = cacheRequest{}
+		c.requests = c.requests[1:]
+		c.mutex.Unlock()
 		c.realCache.Store(r.target, r.key, r.files)
 	}
-	c.wg.Done()
 }
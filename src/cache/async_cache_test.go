@@ -67,6 +67,37 @@ func TestSimulateBuild(t *testing.T) {
 	}
 }
 
+func TestStoreDoesNotBlock(t *testing.T) {
+	// Stores are queued up even while the one worker is stuck on the first of them.
+	mCache := &mockCache{
+		inFlight:  make(map[*core.BuildTarget]bool),
+		completed: make(map[*core.BuildTarget]bool),
+		stored:    make(map[*core.BuildTarget][]string),
+	}
+	bCache := &blockingCache{mockCache: mCache, release: make(chan struct{})}
+	config := core.DefaultConfiguration()
+	config.Cache.Workers = 1
+	aCache := newAsyncCache(bCache, config)
+	for i := 0; i < 10; i++ {
+		target := makeTarget1(fmt.Sprintf("//test_pkg:blocked%d", i))
+		aCache.Store(target, nil, target.Outputs())
+	}
+	close(bCache.release)
+	aCache.Shutdown()
+	assert.Equal(t, 10, len(mCache.stored))
+}
+
+// A blockingCache is a mockCache that doesn't store anything until it's released.
+type blockingCache struct {
+	*mockCache
+	release chan struct{}
+}
+
+func (c *blockingCache) Store(target *core.BuildTarget, key []byte, files []string) {
+	<-c.release
+	c.mockCache.Store(target, key, files)
+}
+
 // Fake cache implementation to ensure our async cache behaves itself.
 type mockCache struct {
 	sync.Mutex
@@ -0,0 +1,221 @@
+// Chunked storage of large files in the HTTP cache.
+//
+// Large files are split up at positions determined by a rolling hash of their contents, rather than
+// at fixed offsets, so most of the chunks of a file that has only partly changed (for example a
+// relinked binary) are the same as last time. Each chunk is compressed with zstd and stored under
+// the hash of its contents, and only those that aren't already in the cache are uploaded; the
+// file's entry in the artifact's tarball then just lists its chunks.
+
+package cache
+
+import (
+	"crypto/sha256"
+	"encoding/hex"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"net/http"
+	"os"
+	"strconv"
+	"strings"
+	"sync"
+
+	"github.com/hashicorp/go-retryablehttp"
+	"github.com/klauspost/compress/zstd"
+)
+
+const (
+	// minChunkSize is the smallest chunk we make, other than at the end of a file.
+	minChunkSize = 256 * 1024
+	// maxChunkSize is the largest chunk we make. It also bounds the memory used by each upload.
+	maxChunkSize = 4 * 1024 * 1024
+	// chunkShift gives chunks an average size of about 1MB beyond the minimum; they end when the
+	// top 20 bits of the rolling hash are all zero.
+	chunkShift = 64 - 20
+)
+
+// chunksPAXRecord is the PAX record on a file's tar header listing its chunks, in the form
+// hash:size,hash:size,... If present, the file's entry has no contents of its own.
+const chunksPAXRecord = "PLZ.chunks"
+
+// gearTable is the table of random values for the rolling hash. It has to be the same on every
+// machine sharing a cache for the same chunks to be found, so it's generated deterministically.
+var gearTable = func() (table [256]uint64) {
+	x := uint64(0x706c7a2d63616368) // splitmix64 with an arbitrary seed
+	for i := range table {
+		x += 0x9e3779b97f4a7c15
+		z := x
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb
+		table[i] = z ^ (z >> 31)
+	}
+	return table
+}()
+
+// nextChunk returns the length of the chunk at the start of the given data, which should be at
+// least maxChunkSize bytes long unless it's the rest of the file.
+func nextChunk(data []byte) int {
+	if len(data) <= minChunkSize {
+		return len(data)
+	}
+	n := len(data)
+	if n > maxChunkSize {
+		n = maxChunkSize
+	}
+	var h uint64
+	for i := minChunkSize; i < n; i++ {
+		h = (h << 1) + gearTable[data[i]]
+		if h>>chunkShift == 0 {
+			return i + 1
+		}
+	}
+	return n
+}
+
+// chunkBuffers holds buffers for reading chunks into.
+var chunkBuffers = sync.Pool{
+	New: func() interface{} {
+		b := make([]byte, maxChunkSize)
+		return &b
+	},
+}
+
+// The zstd encoder & decoder are only created if they're needed. Both are safe for concurrent use.
+var (
+	encoder     *zstd.Encoder
+	decoder     *zstd.Decoder
+	encoderOnce sync.Once
+	decoderOnce sync.Once
+)
+
+func compress(data []byte) []byte {
+	encoderOnce.Do(func() { encoder, _ = zstd.NewWriter(nil) })
+	return encoder.EncodeAll(data, nil)
+}
+
+func decompress(data []byte, size int) ([]byte, error) {
+	decoderOnce.Do(func() { decoder, _ = zstd.NewReader(nil) })
+	return decoder.DecodeAll(data, make([]byte, 0, size))
+}
+
+// chunkURL returns the remote URL for a chunk.
+func (cache *httpCache) chunkURL(hash string) string {
+	return cache.url + "/chunks/" + hash
+}
+
+// storeChunks stores the chunks of the given file in the cache, and returns the listing of them for
+// its tar header.
+func (cache *httpCache) storeChunks(filename string) (string, error) {
+	f, err := os.Open(filename)
+	if err != nil {
+		return "", err
+	}
+	defer f.Close()
+	b := chunkBuffers.Get().(*[]byte)
+	defer chunkBuffers.Put(b)
+	buf := *b
+	var chunks []string
+	filled := 0
+	for {
+		n, err := io.ReadFull(f, buf[filled:])
+		filled += n
+		if err != nil && err != io.EOF && err != io.ErrUnexpectedEOF {
+			return "", err
+		} else if filled == 0 {
+			return strings.Join(chunks, ","), nil
+		}
+		size := nextChunk(buf[:filled])
+		sum := sha256.Sum256(buf[:size])
+		hash := hex.EncodeToString(sum[:])
+		if err := cache.storeChunk(hash, buf[:size]); err != nil {
+			return "", err
+		}
+		chunks = append(chunks, hash+":"+strconv.Itoa(size))
+		filled = copy(buf, buf[size:filled])
+	}
+}
+
+// storeChunk uploads a single chunk, unless it's already in the cache.
+func (cache *httpCache) storeChunk(hash string, data []byte) error {
+	if _, present := cache.chunks.Load(hash); present {
+		return nil
+	}
+	cache.requestLimiter.acquire()
+	defer cache.requestLimiter.release()
+	url := cache.chunkURL(hash)
+	req, err := retryablehttp.NewRequest(http.MethodHead, url, nil)
+	if err != nil {
+		return err
+	}
+	resp, err := cache.client.Do(req)
+	if err != nil {
+		return err
+	}
+	resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		req, err := retryablehttp.NewRequest(http.MethodPut, url, compress(data))
+		if err != nil {
+			return err
+		}
+		resp, err := cache.client.Do(req)
+		if err != nil {
+			return err
+		}
+		resp.Body.Close()
+		if resp.StatusCode >= 300 {
+			return fmt.Errorf("failed to store chunk %s: %s", hash, resp.Status)
+		}
+	}
+	cache.chunks.Store(hash, struct{}{})
+	return nil
+}
+
+// retrieveChunks retrieves all the chunks in the given listing from a tar header, and writes them to w.
+// The caller is already holding a request slot for the whole artifact, so these don't take another.
+func (cache *httpCache) retrieveChunks(w io.Writer, listing string) error {
+	for _, chunk := range strings.Split(listing, ",") {
+		hash, sizeStr := chunk, ""
+		if idx := strings.IndexByte(chunk, ':'); idx != -1 {
+			hash, sizeStr = chunk[:idx], chunk[idx+1:]
+		}
+		size, err := strconv.Atoi(sizeStr)
+		if err != nil || size < 0 || size > maxChunkSize {
+			return fmt.Errorf("invalid chunk listing %s", chunk)
+		}
+		data, err := cache.retrieveChunk(hash, size)
+		if err != nil {
+			return err
+		} else if _, err := w.Write(data); err != nil {
+			return err
+		}
+	}
+	return nil
+}
+
+// retrieveChunk retrieves a single chunk and checks that it has the expected contents.
+func (cache *httpCache) retrieveChunk(hash string, size int) ([]byte, error) {
+	req, err := retryablehttp.NewRequest(http.MethodGet, cache.chunkURL(hash), nil)
+	if err != nil {
+		return nil, err
+	}
+	resp, err := cache.client.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	defer resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		return nil, fmt.Errorf("failed to retrieve chunk %s: %s", hash, resp.Status)
+	}
+	compressed, err := ioutil.ReadAll(io.LimitReader(resp.Body, maxChunkSize+maxChunkSize/8))
+	if err != nil {
+		return nil, err
+	}
+	data, err := decompress(compressed, size)
+	if err != nil {
+		return nil, fmt.Errorf("failed to decompress chunk %s: %s", hash, err)
+	}
+	if sum := sha256.Sum256(data); len(data) != size || hex.EncodeToString(sum[:]) != hash {
+		return nil, fmt.Errorf("chunk %s has the wrong contents", hash)
+	}
+	return data, nil
+}
@@ -12,6 +12,7 @@ import (
 	"net/http"
 	"os"
 	"path"
+	"sync"
 	"time"
 
 	"github.com/hashicorp/go-retryablehttp"
@@ -28,6 +29,11 @@ type httpCache struct {
 	client   *retryablehttp.Client
 
 	requestLimiter limiter
+
+	// Files at least this big are stored in chunks (see chunks.go); zero if none are.
+	chunkThreshold int64
+	// The chunks we know are already in the cache.
+	chunks sync.Map
 }
 
 type limiter chan struct{}
@@ -48,11 +54,13 @@ const nobody = 65534
 
 func (cache *httpCache) Store(target *core.BuildTarget, key []byte, files []string) {
 	if cache.writable {
+		// The chunks of any large files are stored first, so they're all there before anything refers to them.
+		chunked := cache.storeChunkedFiles(target, files)
 		cache.requestLimiter.acquire()
 		defer cache.requestLimiter.release()
 
 		r, w := io.Pipe()
-		go cache.write(w, target, files)
+		go cache.write(w, target, files, chunked)
 		req, err := retryablehttp.NewRequest(http.MethodPut, cache.makeURL(key), r)
 		if err != nil {
 			log.Warning("Invalid cache URL: %s", err)
@@ -71,8 +79,38 @@ func (cache *httpCache) makeURL(key []byte) string {
 	return cache.url + "/" + hex.EncodeToString(key)
 }
 
+// storeChunkedFiles stores the chunks of any of the given files that are big enough to be chunked, and
+// returns the listing of chunks for each of them. Any that fail are stored as a whole instead.
+func (cache *httpCache) storeChunkedFiles(target *core.BuildTarget, files []string) map[string]string {
+	if cache.chunkThreshold <= 0 {
+		return nil
+	}
+	chunked := map[string]string{}
+	outDir := target.OutDir()
+	for _, out := range files {
+		if err := fs.Walk(path.Join(outDir, out), func(name string, isDir bool) error {
+			if info, err := os.Lstat(name); err != nil {
+				return err
+			} else if !info.Mode().IsRegular() || info.Size() < cache.chunkThreshold {
+				return nil
+			}
+			listing, err := cache.storeChunks(name)
+			if err != nil {
+				log.Warning("Failed to store chunks of %s in HTTP cache: %s", name, err)
+			} else {
+				chunked[name] = listing
+			}
+			return nil
+		}); err != nil {
+			log.Warning("Error uploading artifacts to HTTP cache: %s", err)
+		}
+	}
+	return chunked
+}
+
 // write writes a series of files into the given Writer.
-func (cache *httpCache) write(w io.WriteCloser, target *core.BuildTarget, files []string) {
+// Those named in chunked are written as the listing of their chunks instead of their contents.
+func (cache *httpCache) write(w io.WriteCloser, target *core.BuildTarget, files []string, chunked map[string]string) {
 	defer w.Close()
 	gzw := gzip.NewWriter(w)
 	defer gzw.Close()
@@ -82,7 +120,7 @@ func (cache *httpCache) write(w io.WriteCloser, target *core.BuildTarget, files
 
 	for _, out := range files {
 		if err := fs.Walk(path.Join(outDir, out), func(name string, isDir bool) error {
-			return cache.storeFile(tw, name)
+			return cache.storeFile(tw, name, chunked[name])
 		}); err != nil {
 			log.Warning("Error uploading artifacts to HTTP cache: %s", err)
 			// TODO(peterebden): How can we cancel the request at this point?
@@ -90,7 +128,7 @@ func (cache *httpCache) write(w io.WriteCloser, target *core.BuildTarget, files
 	}
 }
 
-func (cache *httpCache) storeFile(tw *tar.Writer, name string) error {
+func (cache *httpCache) storeFile(tw *tar.Writer, name, chunks string) error {
 	info, err := os.Lstat(name)
 	if err != nil {
 		return err
@@ -113,9 +151,13 @@ func (cache *httpCache) storeFile(tw *tar.Writer, name string) error {
 	hdr.Gid = nobody
 	hdr.Uname = "nobody"
 	hdr.Gname = "nobody"
+	if chunks != "" {
+		hdr.Size = 0
+		hdr.PAXRecords = map[string]string{chunksPAXRecord: chunks}
+	}
 	if err := tw.WriteHeader(hdr); err != nil {
 		return err
-	} else if info.IsDir() || target != "" {
+	} else if info.IsDir() || target != "" || chunks != "" {
 		return nil // nothing to write
 	}
 	f, err := os.Open(name)
@@ -181,7 +223,8 @@ func (cache *httpCache) retrieve(key []byte) (bool, error) {
 			}
 			if f, err := openFile(hdr); err != nil {
 				return false, err
-			} else if _, err := io.Copy(f, tr); err != nil {
+			} else if err := cache.retrieveFile(f, tr, hdr); err != nil {
+				f.Close()
 				return false, err
 			} else if err := f.Close(); err != nil {
 				return false, err
@@ -196,6 +239,15 @@ func (cache *httpCache) retrieve(key []byte) (bool, error) {
 	}
 }
 
+// retrieveFile writes the contents of a file from the tarball to f, which come from its chunks if it was chunked.
+func (cache *httpCache) retrieveFile(f *os.File, tr *tar.Reader, hdr *tar.Header) error {
+	if chunks := hdr.PAXRecords[chunksPAXRecord]; chunks != "" {
+		return cache.retrieveChunks(f, chunks)
+	}
+	_, err := io.Copy(f, tr)
+	return err
+}
+
 func openFile(header *tar.Header) (*os.File, error) {
 	f, err := os.OpenFile(header.Name, os.O_WRONLY|os.O_TRUNC|os.O_CREATE, os.FileMode(header.Mode))
 	if err != nil {
@@ -237,5 +289,6 @@ func newHTTPCache(config *core.Configuration) *httpCache {
 			Backoff:      retryablehttp.DefaultBackoff,
 		},
 		requestLimiter: make(limiter, config.Cache.HTTPConcurrentRequestLimit),
+		chunkThreshold: int64(config.Cache.HTTPChunkThreshold),
 	}
 }
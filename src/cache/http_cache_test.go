@@ -2,16 +2,24 @@ package cache
 
 import (
 	"io/ioutil"
+	"math/rand"
 	"net"
 	"net/http"
 	"os"
+	"strings"
+	"sync"
 	"testing"
 
 	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
 
 	"github.com/thought-machine/please/src/core"
 )
 
+var server = &testServer{
+	data: map[string][]byte{},
+}
+
 func init() {
 	os.Chdir("src/cache/test_data")
 	// Split up the listen and serve parts to avoid race conditions.
@@ -20,9 +28,7 @@ func init() {
 		log.Fatalf("%s", err)
 	}
 	go func() {
-		http.Serve(lis, &testServer{
-			data: map[string][]byte{},
-		})
+		http.Serve(lis, server)
 	}()
 }
 
@@ -49,14 +55,61 @@ func TestStoreAndRetrieveHTTP(t *testing.T) {
 	assert.Equal(t, b, b2)
 }
 
+func TestStoreAndRetrieveChunkedHTTP(t *testing.T) {
+	target := core.NewBuildTarget(core.NewBuildLabel("pkg/name", "chunked"))
+	target.AddOutput("chunked_file")
+	config := core.DefaultConfiguration()
+	config.Cache.HTTPURL = "http://127.0.0.1:8989"
+	config.Cache.HTTPWriteable = true
+	config.Cache.HTTPChunkThreshold = 1024 * 1024
+	filename := "plz-out/gen/pkg/name/chunked_file"
+	b := make([]byte, 6*1024*1024)
+	rand.New(rand.NewSource(42)).Read(b)
+	require.NoError(t, os.MkdirAll("plz-out/gen/pkg/name", 0755))
+	require.NoError(t, ioutil.WriteFile(filename, b, 0644))
+
+	newHTTPCache(config).Store(target, []byte("chunked_key_1"), target.Outputs())
+	puts := server.numChunkPuts()
+	assert.True(t, puts > 1)
+
+	// Changing one part of the file should only upload the chunk it's in again, even from a new
+	// cache that doesn't know what's already been stored.
+	b[4*1024*1024] ^= 0xff
+	require.NoError(t, ioutil.WriteFile(filename, b, 0644))
+	newHTTPCache(config).Store(target, []byte("chunked_key_2"), target.Outputs())
+	// It might also move the boundary after it, if it's just before that.
+	assert.True(t, server.numChunkPuts() > puts)
+	assert.True(t, server.numChunkPuts() <= puts+2)
+
+	require.NoError(t, os.Remove(filename))
+	assert.True(t, newHTTPCache(config).Retrieve(target, []byte("chunked_key_2"), nil))
+	b2, err := ioutil.ReadFile(filename)
+	assert.NoError(t, err)
+	assert.Equal(t, b, b2)
+}
+
 type testServer struct {
-	data map[string][]byte
+	data      map[string][]byte
+	chunkPuts int
+	mutex     sync.Mutex
+}
+
+// numChunkPuts returns the number of times a chunk has been uploaded.
+func (s *testServer) numChunkPuts() int {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	return s.chunkPuts
 }
 
 func (s *testServer) ServeHTTP(w http.ResponseWriter, r *http.Request) {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
 	if r.Method == http.MethodPut {
 		b, _ := ioutil.ReadAll(r.Body)
 		s.data[r.URL.Path] = b
+		if strings.HasPrefix(r.URL.Path, "/chunks/") {
+			s.chunkPuts++
+		}
 		w.WriteHeader(http.StatusNoContent)
 		return
 	}
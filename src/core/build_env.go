@@ -7,9 +7,11 @@ import (
 	"path"
 	"path/filepath"
 	"runtime"
+	"strconv"
 	"strings"
 	"sync"
 
+	"github.com/thought-machine/please/src/cli"
 	"github.com/thought-machine/please/src/fs"
 	"github.com/thought-machine/please/src/scm"
 )
@@ -132,6 +134,13 @@ func BuildEnvironment(state *BuildState, target *BuildTarget, tmpDir string) Bui
 	if target.Sandbox && len(state.Config.Sandbox.Dir) > 0 {
 		env = append(env, "SANDBOX_DIRS="+strings.Join(state.Config.Sandbox.Dir, ","))
 	}
+	if target.Sandbox {
+		env = append(env, sandboxCgroupEnv(state)...)
+		env = append(env, sandboxTmpfsEnv(state, target)...)
+	}
+	if UsesSandboxOverlay(state, target) {
+		env = append(env, "SANDBOX_OVERLAY="+path.Join(RepoRoot, SandboxOverlayDir(target)))
+	}
 	if state.Config.Bazel.Compatibility {
 		// Obviously this is only a subset of the variables Bazel would expose, but there's
 		// no point populating ones that we literally have no clue what they should be.
@@ -140,6 +149,10 @@ func BuildEnvironment(state *BuildState, target *BuildTarget, tmpDir string) Bui
 		env = append(env, "GENDIR="+path.Join(RepoRoot, GenDir))
 		env = append(env, "BINDIR="+path.Join(RepoRoot, BinDir))
 	}
+	// Bit of a hack for dwp which needs access to the .dwo files that compile rules left in plz-out/gen.
+	if target.HasLabel("dwp") {
+		env = append(env, "DWO_ROOT="+RepoRoot)
+	}
 
 	return withUserProvidedEnv(target, env)
 }
@@ -217,9 +230,85 @@ func TestEnvironment(state *BuildState, target *BuildTarget, testDir string) Bui
 	if target.TestSandbox && len(state.Config.Sandbox.Dir) > 0 {
 		env = append(env, "SANDBOX_DIRS="+strings.Join(state.Config.Sandbox.Dir, ","))
 	}
+	if target.TestSandbox {
+		env = append(env, sandboxCgroupEnv(state)...)
+		env = append(env, sandboxTmpfsEnv(state, target)...)
+	}
 	return withUserProvidedEnv(target, env)
 }
 
+// sandboxCgroupEnv returns the environment variables instructing the sandbox to place an action in
+// its own cgroup, with any resource limits on it.
+func sandboxCgroupEnv(state *BuildState) BuildEnv {
+	config := &state.Config.Sandbox
+	if config.Cgroup == "" {
+		return nil
+	}
+	env := BuildEnv{"SANDBOX_CGROUP=" + config.Cgroup}
+	if config.MemoryMax != "" {
+		env = append(env, "SANDBOX_MEMORY_MAX="+config.MemoryMax)
+	}
+	if config.CPUMax != "" {
+		env = append(env, "SANDBOX_CPU_MAX="+config.CPUMax)
+	}
+	if config.PidsMax > 0 {
+		env = append(env, "SANDBOX_PIDS_MAX="+strconv.Itoa(config.PidsMax))
+	}
+	return env
+}
+
+// sandboxTmpfsEnv returns the environment variable describing the tmpfs the sandbox should
+// mount on /tmp for the given target, if it's been configured.
+func sandboxTmpfsEnv(state *BuildState, target *BuildTarget) BuildEnv {
+	config := &state.Config.Sandbox
+	size := config.TmpfsSize
+	for _, label := range target.Labels {
+		if s, present := state.Config.Size[label]; present && s.Tmpfs > 0 {
+			size = s.Tmpfs
+		}
+	}
+	if labels := target.PrefixedLabels("tmpfs:"); len(labels) > 0 {
+		if labels[0] == "none" {
+			return BuildEnv{"SANDBOX_TMPFS=none"}
+		}
+		var labelSize cli.ByteSize
+		if err := labelSize.UnmarshalFlag(labels[0]); err != nil {
+			log.Warning("Invalid tmpfs label on %s: %s", target, err)
+		} else {
+			size = labelSize
+		}
+	}
+	opts := []string{}
+	if size > 0 {
+		opts = append(opts, "size="+strconv.FormatUint(uint64(size), 10))
+	}
+	if config.TmpfsInodes > 0 {
+		opts = append(opts, "nr_inodes="+strconv.Itoa(config.TmpfsInodes))
+	}
+	if config.TmpfsHuge {
+		opts = append(opts, "huge=within_size")
+	}
+	if len(opts) == 0 {
+		return nil
+	}
+	return BuildEnv{"SANDBOX_TMPFS=" + strings.Join(opts, ",")}
+}
+
+// UsesSandboxOverlay returns true if the given target's build action sees the outputs of its
+// dependencies through an overlay mount in the sandbox, instead of having them linked into its
+// temporary directory.
+func UsesSandboxOverlay(state *BuildState, target *BuildTarget) bool {
+	return target.Sandbox && state.Config.Sandbox.Overlay && runtime.GOOS == "linux"
+}
+
+// SandboxOverlayDir returns the directory that the outputs of a target's dependencies are linked into
+// when it uses the sandbox overlay. The sandbox mounts it as the lower layer underneath the build
+// directory, so only the target's declared inputs are visible, and they're kept apart from whatever
+// the action writes.
+func SandboxOverlayDir(target *BuildTarget) string {
+	return target.TmpDir() + ".inputs"
+}
+
 func runtimeDataPaths(graph *BuildGraph, data []BuildInput) []string {
 	paths := make([]string, 0, len(data))
 	for _, in := range data {
@@ -3,6 +3,7 @@ package core
 import (
 	"os"
 	"path/filepath"
+	"runtime"
 	"testing"
 
 	"github.com/stretchr/testify/assert"
@@ -67,3 +68,37 @@ func TestExecEnvironment(t *testing.T) {
 	assert.Contains(t, env, "OUTS=file1")
 	assert.Contains(t, env, "OUT=file1")
 }
+
+func TestSandboxTmpfsEnv(t *testing.T) {
+	state := NewDefaultBuildState()
+	target := NewBuildTarget(NewBuildLabel("pkg", "t"))
+	assert.Nil(t, sandboxTmpfsEnv(state, target))
+
+	state.Config.Sandbox.TmpfsSize = 1 << 30
+	state.Config.Sandbox.TmpfsHuge = true
+	assert.Equal(t, BuildEnv{"SANDBOX_TMPFS=size=1073741824,huge=within_size"}, sandboxTmpfsEnv(state, target))
+
+	state.Config.Size = map[string]*Size{"small": {Tmpfs: 1 << 20}}
+	target.AddLabel("small")
+	assert.Equal(t, BuildEnv{"SANDBOX_TMPFS=size=1048576,huge=within_size"}, sandboxTmpfsEnv(state, target))
+
+	target.AddLabel("tmpfs:2K")
+	assert.Equal(t, BuildEnv{"SANDBOX_TMPFS=size=2000,huge=within_size"}, sandboxTmpfsEnv(state, target))
+
+	target = NewBuildTarget(NewBuildLabel("pkg", "t"))
+	target.AddLabel("tmpfs:none")
+	assert.Equal(t, BuildEnv{"SANDBOX_TMPFS=none"}, sandboxTmpfsEnv(state, target))
+}
+
+func TestSandboxOverlayEnv(t *testing.T) {
+	if runtime.GOOS != "linux" {
+		t.Skip("The sandbox overlay is only supported on Linux")
+	}
+	state := NewDefaultBuildState()
+	state.Config.Sandbox.Overlay = true
+	target := NewBuildTarget(NewBuildLabel("pkg", "t"))
+	target.Sandbox = true
+	// Only the target's own inputs are in the lower layer, not the whole of plz-out.
+	env := BuildEnvironment(state, target, target.TmpDir())
+	assert.Contains(t, env, "SANDBOX_OVERLAY="+filepath.Join(RepoRoot, "plz-out/tmp/pkg/t._build.inputs"))
+}
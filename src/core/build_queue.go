@@ -0,0 +1,149 @@
+package core
+
+import (
+	"container/heap"
+	"sync"
+	"sync/atomic"
+)
+
+// A buildQueue hands out targets that are ready to build in order of their priority, highest first,
+// rather than in the order they became ready.
+//
+// A target's priority is an estimate of how long the longest chain of build actions from it to one of
+// the requested targets will take, based on how long each took last time. Starting the ones on the
+// slowest chains first means the build isn't left waiting on them at the end.
+type buildQueue struct {
+	durations *labelStore
+	targets   buildHeap
+	queued    map[*BuildTarget]*queuedTarget
+	seq       int
+	closed    bool
+	done      chan struct{}
+	mutex     sync.Mutex
+	cond      *sync.Cond
+}
+
+func newBuildQueue(durations *labelStore) *buildQueue {
+	q := &buildQueue{
+		durations: durations,
+		queued:    map[*BuildTarget]*queuedTarget{},
+		done:      make(chan struct{}),
+	}
+	q.cond = sync.NewCond(&q.mutex)
+	return q
+}
+
+// RaisePriority updates the priority of the given target now that it's known to be needed by the given
+// dependent (which is nil for targets that were requested originally).
+// If that raises it, the new priority is carried on to the dependencies it has so far, so dependencies
+// that were reached (or queued) before their dependents' priorities were known still end up with the
+// length of their longest chain. The graph's acyclic and priorities only ever go up, so that terminates.
+func (q *buildQueue) RaisePriority(target, dependent *BuildTarget) {
+	duration, _ := q.durations.Get(target.Label)
+	priority := duration
+	if dependent != nil {
+		priority += atomic.LoadInt64(&dependent.priority)
+	}
+	for {
+		old := atomic.LoadInt64(&target.priority)
+		if old >= priority {
+			return
+		} else if atomic.CompareAndSwapInt64(&target.priority, old, priority) {
+			break
+		}
+	}
+	q.mutex.Lock()
+	if qt, present := q.queued[target]; present {
+		qt.priority = atomic.LoadInt64(&target.priority)
+		heap.Fix(&q.targets, qt.index)
+	}
+	q.mutex.Unlock()
+	for _, dep := range target.Dependencies() {
+		q.RaisePriority(dep, target)
+	}
+}
+
+// Push adds a target that's ready to build to the queue.
+func (q *buildQueue) Push(target *BuildTarget) {
+	q.mutex.Lock()
+	defer q.mutex.Unlock()
+	q.seq++
+	qt := &queuedTarget{target: target, priority: atomic.LoadInt64(&target.priority), seq: q.seq}
+	q.queued[target] = qt
+	heap.Push(&q.targets, qt)
+	q.cond.Signal()
+}
+
+// Close stops the queue. Run closes its channel and returns once it's called.
+func (q *buildQueue) Close() {
+	q.mutex.Lock()
+	defer q.mutex.Unlock()
+	if !q.closed {
+		q.closed = true
+		close(q.done)
+		q.cond.Broadcast()
+	}
+}
+
+// Run sends targets from the queue to the given channel until the queue's closed, and then closes
+// the channel. The channel should be unbuffered so that each is only taken from the queue once a
+// worker is free to build it.
+func (q *buildQueue) Run(ch chan<- BuildTask) {
+	defer close(ch)
+	for {
+		q.mutex.Lock()
+		for len(q.targets) == 0 && !q.closed {
+			q.cond.Wait()
+		}
+		if q.closed {
+			q.mutex.Unlock()
+			return
+		}
+		target := heap.Pop(&q.targets).(*queuedTarget).target
+		delete(q.queued, target)
+		q.mutex.Unlock()
+		select {
+		case ch <- target.Label:
+		case <-q.done:
+			return
+		}
+	}
+}
+
+type queuedTarget struct {
+	target   *BuildTarget
+	priority int64
+	seq      int
+	index    int
+}
+
+// A buildHeap implements heap.Interface for queued targets. Those with equal priority are
+// built in the order they were queued.
+type buildHeap []*queuedTarget
+
+func (h buildHeap) Len() int { return len(h) }
+func (h buildHeap) Swap(i, j int) {
+	h[i], h[j] = h[j], h[i]
+	h[i].index = i
+	h[j].index = j
+}
+func (h buildHeap) Less(i, j int) bool {
+	if h[i].priority != h[j].priority {
+		return h[i].priority > h[j].priority
+	}
+	return h[i].seq < h[j].seq
+}
+
+func (h *buildHeap) Push(x interface{}) {
+	qt := x.(*queuedTarget)
+	qt.index = len(*h)
+	*h = append(*h, qt)
+}
+
+func (h *buildHeap) Pop() interface{} {
+	old := *h
+	n := len(old)
+	x := old[n-1]
+	*h = old[:n-1]
+	return x
+}
@@ -0,0 +1,76 @@
+package core
+
+import (
+	"path"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestBuildQueueOrder(t *testing.T) {
+	durations := loadLabelStore(path.Join(t.TempDir(), "durations"))
+	target := func(name string, duration int64) *BuildTarget {
+		target := NewBuildTarget(BuildLabel{PackageName: "package", Name: name})
+		durations.Set(target.Label, duration)
+		return target
+	}
+	// link depends on two compiles, one of which is on a longer chain (via gen).
+	link := target("link", 10)
+	compile1 := target("compile1", 5)
+	compile2 := target("compile2", 5)
+	gen := target("gen", 1)
+	other := target("other", 12)
+
+	q := newBuildQueue(durations)
+	q.RaisePriority(link, nil)
+	q.RaisePriority(other, nil)
+	q.RaisePriority(compile1, link)
+	q.RaisePriority(compile2, link)
+	q.RaisePriority(gen, compile2)
+	assert.EqualValues(t, 16, gen.priority)
+
+	q.Push(compile1)
+	q.Push(other)
+	q.Push(gen)
+	ch := make(chan BuildTask)
+	go q.Run(ch)
+	assert.Equal(t, gen.Label, <-ch)
+	assert.Equal(t, compile1.Label, <-ch)
+	assert.Equal(t, other.Label, <-ch)
+	q.Close()
+	_, open := <-ch
+	assert.False(t, open)
+}
+
+func TestBuildQueueRaisesQueuedDependencies(t *testing.T) {
+	durations := loadLabelStore(path.Join(t.TempDir(), "durations"))
+	label := func(name string) BuildLabel { return BuildLabel{PackageName: "package", Name: name} }
+	// gen is queued before anything knows that test needs it (via compile), so its priority is
+	// only settled once test's is.
+	test := NewBuildTarget(label("test"))
+	compile := NewBuildTarget(label("compile"))
+	gen := NewBuildTarget(label("gen"))
+	other := NewBuildTarget(label("other"))
+	compile.resolveDependency(gen.Label, gen)
+	test.resolveDependency(compile.Label, compile)
+	durations.Set(test.Label, 20)
+	durations.Set(compile.Label, 5)
+	durations.Set(gen.Label, 1)
+	durations.Set(other.Label, 10)
+
+	q := newBuildQueue(durations)
+	q.RaisePriority(other, nil)
+	q.RaisePriority(compile, nil)
+	q.RaisePriority(gen, compile)
+	q.Push(gen)
+	q.Push(other)
+	q.RaisePriority(test, nil)
+	q.RaisePriority(compile, test)
+	assert.EqualValues(t, 26, gen.priority)
+
+	ch := make(chan BuildTask)
+	go q.Run(ch)
+	assert.Equal(t, gen.Label, <-ch)
+	assert.Equal(t, other.Label, <-ch)
+	q.Close()
+}
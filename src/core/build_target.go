@@ -6,6 +6,7 @@ import (
 	"path"
 	"path/filepath"
 	"sort"
+	"strconv"
 	"strings"
 	"sync"
 	"sync/atomic"
@@ -14,6 +15,7 @@ import (
 	"golang.org/x/sync/errgroup"
 
 	"github.com/thought-machine/please/src/fs"
+	"github.com/thought-machine/please/src/process"
 )
 
 // OutDir is the root output directory for everything.
@@ -51,6 +53,36 @@ const CoverageFile = "test.coverage"
 // execution API requires that we specify which is which.
 const TestResultsDirLabel = "test_results_dir"
 
+// PersistentTestWorkerLabel is a known label that indicates that the test's binary can be kept running
+// as a worker and asked to run its tests repeatedly, rather than being started again for each run.
+const PersistentTestWorkerLabel = "persistent_test_worker"
+
+// BenchmarkBaselineLabel is a prefix for a label that gives the path (relative to the repo root) of a
+// file of Google Benchmark results that a benchmark's results are compared against.
+const BenchmarkBaselineLabel = "benchmark_baseline:"
+
+// BenchmarkToleranceLabel is a prefix for a label that gives the percentage by which a benchmark may
+// be slower than its baseline before it's considered to have failed.
+const BenchmarkToleranceLabel = "benchmark_tolerance:"
+
+// LinkInputsLabel is a known label that indicates that the object files & archives among the target's
+// inputs should be listed in order in a file in its temporary directory (see LinkInputs), which can be
+// given to the linker as a response file.
+const LinkInputsLabel = "link_inputs"
+
+// LinkInputsFileName is the name of the file written for targets labelled with LinkInputsLabel.
+const LinkInputsFileName = ".plz_link_inputs"
+
+// NoCacheLabel is a known label that indicates that the target's outputs depend on the machine it's
+// built on (e.g. the results of pkg-config) in ways its hash can't capture, so they're never stored in
+// or retrieved from the cache.
+const NoCacheLabel = "no_cache"
+
+// TraceEventsLabel is a prefix for a label that gives a glob of files (relative to the target's temporary
+// directory) that its build action writes Chrome trace events into, e.g. clang's -ftime-trace output.
+// These are merged into the trace file if one is being written.
+const TraceEventsLabel = "trace_events:"
+
 // tempOutputSuffix is the suffix we attach to temporary outputs to avoid name clashes.
 const tempOutputSuffix = ".out"
 
@@ -116,6 +148,16 @@ type BuildTarget struct {
 	// This would be false for most 'normal' genrules but true for eg. compiler steps
 	// that need to build in everything.
 	NeedsTransitiveDependencies bool `name:"needs_transitive_deps"`
+	// Glob, relative to the temp directory, matching Make-format dependency files that the build
+	// command writes to list the inputs it actually used. If set, changes to any other inputs
+	// won't cause the target to be rebuilt.
+	Depfile string `name:"depfile"`
+	// Shell command to run to derive an additional cache key for this target. Its output is hashed
+	// along with the build command, so outputs can be retrieved from the cache after their inputs
+	// have changed in ways that don't affect what the command prints.
+	CacheKeyCommand string `name:"cache_key_cmd"`
+	// Per-configuration cache key commands to run.
+	CacheKeyCommands map[string]string `name:"cache_key_cmd"`
 	// True if this target blocks recursive exploring for transitive dependencies.
 	// This is typically false for _library rules which aren't complete, and true
 	// for _binary rules which normally are, and genrules where you don't care about
@@ -149,6 +191,9 @@ type BuildTarget struct {
 	Results TestSuite `print:"false"`
 	// The number of completed runs
 	completedRuns int `print:"false"`
+	// How long the longest chain of build actions from this target to a requested one is estimated to take,
+	// used to prioritise building it. Only set if we're doing that.
+	priority int64 `print:"false"`
 	// Description displayed while the command is building.
 	// Default is just "Building" but it can be customised.
 	BuildingDescription string `name:"building_description"`
@@ -192,6 +237,8 @@ type BuildTarget struct {
 	PassUnsafeEnv *[]string `name:"pass_unsafe_env"`
 	// Flakiness of test, ie. number of times we will rerun it before giving up. 1 is the default.
 	Flakiness int `name:"flaky"`
+	// Number of shards to split the test into, which are run in parallel. 0 or 1 means it isn't sharded.
+	TestShards int `name:"test_shards"`
 	// Timeouts for build/test actions
 	BuildTimeout time.Duration `name:"timeout"`
 	TestTimeout  time.Duration `name:"test_timeout"`
@@ -206,6 +253,8 @@ type BuildTarget struct {
 	EntryPoints map[string]string `name:"entry_points"`
 	// Used to arbitrate concurrent access to dependencies, and to the test results.
 	mutex sync.RWMutex `print:"false"`
+	// Memoised results of labelsBelow, by prefix. Only populated once the target has built.
+	transitiveLabels map[string][]string `print:"false"`
 	// Used to notify once this target has built successfully.
 	finishedBuilding chan struct{} `print:"false"`
 	// Env are any custom environment variables to set for this build target
@@ -232,6 +281,11 @@ type BuildMetadata struct {
 	Test bool
 	// True if the results were retrieved from a cache, false if we ran the full build action.
 	Cached bool
+	// Resources consumed by the build action when it ran locally.
+	ResourceUsage process.ResourceUsage
+	// The inputs that the build action reported using via its depfile, and a hash of them at the time.
+	UsedInputs     []string
+	UsedInputsHash []byte
 }
 
 // A PreBuildFunction is a type that allows hooking a pre-build callback.
@@ -370,6 +424,11 @@ func (target *BuildTarget) TestDir(runNumber int) string {
 	return path.Join(target.TestDirs(), fmt.Sprint("run_", runNumber))
 }
 
+// TestShardDir returns the test directory for one shard of a test run.
+func (target *BuildTarget) TestShardDir(runNumber, shard int) string {
+	return path.Join(target.TestDirs(), fmt.Sprintf("run_%d_shard_%d", runNumber, shard))
+}
+
 // TestDirs contains the parent directory of all the test run directories above
 func (target *BuildTarget) TestDirs() string {
 	return path.Join(TmpDir, target.Label.Subrepo, target.Label.PackageName, target.Label.Name+testDirSuffix)
@@ -389,11 +448,21 @@ func (target *BuildTarget) TestResultsFile() string {
 	return path.Join(target.OutDir(), ".test_results_"+target.Label.Name)
 }
 
+// TestShardResultsFile returns the output results file for one shard of this target's tests.
+func (target *BuildTarget) TestShardResultsFile(shard int) string {
+	return fmt.Sprintf("%s_shard_%d", target.TestResultsFile(), shard)
+}
+
 // CoverageFile returns the output coverage file for tests for this target.
 func (target *BuildTarget) CoverageFile() string {
 	return path.Join(target.OutDir(), ".test_coverage_"+target.Label.Name)
 }
 
+// TestShardCoverageFile returns the output coverage file for one shard of this target's tests.
+func (target *BuildTarget) TestShardCoverageFile(shard int) string {
+	return fmt.Sprintf("%s_shard_%d", target.CoverageFile(), shard)
+}
+
 // AddTestResults adds results to the target
 func (target *BuildTarget) AddTestResults(results TestSuite) {
 	target.mutex.Lock()
@@ -997,6 +1066,9 @@ func (target *BuildTarget) SyncUpdateState(before, after BuildTargetState) bool
 func (target *BuildTarget) AddLabel(label string) {
 	if !target.HasLabel(label) {
 		target.Labels = append(target.Labels, label)
+		target.mutex.Lock()
+		target.transitiveLabels = nil
+		target.mutex.Unlock()
 	}
 }
 
@@ -1021,6 +1093,105 @@ func (target *BuildTarget) PrefixedLabels(prefix string) []string {
 	return ret
 }
 
+// TransitiveLabels returns all labels with the given prefix (which is removed) of this target and its
+// transitive dependencies, except that it doesn't descend into dependencies of those that are
+// OutputIsComplete. The result is sorted and must not be modified.
+// Results for dependencies that have already built are memoised, so calling this for many targets
+// in a large graph doesn't walk all of it each time.
+func (target *BuildTarget) TransitiveLabels(prefix string) []string {
+	return target.mergedLabels(prefix, true)
+}
+
+// labelsBelow returns the labels with the given prefix that a dependent of this target sees from it.
+func (target *BuildTarget) labelsBelow(prefix string) []string {
+	built := target.State() >= Built
+	if built {
+		target.mutex.RLock()
+		labels, present := target.transitiveLabels[prefix]
+		target.mutex.RUnlock()
+		if present {
+			return labels
+		}
+	}
+	labels := target.mergedLabels(prefix, !target.OutputIsComplete)
+	if built {
+		target.mutex.Lock()
+		if target.transitiveLabels == nil {
+			target.transitiveLabels = map[string][]string{}
+		}
+		target.transitiveLabels[prefix] = labels
+		target.mutex.Unlock()
+	}
+	return labels
+}
+
+// mergedLabels returns this target's own labels with the given prefix, merged with those of its dependencies if deps is true.
+func (target *BuildTarget) mergedLabels(prefix string, deps bool) []string {
+	own := []string{}
+	for _, l := range target.Labels {
+		if strings.HasPrefix(l, prefix) {
+			own = append(own, strings.TrimSpace(strings.TrimPrefix(l, prefix)))
+		}
+	}
+	sort.Strings(own)
+	sets := [][]string{own}
+	if deps {
+		for _, dep := range target.Dependencies() {
+			sets = append(sets, dep.labelsBelow(prefix))
+		}
+	}
+	return mergeSortedLabels(sets)
+}
+
+// mergeSortedLabels merges a series of sorted label sets into one, without duplicates.
+// If only one of them is non-empty it is returned as-is, so identical sets can be shared between targets.
+func mergeSortedLabels(sets [][]string) []string {
+	var nonEmpty [][]string
+	for _, set := range sets {
+		if len(set) > 0 {
+			nonEmpty = append(nonEmpty, set)
+		}
+	}
+	if len(nonEmpty) == 0 {
+		return nil
+	} else if len(nonEmpty) == 1 && sort.StringsAreSorted(nonEmpty[0]) && !hasAdjacentDuplicates(nonEmpty[0]) {
+		return nonEmpty[0]
+	}
+	var all []string
+	for _, set := range nonEmpty {
+		all = append(all, set...)
+	}
+	sort.Strings(all)
+	ret := all[:0]
+	for i, l := range all {
+		if i == 0 || l != all[i-1] {
+			ret = append(ret, l)
+		}
+	}
+	return ret
+}
+
+// hasAdjacentDuplicates returns true if any two consecutive strings in the given slice are equal.
+func hasAdjacentDuplicates(s []string) bool {
+	for i := 1; i < len(s); i++ {
+		if s[i] == s[i-1] {
+			return true
+		}
+	}
+	return false
+}
+
+// CPUs returns the number of CPUs this target expects to use while building, as indicated by a
+// cpus: label. Defaults to 1 if it has no such label.
+func (target *BuildTarget) CPUs() int {
+	for _, l := range target.PrefixedLabels("cpus:") {
+		if n, err := strconv.Atoi(l); err == nil && n > 0 {
+			return n
+		}
+	}
+	return 1
+}
+
 // HasAnyLabel returns true if target has any of these labels.
 func (target *BuildTarget) HasAnyLabel(labels []string) bool {
 	for _, label := range labels {
@@ -1277,6 +1448,18 @@ func (target *BuildTarget) AddTestCommand(config, command string) {
 	}
 }
 
+// AddCacheKeyCommand adds a new config-specific cache key command to this build target.
+// Adding a general command is still done by simply setting the CacheKeyCommand member.
+func (target *BuildTarget) AddCacheKeyCommand(config, command string) {
+	if target.CacheKeyCommand != "" {
+		panic(fmt.Sprintf("Adding named cache key command %s to %s, but it already has a general cache key command set", config, target.Label))
+	} else if target.CacheKeyCommands == nil {
+		target.CacheKeyCommands = map[string]string{config: command}
+	} else {
+		target.CacheKeyCommands[config] = command
+	}
+}
+
 // GetCommand returns the command we should use to build this target for the current config.
 func (target *BuildTarget) GetCommand(state *BuildState) string {
 	return target.getCommand(state, target.Commands, target.Command)
@@ -1295,6 +1478,11 @@ func (target *BuildTarget) GetTestCommand(state *BuildState) string {
 	return target.getCommand(state, target.TestCommands, target.TestCommand)
 }
 
+// GetCacheKeyCommand returns the command we should use to derive a cache key for this target for the current config.
+func (target *BuildTarget) GetCacheKeyCommand(state *BuildState) string {
+	return target.getCommand(state, target.CacheKeyCommands, target.CacheKeyCommand)
+}
+
 func (target *BuildTarget) getCommand(state *BuildState, commands map[string]string, singleCommand string) string {
 	if commands == nil {
 		return singleCommand
@@ -1326,6 +1514,20 @@ func (target *BuildTarget) AllSources() []BuildInput {
 	return target.allBuildInputs(target.Sources, target.NamedSources)
 }
 
+// allSourcesExcept is like AllSources, but skips the named sources with any of the given names.
+func (target *BuildTarget) allSourcesExcept(except map[string]bool) []BuildInput {
+	if len(except) == 0 {
+		return target.AllSources()
+	}
+	named := make(map[string][]BuildInput, len(target.NamedSources))
+	for name, srcs := range target.NamedSources {
+		if !except[name] {
+			named[name] = srcs
+		}
+	}
+	return target.allBuildInputs(target.Sources, named)
+}
+
 func (target *BuildTarget) allBuildInputs(unnamed []BuildInput, named map[string][]BuildInput) []BuildInput {
 	ret := unnamed
 	keys := make([]string, 0, len(named))
@@ -24,6 +24,7 @@ func TestOutDir(t *testing.T) {
 func TestTestDir(t *testing.T) {
 	target := makeTarget1("//mickey/donald:goofy", "")
 	assert.Equal(t, "plz-out/tmp/mickey/donald/goofy._test/run_1", target.TestDir(1))
+	assert.Equal(t, "plz-out/tmp/mickey/donald/goofy._test/run_1_shard_2", target.TestShardDir(1, 2))
 }
 
 func TestTmpDirSubrepo(t *testing.T) {
@@ -276,6 +277,37 @@ func TestLabels(t *testing.T) {
 	assert.True(t, target.HasLabel("test"))
 }
 
+func TestTransitiveLabels(t *testing.T) {
+	target1 := makeTarget1WithLabels("//src/core:target1", "cc:ld:-lz", "cc:ld:-lm")
+	target2 := makeTarget1("//src/core:target2", "PUBLIC", target1)
+	target2.AddLabel("cc:ld:-lz")
+	target2.OutputIsComplete = true
+	target3 := makeTarget1("//src/core:target3", "PUBLIC", target2)
+	target3.AddLabel("cc:ld:-lpthread")
+	target4 := makeTarget1("//src/core:target4", "PUBLIC", target3, target1)
+	// target1's labels come through target2 for itself, but target3 doesn't see past target2.
+	assert.Equal(t, []string{"-lm", "-lz"}, target2.TransitiveLabels("cc:ld:"))
+	assert.Equal(t, []string{"-lpthread", "-lz"}, target3.TransitiveLabels("cc:ld:"))
+	assert.Equal(t, []string{"-lm", "-lpthread", "-lz"}, target4.TransitiveLabels("cc:ld:"))
+
+	// Results are only reused once the dependency has built.
+	target1.AddLabel("cc:ld:-ldl")
+	assert.Equal(t, []string{"-ldl", "-lm", "-lpthread", "-lz"}, target4.TransitiveLabels("cc:ld:"))
+	target3.SetState(Built)
+	assert.Equal(t, []string{"-lpthread", "-lz"}, target3.labelsBelow("cc:ld:"))
+	target3.Labels = nil // Not a real thing to do, but shows that it's memoised.
+	assert.Equal(t, []string{"-ldl", "-lm", "-lpthread", "-lz"}, target4.TransitiveLabels("cc:ld:"))
+	target3.AddLabel("cc:ld:-lrt")
+	assert.Equal(t, []string{"-ldl", "-lm", "-lrt", "-lz"}, target4.TransitiveLabels("cc:ld:"))
+}
+
+func TestCPUs(t *testing.T) {
+	target := makeTarget1("//src/core:target1", "PUBLIC")
+	assert.Equal(t, 1, target.CPUs())
+	target.AddLabel("cpus:4")
+	assert.Equal(t, 4, target.CPUs())
+}
+
 func TestGetCommandConfig(t *testing.T) {
 	target := makeTarget1("//src/core:target1", "PUBLIC")
 	target.Command = "test1"
@@ -243,6 +243,8 @@ func ReadConfigFiles(filenames []string, profiles []string) (*Configuration, err
 	// We can only verify options by reflection (we need struct tags) so run them quickly through this.
 	return config, config.ApplyOverrides(map[string]string{
 		"build.hashfunction": config.Build.HashFunction,
+		"cpp.lto":            config.Cpp.Lto,
+		"cpp.linker":         config.Cpp.Linker,
 	})
 }
 
@@ -298,6 +300,7 @@ func DefaultConfiguration() *Configuration {
 	config.Build.Config = "opt"         // Optimised builds by default
 	config.Build.FallbackConfig = "opt" // Optimised builds as a fallback on any target that doesn't have a matching one set
 	config.Build.Xattrs = true
+	config.Build.HashIndex = true
 	config.Build.HashFunction = "sha256"
 	config.BuildConfig = map[string]string{}
 	config.BuildEnv = map[string]string{}
@@ -348,6 +351,13 @@ func DefaultConfiguration() *Configuration {
 	config.Cpp.DefaultDbgCppflags = "--std=c++11 -g3 -pipe -DDEBUG -Wall -Werror"
 	config.Cpp.Coverage = true
 	config.Cpp.ClangModules = true
+	config.Cpp.Lto = "none"
+	config.Cpp.Linker = "default"
+	config.Cpp.CoverageMode = "gcov"
+	config.Cpp.LlvmProfdataTool = "llvm-profdata"
+	config.Cpp.BoltTool = "llvm-bolt"
+	config.Cpp.BoltFlags = "-reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions -split-all-cold -split-eh -dyno-stats"
+	config.Cpp.LlvmCovTool = "llvm-cov"
 	config.Proto.ProtocTool = "protoc"
 	// We're using the most common names for these; typically gRPC installs the builtin plugins
 	// as grpc_python_plugin etc.
@@ -419,6 +429,7 @@ type Configuration struct {
 		Lang                 string       `help:"Sets the language passed to build rules when building. This can be important for some tools (although hopefully not many) - we've mostly observed it with Sass."`
 		Sandbox              bool         `help:"Deprecated, use sandbox.build instead."`
 		Xattrs               bool         `help:"True (the default) to attempt to use xattrs to record file metadata. If false Please will fall back to using additional files where needed, which is more compatible but has slightly worse performance."`
+		HashIndex            bool         `help:"True (the default) to keep an index of the hashes of source files in plz-out between runs, along with their size, modification time and inode. Files that haven't changed according to those aren't read again, which saves a lot of time hashing things like C++ headers when starting up in a large repo."`
 		PleaseSandboxTool    string       `help:"Deprecated, use sandbox.tool instead."`
 		Nonce                string       `help:"This is an arbitrary string that is added to the hash of every build target. It provides a way to force a rebuild of everything when it's changed.\nWe will bump the default of this whenever we think it's required - although it's been a pretty long time now and we hope that'll continue."`
 		PassEnv              []string     `help:"A list of environment variables to pass from the current environment to build rules. For example\n\nPassEnv = HTTP_PROXY\n\nwould copy your HTTP_PROXY environment variable to the build env for any rules."`
@@ -427,6 +438,8 @@ type Configuration struct {
 		HashFunction         string       `help:"The hash function to use internally for build actions." options:"sha1,sha256"`
 		ExitOnError          bool         `help:"True to have build actions automatically fail on error (essentially passing -e to the shell they run in)." var:"EXIT_ON_ERROR"`
 		LinkGeneratedSources bool         `help:"If set, supported build definitions will link generated sources back into the source tree. The list of generated files can be generated for the .gitignore through 'plz query print --label gitignore: //...'. Defaults to false." var:"LINK_GEN_SOURCES"`
+		CriticalPath         bool         `help:"If true, local build actions are started in order of how long the chain of actions from them to the requested targets is likely to take, based on how long each took the last time it was built, rather than the order they're ready in. This gets the slowest chains (e.g. compiles feeding a large link) going first so the end of the build isn't spent waiting for them."`
+		MemoryBudget         cli.ByteSize `help:"If set, limits the build actions running at once to roughly this much memory between them, as well as by the number of threads. Each is assumed to need as much as it used at its peak the last time it was built locally; ones that haven't been built before aren't held back.\nCan also be given with human-readable suffixes like 16G, 512MB etc."`
 	} `help:"A config section describing general settings related to building targets in Please.\nSince Please is by nature about building things, this only has the most generic properties; most of the more esoteric properties are configured in their own sections."`
 	BuildConfig map[string]string `help:"A section of arbitrary key-value properties that are made available in the BUILD language. These are often useful for writing custom rules that need some configurable property.\n\n[buildconfig]\nandroid-tools-version = 23.0.2\n\nFor example, the above can be accessed as CONFIG.ANDROID_TOOLS_VERSION."`
 	BuildEnv    map[string]string `help:"A set of extra environment variables to define for build rules. For example:\n\n[buildenv]\nsecret-passphrase = 12345\n\nThis would become SECRET_PASSPHRASE for any rules. These can be useful for passing secrets into custom rules; any variables containing SECRET or PASSWORD won't be logged.\n\nIt's also useful if you'd like internal tools to honour some external variable."`
@@ -442,6 +455,7 @@ type Configuration struct {
 		HTTPTimeout                cli.Duration `help:"Timeout for operations contacting the HTTP cache, in seconds."`
 		HTTPConcurrentRequestLimit int          `help:"The maximum amount of concurrent requests that can be open. Default 20."`
 		HTTPRetry                  int          `help:"The maximum number of retries before a request will give up, if a request is retryable"`
+		HTTPChunkThreshold         cli.ByteSize `help:"Files at least this big are stored in the HTTP cache in chunks, split at boundaries determined by their contents. Each chunk is compressed with zstd and stored under /chunks/<sha256 of its contents>, and only uploaded if it isn't there already (which is checked with a HEAD request), so the unchanged parts of e.g. a large relinked binary aren't sent again.\nEvery client reading from the cache has to support this, so it's disabled by default."`
 	} `help:"Please has several built-in caches that can be configured in its config file.\n\nThe simplest one is the directory cache which by default is written into the .plz-cache directory. This allows for fast retrieval of code that has been built before (for example, when swapping Git branches).\n\nThere is also a remote RPC cache which allows using a centralised server to store artifacts. A typical pattern here is to have your CI system write artifacts into it and give developers read-only access so they can reuse its work.\n\nFinally there's a HTTP cache which is very similar, but a little obsolete now since the RPC cache outperforms it and has some extra features. Otherwise the two have similar semantics and share quite a bit of implementation.\n\nPlease has server implementations for both the RPC and HTTP caches."`
 	Test struct {
 		Timeout                  cli.Duration `help:"Default timeout applied to all tests. Can be overridden on a per-rule basis."`
@@ -452,11 +466,20 @@ type Configuration struct {
 		StoreTestOutputOnSuccess bool         `help:"True to store stdout and stderr in the test results for successful tests."`
 	} `help:"A config section describing settings related to testing in general."`
 	Sandbox struct {
-		Tool      string   `help:"The location of the tool to use for sandboxing. This can assume it is being run in a new network, user, and mount namespace on linux. If not set, Please will use 'plz sandbox'."`
-		Dir       []string `help:"Directories to hide within the sandbox"`
-		Namespace string   `help:"Set to 'always', to namespace all actions. Set to 'sandbox' to namespace only when sandboxing the build action. Defaults to 'never', under the assumption the sandbox tool will handle its own namespacing. If set, user namespacing will be enabled for all rules. Mount and network will only be enabled if the rule is to be sandboxed."`
-		Build     bool     `help:"True to sandbox individual build actions, which isolates them from network access and some aspects of the filesystem. Currently only works on Linux." var:"BUILD_SANDBOX"`
-		Test      bool     `help:"True to sandbox individual tests, which isolates them from network access, IPC and some aspects of the filesystem. Currently only works on Linux." var:"TEST_SANDBOX"`
+		Tool        string       `help:"The location of the tool to use for sandboxing. This can assume it is being run in a new network, user, and mount namespace on linux. If not set, Please will use 'plz sandbox'."`
+		Dir         []string     `help:"Directories to hide within the sandbox"`
+		Namespace   string       `help:"Set to 'always', to namespace all actions. Set to 'sandbox' to namespace only when sandboxing the build action. Defaults to 'never', under the assumption the sandbox tool will handle its own namespacing. If set, user namespacing will be enabled for all rules. Mount and network will only be enabled if the rule is to be sandboxed."`
+		Build       bool         `help:"True to sandbox individual build actions, which isolates them from network access and some aspects of the filesystem. Currently only works on Linux." var:"BUILD_SANDBOX"`
+		Test        bool         `help:"True to sandbox individual tests, which isolates them from network access, IPC and some aspects of the filesystem. Currently only works on Linux." var:"TEST_SANDBOX"`
+		Overlay     bool         `help:"True to present the outputs of dependencies to sandboxed build actions through an overlayfs mount, with a separate directory holding only the declared inputs as its lower layer and the build directory as its upper one. This keeps the inputs apart from what the action writes, so they can't be modified by it. Requires overlayfs support in user namespaces (usually Linux >= 5.11)."`
+		Server      bool         `help:"True to run the sandbox tool once as a long-lived server instead of executing it separately for each action. This amortises the cost of setting up namespaces across many actions. Only applies when an external sandbox tool is in use (i.e. please_sandbox) and namespace is 'never'."`
+		Cgroup      string       `help:"A cgroup v2 directory (e.g. /sys/fs/cgroup/user.slice/user-1000.slice/plz) which the current user can write to. If set, please_sandbox will run each sandboxed action in its own new cgroup beneath it, which lets it apply the limits below. Any controllers needed for those limits must be enabled in its cgroup.subtree_control. Not supported by the builtin sandbox."`
+		MemoryMax   string       `help:"Limit on the memory usable by each sandboxed action, in the format of cgroup v2's memory.max (e.g. 4G). Requires cgroup to be set."`
+		CPUMax      string       `help:"Limit on the CPU bandwidth of each sandboxed action, in the format of cgroup v2's cpu.max (e.g. '200000 100000' for two cores). Requires cgroup to be set."`
+		PidsMax     int          `help:"Limit on the number of processes each sandboxed action can have running at once. Requires cgroup to be set."`
+		TmpfsSize   cli.ByteSize `help:"Maximum size of the tmpfs mounted on /tmp for each sandboxed action. Can be overridden for each size of target (see the size section) or for individual targets with a label like tmpfs:512M; the label tmpfs:none gives them no scratch space outside their own directory at all. Defaults to the kernel's default (half of RAM)."`
+		TmpfsInodes int          `help:"Maximum number of inodes in the tmpfs mounted on /tmp for each sandboxed action. Defaults to the kernel's default."`
+		TmpfsHuge   bool         `help:"True to use transparent huge pages for files in the sandbox tmpfs that are large enough to fill them (i.e. huge=within_size)."`
 	} `help:"A config section describing settings relating to sandboxing of build actions."`
 	Remote struct {
 		URL           string       `help:"URL for the remote server."`
@@ -475,6 +498,7 @@ type Configuration struct {
 		Platform      []string     `help:"Platform properties to request from remote workers, in the format key=value."`
 		CacheDuration cli.Duration `help:"Length of time before we re-check locally cached build actions. Default is unlimited."`
 		BuildID       string       `help:"ID of the build action that's being run, to attach to remote requests."`
+		BatchDuration cli.Duration `help:"If set, build actions that need their transitive dependencies (for example C++ compiles) and took less than this to execute last time are grouped with others from the same package into one remote action of up to about this long, which saves the overhead of scheduling each individually. Each is still cached individually. Disabled by default."`
 	} `help:"Settings related to remote execution & caching using the Google remote execution APIs. This section is still experimental and subject to change."`
 	Size  map[string]*Size `help:"Named sizes of targets; these are the definitions of what can be passed to the 'size' argument."`
 	Cover struct {
@@ -530,7 +554,7 @@ type Configuration struct {
 		Toolchain          string    `help:"A label identifying a java_toolchain." var:"JAVA_TOOLCHAIN"`
 	} `help:"Please has built-in support for compiling Java.\nIt builds uber-jars for binary and test rules which contain all dependencies and can be easily deployed, and with the help of some of Please's additional tools they are deterministic as well.\n\nWe've only tested support for Java 7 and 8, although it's likely newer versions will work with little or no change."`
 	Cpp struct {
-		CCTool             string     `help:"The tool invoked to compile C code. Defaults to gcc but you might want to set it to clang, for example." var:"CC_TOOL"`
+		CCTool             string     `help:"The tool invoked to compile C code. Defaults to gcc but you might want to set it to clang, for example.\nThis and the other tools can also be build labels, e.g. the entry points of a cc_toolchain rule, so the compiler is a hashed input to every action that uses it instead of whatever is found on the path." var:"CC_TOOL"`
 		CppTool            string     `help:"The tool invoked to compile C++ code. Defaults to g++ but you might want to set it to clang++, for example." var:"CPP_TOOL"`
 		LdTool             string     `help:"The tool invoked to link object files. Defaults to ld but you could also set it to gold, for example." var:"LD_TOOL"`
 		ArTool             string     `help:"The tool invoked to archive static libraries. Defaults to ar." var:"AR_TOOL"`
@@ -541,10 +565,32 @@ type Configuration struct {
 		DefaultDbgCppflags string     `help:"Compiler rules passed to all C++ rules during dbg builds.\nDefaults to --std=c++11 -g3 -DDEBUG -Wall -Wextra -Werror." var:"DEFAULT_DBG_CPPFLAGS"`
 		DefaultLdflags     string     `help:"Linker flags passed to all C++ rules.\nBy default this is empty." var:"DEFAULT_LDFLAGS"`
 		PkgConfigPath      string     `help:"Custom PKG_CONFIG_PATH for pkg-config.\nBy default this is empty." var:"PKG_CONFIG_PATH"`
-		Coverage           bool       `help:"If true (the default), coverage will be available for C and C++ build rules.\nThis is still a little experimental but should work for GCC. Right now it does not work for Clang (it likely will in Clang 4.0 which will likely support --fprofile-dir) and so this can be useful to disable it.\nIt's also useful in some cases for CI systems etc if you'd prefer to avoid the overhead, since the tests have to be compiled with extra instrumentation and without optimisation." var:"CPP_COVERAGE"`
+		Coverage           bool       `help:"If true (the default), coverage will be available for C and C++ build rules.\nThis is still a little experimental. It uses gcov by default, which works for GCC; set coveragemode to llvm for Clang.\nDisabling it can be useful in some cases for CI systems etc if you'd prefer to avoid the overhead, since the tests have to be compiled with extra instrumentation and without optimisation." var:"CPP_COVERAGE"`
 		TestMain           BuildLabel `help:"The build target to use for the default main for C++ test rules." example:"///pleasings//cc:unittest_main" var:"CC_TEST_MAIN"`
+		BenchmarkMain      BuildLabel `help:"The build target to use for the main for cc_benchmark rules, which should be Google Benchmark's benchmark_main." example:"///third_party/cc/benchmark//:benchmark_main" var:"CC_BENCHMARK_MAIN"`
 		ClangModules       bool       `help:"Uses Clang-style arguments for compiling cc_module rules. If disabled gcc-style arguments will be used instead. Experimental, expected to be removed at some point once module compilation methods are more consistent." var:"CC_MODULES_CLANG"`
 		DsymTool           string     `help:"Set this to dsymutil or equivalent on macOS to use this tool to generate xcode symbol information for debug builds." var:"DSYM_TOOL"`
+		BoltTool           string     `help:"The tool used to optimise the layout of cc_binary rules that are given a bolt_profile, after they're linked. Defaults to llvm-bolt." var:"BOLT_TOOL"`
+		BoltFlags          string     `help:"The flags passed to the bolt tool when optimising binaries.\nDefaults to -reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions -split-all-cold -split-eh -dyno-stats" var:"BOLT_FLAGS"`
+		IfsTool            string     `help:"The tool used to generate interface stubs for cc_shared_object rules, i.e. llvm-ifs. If set, each shared object gets a stub containing only its exported dynamic symbols, which rules depending on it link against instead. They are then only relinked when its ABI changes, rather than after any change to its implementation.\nThe shared objects are given a soname so the binaries linked against their stubs load them at runtime; they still need to be found by the dynamic loader, in the same way as any other shared library." var:"CC_IFS_TOOL"`
+		DynamicDev         bool       `help:"If true, dbg builds link each cc_library into a shared object as well as an archive, and cc_binary and cc_test rules are linked against those instead (with rpaths to find them in plz-out). Changing a library then only means relinking its own shared object and cheap dynamic links of the binaries using it, rather than statically relinking all of them.\nThis is intended for local edit-compile-test loops; the binaries aren't suitable for deploying anywhere else. Libraries with alwayslink set are still linked statically." var:"CC_DYNAMIC_DEV"`
+		UnityBatchSize     int        `help:"If greater than 1, the sources of multi-source cc_library rules are concatenated into batches of this many, each compiled as a single translation unit (a \"unity\" or \"jumbo\" build).\nThis reduces the number of compile actions and the time spent repeatedly parsing the same headers, at the cost of incrementality; it can be overridden on individual rules via unity_batch_size. Defaults to 0, i.e. each source is compiled separately." var:"CC_UNITY_BATCH_SIZE"`
+		UseDepfiles        bool       `help:"If true, C and C++ compile steps have the compiler write a depfile (via -MD) listing the headers they actually used, and aren't rebuilt when other headers in their transitive dependencies change.\nThis can avoid a lot of unnecessary rebuilds, but note that it can't notice a newly added header that would be found in preference to one that was used before. It only applies to local builds." var:"CC_USE_DEPFILES"`
+		Lto                string     `help:"Link-time optimisation mode for opt builds. 'thin' compiles objects to bitcode with -flto=thin and has the linker run the ThinLTO backends for each module in parallel; it requires clang. 'full' uses -flto, which works with both gcc and clang.\nThe archiver must understand bitcode objects when this is set, so you will likely want to set artool to gcc-ar or llvm-ar as appropriate. Defaults to none." options:"none,thin,full" var:"CC_LTO"`
+		Linker             string     `help:"The linker that cctool should invoke when linking binaries, which is passed to it as -fuse-ld. lld and mold are typically a great deal faster than the default bfd linker for large binaries. Defaults to default, which uses whatever the compiler does by default.\nThis has no effect when linkwithldtool is set; in that case ldtool is invoked directly." options:"default,bfd,gold,lld,mold" var:"CC_LINKER"`
+		LinkThreads        int        `help:"The number of threads that gold, lld or mold should use for each link. If greater than 1, Please reserves that many of its own build workers while a link is running so the machine isn't oversubscribed. Defaults to 0, which leaves the linker at its most conservative setting." var:"CC_LINK_THREADS"`
+		SplitDwarf         bool       `help:"If true, dbg builds split debug info out of object files into separate .dwo files with -gsplit-dwarf. These are kept in plz-out/gen alongside the rule that compiled them rather than being passed to the archive and link steps, which makes those a lot smaller and faster.\nIf linker is set to gold, lld or mold, binaries are also linked with --gdb-index." var:"CC_SPLIT_DWARF"`
+		DwpTool            string     `help:"The tool used to package the .dwo files of a binary into a single .dwp file when splitdwarf is set, e.g. llvm-dwp. If set, each cc_binary and cc_test gets an extra rule named like _name#dwp that builds it.\nNote that the dwp from binutils can't read DWARF 5 from binaries in the way we need; you'll need to build with -gdwarf-4 to use it." var:"DWP_TOOL"`
+		CompressDebug      bool       `help:"If true, dbg builds compress their debug info sections with -gz, which reduces the size of objects and binaries at some cost in compile and link time." var:"CC_COMPRESS_DEBUG"`
+		ThinArchives       bool       `help:"If true, the archive for a cc_library with multiple sources is a thin archive that refers to the objects in the archives for each source, rather than copying them all again. cc_static_library still produces full archives.\nThis requires a linker that understands GNU thin archives containing members of other archives (i.e. GNU ld or gold)." var:"CC_THIN_ARCHIVES"`
+		PreprocessorCache  bool       `help:"If true, C and C++ compile steps are also stored in the cache under a hash of their preprocessed source, flags and compiler version. Edits that don't change the preprocessed result (e.g. to comments in a widely-included header) then don't cause recompilation for anyone sharing the cache.\nThis costs a preprocessor run for each compile step that isn't retrieved by its rule hash. It only applies to local builds." var:"CC_PREPROCESSOR_CACHE"`
+		ScanDepsTool       string     `help:"The tool used to scan C++ sources for the modules they import, i.e. clang-scan-deps. If set (and clangmodules is on), each source is scanned in P1689 format before it's compiled and only given the interfaces it imports, directly or indirectly, rather than every one in its transitive dependencies. Scans of each cc_module's interfaces are exported to dependents to make that possible." var:"CC_SCAN_DEPS_TOOL"`
+		CoverageMode       string     `help:"The kind of coverage instrumentation used when coverage is enabled. 'gcov' compiles with -fprofile-arcs -ftest-coverage and runs gcov after each test, which is what GCC supports. 'llvm' uses Clang's source-based coverage (-fprofile-instr-generate -fcoverage-mapping), which has much less runtime overhead; each test's raw profiles are merged once with llvm-profdata and exported with llvm-cov. Defaults to gcov." options:"gcov,llvm" var:"CC_COVERAGE_MODE"`
+		LlvmProfdataTool   string     `help:"The tool used to merge raw profiles from tests when coveragemode is llvm. Also used by cc_pgo_profile to merge the profiles from training runs. Defaults to llvm-profdata." var:"LLVM_PROFDATA_TOOL"`
+		LlvmCovTool        string     `help:"The tool used to export coverage from tests when coveragemode is llvm. Defaults to llvm-cov." var:"LLVM_COV_TOOL"`
+		TimeTrace          bool       `help:"If true, C and C++ compile steps are run with clang's -ftime-trace, and the time it spent on each header, template instantiation etc. for each source is merged into the trace file written by --trace_file. This requires clang." var:"CC_TIME_TRACE"`
+		ClangTidyTool      string     `help:"The tool used to lint the sources of cc_library rules, i.e. clang-tidy. If set, each source gets an extra rule named like _name#tidy_<src>, labelled clang_tidy, that runs it with exactly the flags the source is compiled with (including those from its dependencies) and writes its diagnostics to a .tidy file. These are ordinary build rules, so they're run in parallel, cached and can be executed remotely; nothing else depends on them, so they're built with e.g. plz build -i clang_tidy //..." var:"CLANG_TIDY_TOOL"`
+		ClangTidyFlags     string     `help:"Flags passed to clang-tidy when clangtidytool is set, e.g. --checks=... --warnings-as-errors=*. Note that .clang-tidy files in the repo aren't available to it unless they're part of the rules' sources, so checks are best given here." var:"CLANG_TIDY_FLAGS"`
 	} `help:"Please has built-in support for compiling C and C++ code. We don't support every possible nuance of compilation for these languages, but aim to provide something fairly straightforward.\nTypically there is little problem compiling & linking against system libraries although Please has no insight into those libraries and when they change, so cannot rebuild targets appropriately.\n\nThe C and C++ rules are very similar and simply take a different set of tools and flags to facilitate side-by-side usage."`
 	Proto struct {
 		ProtocTool       string   `help:"The binary invoked to compile .proto files. Defaults to protoc." var:"PROTOC_TOOL"`
@@ -604,6 +650,7 @@ type Alias struct {
 type Size struct {
 	Timeout     cli.Duration `help:"Timeout for targets of this size"`
 	TimeoutName string       `help:"Name of the timeout, to be passed to the 'timeout' argument"`
+	Tmpfs       cli.ByteSize `help:"Maximum size of the sandbox tmpfs on /tmp for targets of this size. Overrides tmpfssize in the sandbox section."`
 }
 
 type storedBuildEnv struct {
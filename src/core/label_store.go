@@ -0,0 +1,74 @@
+package core
+
+import (
+	"bytes"
+	"encoding/gob"
+	"os"
+	"path"
+	"sync"
+
+	"github.com/thought-machine/please/src/fs"
+)
+
+// footprintsFile is where we store how much memory build actions used, between builds.
+var footprintsFile = path.Join(OutDir, "log", "memory_footprints")
+
+// durationsFile is where we store how long build actions took, locally or remotely, between builds.
+var durationsFile = path.Join(OutDir, "log", "action_durations")
+
+// hashIndexFile is where we store the hashes of source files between builds (with a suffix for the hash function).
+var hashIndexFile = path.Join(OutDir, "log", "source_hashes")
+
+// A labelStore stores a number about each target's build action from the last time it ran
+// locally (e.g. the peak memory it used), by its label.
+type labelStore struct {
+	filename string
+	values   map[string]int64
+	changed  bool
+	mutex    sync.Mutex
+}
+
+// loadLabelStore loads a previously saved labelStore. It's fine if the file doesn't exist yet.
+func loadLabelStore(filename string) *labelStore {
+	s := &labelStore{filename: filename, values: map[string]int64{}}
+	if f, err := os.Open(filename); err == nil {
+		defer f.Close()
+		if err := gob.NewDecoder(f).Decode(&s.values); err != nil {
+			log.Warning("Failed to load %s: %s", filename, err)
+			s.values = map[string]int64{}
+		}
+	}
+	return s
+}
+
+// Get returns the value recorded for the given target last time, if it's known.
+func (s *labelStore) Get(label BuildLabel) (int64, bool) {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	value, present := s.values[label.String()]
+	return value, present
+}
+
+// Set records the value for the given target.
+func (s *labelStore) Set(label BuildLabel, value int64) {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	if old, present := s.values[label.String()]; !present || old != value {
+		s.values[label.String()] = value
+		s.changed = true
+	}
+}
+
+// Save saves the store to its file, if anything's changed.
+func (s *labelStore) Save() error {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	if !s.changed {
+		return nil
+	}
+	var buf bytes.Buffer
+	if err := gob.NewEncoder(&buf).Encode(s.values); err != nil {
+		return err
+	}
+	return fs.WriteFile(&buf, s.filename, 0644)
+}
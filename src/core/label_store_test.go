@@ -0,0 +1,22 @@
+package core
+
+import (
+	"path"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+func TestLabelStore(t *testing.T) {
+	filename := path.Join(t.TempDir(), "footprints")
+	label := BuildLabel{PackageName: "package", Name: "target"}
+	s := loadLabelStore(filename)
+	_, present := s.Get(label)
+	assert.False(t, present)
+	s.Set(label, 3<<30)
+	require.NoError(t, s.Save())
+	value, present := loadLabelStore(filename).Get(label)
+	assert.True(t, present)
+	assert.EqualValues(t, 3<<30, value)
+}
@@ -1,6 +1,7 @@
 package core
 
 import (
+	"context"
 	"crypto/sha1"
 	"crypto/sha256"
 	"fmt"
@@ -15,6 +16,7 @@ import (
 	"time"
 
 	"github.com/OneOfOne/cmap"
+	"golang.org/x/sync/semaphore"
 	"lukechampine.com/blake3"
 
 	"github.com/thought-machine/please/src/cli"
@@ -174,6 +176,8 @@ type BuildState struct {
 	ShowAllOutput bool
 	// True to attach a debugger on test failure.
 	DebugTests bool
+	// True if we're writing a trace file, in which case the phases of building each target are recorded.
+	Tracing bool
 	// True if we think the underlying filesystem supports xattrs (which affects how we write some metadata).
 	XattrsSupported bool
 	// True if we have any remote executors configured.
@@ -213,6 +217,19 @@ type stateProgress struct {
 	results chan *BuildResult
 	// Internal result stream, used to intermediate them for the cycle checker.
 	internalResults chan *BuildResult
+	// Tracks the CPUs in use by running build actions, for those that need more than one.
+	cpus    *semaphore.Weighted
+	numCPUs int64
+	// Tracks the memory in use by running build actions, if there's a budget for it.
+	memory       *semaphore.Weighted
+	memoryBudget int64
+	footprints   *labelStore
+	// How long build actions took last time, locally or remotely, if anything needs to know.
+	durations *labelStore
+	// Orders local builds by priority, if we're doing that.
+	buildQueue *buildQueue
+	// Phases of building targets, for the trace file.
+	trace traceSpans
 }
 
 // SystemStats stores information about the system.
@@ -261,6 +278,8 @@ func (state *BuildState) addPendingBuild(target *BuildTarget) {
 		}()
 		if state.anyRemote && !target.Local {
 			state.pendingRemoteBuilds <- target.Label
+		} else if state.progress.buildQueue != nil {
+			state.progress.buildQueue.Push(target)
 		} else {
 			state.pendingBuilds <- target.Label
 		}
@@ -297,6 +316,81 @@ func (state *BuildState) TaskQueues() (parses <-chan ParseTask, builds, remoteBu
 	return state.pendingParses, state.pendingBuilds, state.pendingRemoteBuilds, state.pendingTests, state.pendingRemoteTests
 }
 
+// AcquireCPUs blocks until there are enough CPUs available to build the given target (or run
+// one shard of it, for sharded tests), and returns a function to release them again once it's done.
+// Most targets need only one, so don't usually wait, but ones that use several (e.g. multithreaded
+// links) will hold back others from starting until they're done.
+func (state *BuildState) AcquireCPUs(target *BuildTarget) func() {
+	n := int64(target.CPUs())
+	if n > state.progress.numCPUs {
+		n = state.progress.numCPUs
+	}
+	state.progress.cpus.Acquire(context.Background(), n)
+	return func() { state.progress.cpus.Release(n) }
+}
+
+// AcquireMemory blocks until there's enough of the memory budget available to build the given target,
+// based on the peak memory its action used last time, and returns a function to release it again once
+// it's done. Targets that haven't been built before aren't held back.
+// It does nothing if there's no memory budget configured.
+func (state *BuildState) AcquireMemory(target *BuildTarget) func() {
+	if state.progress.memory == nil {
+		return func() {}
+	}
+	n, _ := state.progress.footprints.Get(target.Label)
+	if n > state.progress.memoryBudget {
+		n = state.progress.memoryBudget
+	} else if n <= 0 {
+		return func() {}
+	}
+	state.progress.memory.Acquire(context.Background(), n)
+	return func() { state.progress.memory.Release(n) }
+}
+
+// RecordMemory records the peak memory used by the given target's build action, so next time it's
+// built it can be scheduled against the memory budget. It does nothing if there's no budget configured.
+func (state *BuildState) RecordMemory(target *BuildTarget, maxRSS int64) {
+	if state.progress.memory != nil && maxRSS > 0 {
+		state.progress.footprints.Set(target.Label, maxRSS)
+	}
+}
+
+// RecordDuration records how long the given target's build action took, so next time the targets
+// leading up to it can be prioritised accordingly and it can be batched remotely if it's quick enough.
+// It does nothing unless we're doing either of those.
+func (state *BuildState) RecordDuration(target *BuildTarget, duration time.Duration) {
+	if state.progress.durations != nil {
+		state.progress.durations.Set(target.Label, int64(duration))
+	}
+}
+
+// ActionDuration returns how long the given target's build action took last time, if it's known.
+func (state *BuildState) ActionDuration(target *BuildTarget) (time.Duration, bool) {
+	if state.progress.durations == nil {
+		return 0, false
+	}
+	duration, present := state.progress.durations.Get(target.Label)
+	return time.Duration(duration), present
+}
+
+// SaveBuildHistory saves what was recorded about build actions (how long they took and the memory they used),
+// and the hashes of source files, for subsequent builds.
+func (state *BuildState) SaveBuildHistory() {
+	if err := state.PathHasher.SaveIndex(); err != nil {
+		log.Warning("Failed to save hashes of source files: %s", err)
+	}
+	if state.progress.footprints != nil {
+		if err := state.progress.footprints.Save(); err != nil {
+			log.Warning("Failed to save memory footprints of build actions: %s", err)
+		}
+	}
+	if state.progress.durations != nil {
+		if err := state.progress.durations.Save(); err != nil {
+			log.Warning("Failed to save durations of build actions: %s", err)
+		}
+	}
+}
+
 // TaskDone indicates that a single task is finished. Should be called after one is finished with
 // a task returned from NextTask().
 func (state *BuildState) TaskDone() {
@@ -316,7 +410,11 @@ func (state *BuildState) taskDone(wasSynthetic bool) {
 func (state *BuildState) Stop() {
 	state.progress.closeOnce.Do(func() {
 		close(state.pendingParses)
-		close(state.pendingBuilds)
+		if state.progress.buildQueue != nil {
+			state.progress.buildQueue.Close() // This closes pendingBuilds once it's stopped sending to it.
+		} else {
+			close(state.pendingBuilds)
+		}
 		close(state.pendingRemoteBuilds)
 		close(state.pendingTests)
 		close(state.pendingRemoteTests)
@@ -894,6 +992,9 @@ func (state *BuildState) queueResolvedTarget(target *BuildTarget, rescan, forceB
 // queueTarget enqueues a target's dependencies and the target itself once they are done.
 func (state *BuildState) queueTargetAsync(target *BuildTarget, rescan, forceBuild, building bool) {
 	defer state.taskDone(true)
+	if state.progress.buildQueue != nil {
+		state.progress.buildQueue.RaisePriority(target, nil)
+	}
 	for _, dep := range target.DeclaredDependencies() {
 		if err := state.queueTarget(dep, target.Label, rescan, forceBuild, false); err != nil {
 			state.asyncError(dep, err)
@@ -904,6 +1005,9 @@ func (state *BuildState) queueTargetAsync(target *BuildTarget, rescan, forceBuil
 		called := false
 		if err := target.resolveDependencies(state.Graph, func(t *BuildTarget) error {
 			called = true
+			if state.progress.buildQueue != nil {
+				state.progress.buildQueue.RaisePriority(t, target)
+			}
 			return state.queueResolvedTarget(t, rescan, forceBuild, false)
 		}); err != nil {
 			state.asyncError(target.Label, err)
@@ -1058,6 +1162,10 @@ func sandboxTool(config *Configuration) string {
 // Everyone should use this rather than attempting to construct it themselves;
 // callers can't initialise all the required private fields.
 func NewBuildState(config *Configuration) *BuildState {
+	numCPUs := config.Please.NumThreads
+	if numCPUs < 1 {
+		numCPUs = 1
+	}
 	// Deliberately ignore the error here so we don't require the sandbox tool until it's needed.
 	state := &BuildState{
 		Graph:               NewGraph(),
@@ -1078,6 +1186,7 @@ func NewBuildState(config *Configuration) *BuildState {
 			config.Sandbox.Tool == "" && (config.Sandbox.Build || config.Sandbox.Test),
 			process.NamespacingPolicy(config.Sandbox.Namespace),
 			sandboxTool(config),
+			config.Sandbox.Server,
 		),
 		StartTime:       startTime,
 		Config:          config,
@@ -1097,10 +1206,29 @@ func NewBuildState(config *Configuration) *BuildState {
 			packageWaits:    cmap.New(),
 			success:         true,
 			internalResults: make(chan *BuildResult, 1000),
+			cpus:            semaphore.NewWeighted(int64(numCPUs)),
+			numCPUs:         int64(numCPUs),
 		},
 	}
 	state.PathHasher = state.Hasher(config.Build.HashFunction)
+	if config.Build.HashIndex {
+		state.PathHasher.UseIndex(hashIndexFile + "_" + config.Build.HashFunction)
+	}
 	state.progress.allStates = []*BuildState{state}
+	if config.Build.MemoryBudget > 0 {
+		state.progress.memoryBudget = int64(config.Build.MemoryBudget)
+		state.progress.memory = semaphore.NewWeighted(state.progress.memoryBudget)
+		state.progress.footprints = loadLabelStore(footprintsFile)
+	}
+	if config.Build.CriticalPath || config.Remote.BatchDuration > 0 {
+		state.progress.durations = loadLabelStore(durationsFile)
+	}
+	if config.Build.CriticalPath {
+		// Builds are only taken off the queue once there's a worker ready for them.
+		state.pendingBuilds = make(chan BuildTask)
+		state.progress.buildQueue = newBuildQueue(state.progress.durations)
+		go state.progress.buildQueue.Run(state.pendingBuilds)
+	}
 	state.Hashes.Config = config.Hash()
 	for _, exp := range config.Parse.ExperimentalDir {
 		state.experimentalLabels = append(state.experimentalLabels, BuildLabel{PackageName: exp, Name: "..."})
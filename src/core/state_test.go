@@ -1,6 +1,7 @@
 package core
 
 import (
+	"path"
 	"strings"
 	"testing"
 
@@ -131,3 +132,21 @@ func addTargetDeps(state *BuildState, pkg *Package, name string, deps ...string)
 	state.Graph.AddTarget(target)
 	return target
 }
+
+func TestAcquireMemory(t *testing.T) {
+	config := DefaultConfiguration()
+	config.Build.MemoryBudget = 4 << 30
+	state := NewBuildState(config)
+	state.progress.footprints = loadLabelStore(path.Join(t.TempDir(), "footprints"))
+	heavy := NewBuildTarget(BuildLabel{PackageName: "package", Name: "heavy"})
+	light := NewBuildTarget(BuildLabel{PackageName: "package", Name: "light"})
+	state.RecordMemory(heavy, 10<<30)
+	release := state.AcquireMemory(heavy)
+	// The heavy target is capped at the whole budget, so nothing else that needs memory can start...
+	state.RecordMemory(light, 1<<20)
+	assert.False(t, state.progress.memory.TryAcquire(1<<20))
+	// ...but targets that haven't been built before aren't held back.
+	state.AcquireMemory(NewBuildTarget(BuildLabel{PackageName: "package", Name: "new"}))()
+	release()
+	state.AcquireMemory(light)()
+}
@@ -7,6 +7,7 @@ import (
 	"time"
 
 	"github.com/thought-machine/please/src/fs"
+	"github.com/thought-machine/please/src/process"
 )
 
 // TestSuites describes a collection of test results for a set of targets.
@@ -24,6 +25,8 @@ type TestSuite struct {
 	TestCases  TestCases         // The test cases that ran during execution of this target.
 	Properties map[string]string // The system properties at the time of the test.
 	Timestamp  string            // ISO8601 formatted datetime when the test ran.
+	// Resources consumed by running the test (CPU time is summed over all runs, memory is the peak of any).
+	ResourceUsage process.ResourceUsage
 }
 
 // JavaStyleName pretends we are using a language that has package names and classnames etc.
@@ -36,6 +39,7 @@ func (testSuite *TestSuite) Collapse(incoming TestSuite) {
 	testSuite.TestCases = append(testSuite.TestCases, incoming.TestCases...)
 	testSuite.Duration += incoming.Duration
 	testSuite.TimedOut = testSuite.TimedOut || incoming.TimedOut
+	testSuite.ResourceUsage = testSuite.ResourceUsage.Add(incoming.ResourceUsage)
 	if testSuite.Properties == nil {
 		testSuite.Properties = make(map[string]string)
 	}
@@ -262,6 +266,9 @@ var lineCoverageOutput = [...]rune{'N', 'X', 'U', 'C'} // Corresponds to orderin
 type TestCoverage struct {
 	Tests map[BuildLabel]map[string][]LineCoverage
 	Files map[string][]LineCoverage
+	// Counts records how many times each line of each file was executed, for formats that
+	// report it (currently only gcov). It's indexed the same way as Files.
+	Counts map[string][]uint64
 }
 
 // Aggregate aggregates results from another coverage object into this one.
@@ -282,6 +289,13 @@ func (coverage *TestCoverage) Aggregate(cov *TestCoverage) {
 	for filename, c := range cov.Files {
 		coverage.Files[filename] = MergeCoverageLines(coverage.Files[filename], c)
 	}
+	// Counts are more straightforward, they just add up.
+	if len(cov.Counts) > 0 && coverage.Counts == nil {
+		coverage.Counts = map[string][]uint64{}
+	}
+	for filename, c := range cov.Counts {
+		coverage.Counts[filename] = MergeCoverageCounts(coverage.Counts[filename], c)
+	}
 }
 
 // MergeCoverageLines merges two sets of coverage results together, taking
@@ -299,6 +313,20 @@ func MergeCoverageLines(existing, coverage []LineCoverage) []LineCoverage {
 	return ret
 }
 
+// MergeCoverageCounts merges two sets of execution counts together, summing the counts for each line.
+func MergeCoverageCounts(existing, counts []uint64) []uint64 {
+	ret := make([]uint64, len(existing))
+	copy(ret, existing)
+	for i, count := range counts {
+		if i >= len(ret) {
+			ret = append(ret, count)
+		} else {
+			ret[i] += count
+		}
+	}
+	return ret
+}
+
 // OrderedFiles returns an ordered slice of all the files we have coverage information for.
 // Note that files are ordered non-trivially such that each directory remains together.
 func (coverage *TestCoverage) OrderedFiles() []string {
@@ -316,8 +344,9 @@ func (coverage *TestCoverage) OrderedFiles() []string {
 // NewTestCoverage constructs and returns a new TestCoverage instance.
 func NewTestCoverage() *TestCoverage {
 	return &TestCoverage{
-		Tests: map[BuildLabel]map[string][]LineCoverage{},
-		Files: map[string][]LineCoverage{},
+		Tests:  map[BuildLabel]map[string][]LineCoverage{},
+		Files:  map[string][]LineCoverage{},
+		Counts: map[string][]uint64{},
 	}
 }
 
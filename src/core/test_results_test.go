@@ -57,6 +57,18 @@ func TestMergeCoverageLines8(t *testing.T) {
 	assert.Equal(t, empty, coverage)
 }
 
+func TestMergeCoverageCounts(t *testing.T) {
+	assert.Equal(t, []uint64{3, 0, 7, 1}, MergeCoverageCounts([]uint64{1, 0, 7}, []uint64{2, 0, 0, 1}))
+	assert.Equal(t, []uint64{1, 2}, MergeCoverageCounts(nil, []uint64{1, 2}))
+}
+
+func TestAggregateCounts(t *testing.T) {
+	coverage := TestCoverage{}
+	coverage.Aggregate(&TestCoverage{Counts: map[string][]uint64{"a.cc": {0, 2}}})
+	coverage.Aggregate(&TestCoverage{Counts: map[string][]uint64{"a.cc": {0, 3}, "b.cc": {1}}})
+	assert.Equal(t, map[string][]uint64{"a.cc": {0, 5}, "b.cc": {1}}, coverage.Counts)
+}
+
 func TestAdd(t *testing.T) {
 	duration10 := time.Duration(10)
 	duration20 := time.Duration(20)
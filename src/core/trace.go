@@ -0,0 +1,61 @@
+package core
+
+import (
+	"sync"
+	"time"
+)
+
+// A TraceSpan is one phase of building a target (e.g. preparing its sources or running its command),
+// which is written into the trace file within the span for the target itself.
+type TraceSpan struct {
+	Label    BuildLabel
+	ThreadID int
+	Name     string
+	Start    time.Time
+	End      time.Time
+}
+
+// An ActionTrace is a set of trace events written by a target's build action itself,
+// for example one of clang's -ftime-trace files for a single translation unit.
+type ActionTrace struct {
+	Label    BuildLabel
+	ThreadID int
+	// The name of the file the events were read from.
+	Name string
+	// When the action started; the events are relative to this unless they say otherwise.
+	Start time.Time
+	// The contents of the file, in Chrome's trace event format.
+	Data []byte
+}
+
+// traceSpans collects the spans & action traces for a build.
+type traceSpans struct {
+	spans   []TraceSpan
+	actions []ActionTrace
+	mutex   sync.Mutex
+}
+
+// AddTraceSpan records a phase of building a target. It does nothing unless we're writing a trace file.
+func (state *BuildState) AddTraceSpan(span TraceSpan) {
+	if state.Tracing {
+		state.progress.trace.mutex.Lock()
+		defer state.progress.trace.mutex.Unlock()
+		state.progress.trace.spans = append(state.progress.trace.spans, span)
+	}
+}
+
+// AddActionTrace records trace events from a target's build action. It does nothing unless we're writing a trace file.
+func (state *BuildState) AddActionTrace(trace ActionTrace) {
+	if state.Tracing {
+		state.progress.trace.mutex.Lock()
+		defer state.progress.trace.mutex.Unlock()
+		state.progress.trace.actions = append(state.progress.trace.actions, trace)
+	}
+}
+
+// TraceSpans returns all the spans & action traces recorded so far.
+func (state *BuildState) TraceSpans() ([]TraceSpan, []ActionTrace) {
+	state.progress.trace.mutex.Lock()
+	defer state.progress.trace.mutex.Unlock()
+	return state.progress.trace.spans, state.progress.trace.actions
+}
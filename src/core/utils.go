@@ -8,6 +8,7 @@ import (
 	"path"
 	"path/filepath"
 	"strings"
+	"sync"
 
 	"github.com/thought-machine/please/src/fs"
 )
@@ -123,11 +124,16 @@ type SourcePair struct{ Src, Tmp string }
 // Yielded values are pairs of the original source location and its temporary location for this rule.
 // If includeTools is true it yields the target's tools as well.
 func IterSources(graph *BuildGraph, target *BuildTarget, includeTools bool) <-chan SourcePair {
+	return IterSourcesExcept(graph, target, includeTools, nil)
+}
+
+// IterSourcesExcept is like IterSources, but skips the target's named sources with any of the given names.
+func IterSourcesExcept(graph *BuildGraph, target *BuildTarget, includeTools bool, except map[string]bool) <-chan SourcePair {
 	ch := make(chan SourcePair)
 	done := map[string]bool{}
 	tmpDir := target.TmpDir()
 	go func() {
-		for input := range IterInputs(graph, target, includeTools, false) {
+		for input := range iterInputs(graph, target, includeTools, false, except) {
 			fullPaths := input.FullPaths(graph)
 			for i, sourcePath := range input.Paths(graph) {
 				if tmpPath := path.Join(tmpDir, sourcePath); !done[tmpPath] {
@@ -143,6 +149,10 @@ func IterSources(graph *BuildGraph, target *BuildTarget, includeTools bool) <-ch
 
 // IterInputs iterates all the inputs for a target.
 func IterInputs(graph *BuildGraph, target *BuildTarget, includeTools, sourcesOnly bool) <-chan BuildInput {
+	return iterInputs(graph, target, includeTools, sourcesOnly, nil)
+}
+
+func iterInputs(graph *BuildGraph, target *BuildTarget, includeTools, sourcesOnly bool, except map[string]bool) <-chan BuildInput {
 	ch := make(chan BuildInput)
 	done := map[BuildLabel]bool{}
 	var inner func(dependency *BuildTarget)
@@ -176,7 +186,7 @@ func IterInputs(graph *BuildGraph, target *BuildTarget, includeTools, sourcesOnl
 		}
 	}
 	go func() {
-		for _, source := range target.AllSources() {
+		for _, source := range target.allSourcesExcept(except) {
 			recursivelyProvideSource(graph, target, source, ch)
 		}
 		if includeTools {
@@ -192,6 +202,52 @@ func IterInputs(graph *BuildGraph, target *BuildTarget, includeTools, sourcesOnl
 	return ch
 }
 
+// LinkInputs returns the object files & archives among the transitive inputs of a target, relative to its
+// temporary directory. Each is ordered before those of the targets it depends on, which is the order a linker
+// needs static archives in to resolve all their symbols in a single pass.
+func LinkInputs(graph *BuildGraph, target *BuildTarget) []string {
+	done := map[BuildLabel]bool{}
+	var order []BuildLabel
+	var inner func(dependency *BuildTarget)
+	inner = func(dependency *BuildTarget) {
+		done[dependency.Label] = true
+		deps := dependency.ExportedDependencies()
+		if target == dependency || (target.NeedsTransitiveDependencies && !dependency.OutputIsComplete) {
+			deps = nil
+			for _, dep := range dependency.BuildDependencies() {
+				deps = append(deps, dep.Label)
+			}
+		}
+		for _, dep := range deps {
+			for _, dep2 := range recursivelyProvideFor(graph, target, dependency, dep) {
+				if !done[dep2] && !dependency.IsTool(dep2) {
+					inner(graph.TargetOrDie(dep2))
+				}
+			}
+		}
+		order = append(order, dependency.Label)
+	}
+	inner(target)
+	// Each target was added after everything it depends on, so this is the reverse of what we want.
+	// The last one is the target itself.
+	ret := []string{}
+	seen := map[string]bool{}
+	for i := len(order) - 2; i >= 0; i-- {
+		for _, p := range order[i].Paths(graph) {
+			if (strings.HasSuffix(p, ".o") || strings.HasSuffix(p, ".a")) && !seen[p] {
+				ret = append(ret, "./"+p)
+				seen[p] = true
+			}
+		}
+	}
+	return ret
+}
+
+// LinkInputsFile returns the contents of the file listing a target's link inputs.
+func LinkInputsFile(graph *BuildGraph, target *BuildTarget) []byte {
+	return []byte(strings.Join(LinkInputs(graph, target), "\n") + "\n")
+}
+
 // recursivelyProvideFor recursively applies ProvideFor to a target.
 func recursivelyProvideFor(graph *BuildGraph, target, dependency *BuildTarget, dep BuildLabel) []BuildLabel {
 	depTarget := graph.TargetOrDie(dep)
@@ -367,14 +423,26 @@ func CollapseHash(key []byte) []byte {
 	return short[:]
 }
 
+// lookPathCache memoises the results of LookPath. System tools are looked up every time an action
+// using them is hashed or run, and the path doesn't change during a build.
+var lookPathCache sync.Map
+
 // LookPath does roughly the same as exec.LookPath, i.e. looks for the named file on the path.
 // The main difference is that it looks based on our config which isn't necessarily the same
 // as the external environment variable.
+// Files that are found at absolute locations are remembered for subsequent calls.
 func LookPath(filename string, paths []string) (string, error) {
+	key := filename + "\x00" + strings.Join(paths, ":")
+	if p, present := lookPathCache.Load(key); present {
+		return p.(string), nil
+	}
 	for _, p := range paths {
 		for _, p2 := range strings.Split(p, ":") {
 			p3 := path.Join(p2, filename)
 			if _, err := os.Stat(p3); err == nil {
+				if path.IsAbs(p3) {
+					lookPathCache.Store(key, p3)
+				}
 				return p3, nil
 			}
 		}
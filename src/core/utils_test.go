@@ -4,6 +4,7 @@ import (
 	"crypto/sha1"
 	"encoding/base64"
 	"os"
+	"path"
 	"testing"
 
 	"github.com/stretchr/testify/assert"
@@ -81,6 +82,42 @@ func TestIterSources(t *testing.T) {
 	}, iterSources("//src/parse:target2"))
 }
 
+func TestIterSourcesExcept(t *testing.T) {
+	graph := buildGraph()
+	target := graph.TargetOrDie(ParseBuildLabel("//src/core:target2", ""))
+	target.AddNamedSource("hdrs", FileLabel{File: "target2.h", Package: "src/core"})
+
+	assert.Equal(t, []SourcePair{
+		{"src/core/target2.go", "plz-out/tmp/src/core/target2._build/src/core/target2.go"},
+		{"src/core/target2.h", "plz-out/tmp/src/core/target2._build/src/core/target2.h"},
+		{"plz-out/gen/src/core/target1.a", "plz-out/tmp/src/core/target2._build/src/core/target1.a"},
+	}, toSlice(IterSources(graph, target, false)))
+	assert.Equal(t, []SourcePair{
+		{"src/core/target2.go", "plz-out/tmp/src/core/target2._build/src/core/target2.go"},
+		{"plz-out/gen/src/core/target1.a", "plz-out/tmp/src/core/target2._build/src/core/target1.a"},
+	}, toSlice(IterSourcesExcept(graph, target, false, map[string]bool{"hdrs": true})))
+}
+
+func TestLinkInputs(t *testing.T) {
+	graph := NewGraph()
+	mt := func(label string, deps ...string) *BuildTarget {
+		target := makeTarget4(graph, label, deps...)
+		graph.AddTarget(target)
+		return target
+	}
+	mt("//src/core:core")
+	mt("//src/fs:fs", "//src/core:core")
+	mt("//src/build:build", "//src/core:core", "//src/fs:fs")
+	bin := mt("//src:please", "//src/core:core", "//src/build:build")
+	bin.NeedsTransitiveDependencies = true
+	// Each archive has to come before any it depends on, regardless of the order they're declared in.
+	assert.Equal(t, []string{
+		"./src/build/build.a",
+		"./src/fs/fs.a",
+		"./src/core/core.a",
+	}, LinkInputs(graph, bin))
+}
+
 func TestInitialPackageSimple(t *testing.T) {
 	initialPackage = "src/core"
 	p := InitialPackage()
@@ -135,6 +172,20 @@ func TestLookPathDoesntExist(t *testing.T) {
 	assert.Error(t, err)
 }
 
+func TestLookPathCached(t *testing.T) {
+	dir := t.TempDir()
+	filename := path.Join(dir, "wibble")
+	assert.NoError(t, os.WriteFile(filename, nil, 0755))
+	p, err := LookPath("wibble", []string{dir})
+	assert.NoError(t, err)
+	assert.Equal(t, filename, p)
+	// It's remembered, so it isn't looked up again, even though it'd no longer be found.
+	assert.NoError(t, os.Remove(filename))
+	p, err = LookPath("wibble", []string{dir})
+	assert.NoError(t, err)
+	assert.Equal(t, filename, p)
+}
+
 // buildGraph builds a test graph which we use to test IterSources etc.
 func buildGraph() *BuildGraph {
 	graph := NewGraph()
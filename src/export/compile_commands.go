@@ -0,0 +1,218 @@
+package export
+
+import (
+	"bytes"
+	"encoding/json"
+	"os"
+	"os/exec"
+	"path"
+	"sort"
+	"strings"
+	"sync"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/fs"
+)
+
+// compileCommandsDir is where the compile commands for each package are kept between runs.
+var compileCommandsDir = path.Join(core.OutDir, "compile_commands")
+
+// A compileCommand is a single entry in a compile_commands.json file.
+type compileCommand struct {
+	Directory string `json:"directory"`
+	File      string `json:"file"`
+	Command   string `json:"command"`
+	Output    string `json:"output,omitempty"`
+}
+
+// CompileCommands writes a compile_commands.json file to the given directory, for all the C & C++ sources
+// compiled by the given targets & their dependencies. None of them need to be built first; the commands
+// are worked out by running their pre-build functions, which is where the flags from their dependencies
+// are applied.
+// The commands for each package are stored separately in plz-out too, and only rewritten if they change.
+func CompileCommands(state *core.BuildState, dir string, targets []core.BuildLabel) {
+	done := map[*core.BuildTarget]bool{}
+	var compiles []*core.BuildTarget
+	var find func(target *core.BuildTarget)
+	find = func(target *core.BuildTarget) {
+		if done[target] {
+			return
+		}
+		done[target] = true
+		if isCompile(target) {
+			compiles = append(compiles, target)
+		}
+		for _, dep := range target.Dependencies() {
+			find(dep)
+		}
+	}
+	for _, label := range targets {
+		find(state.Graph.TargetOrDie(label))
+	}
+
+	// Work them out in parallel; they're only distinguished by package from here on.
+	ch := make(chan *core.BuildTarget)
+	packages := map[string][]compileCommand{}
+	var mutex sync.Mutex
+	var wg sync.WaitGroup
+	subshells := &subshells{outputs: map[string]string{}}
+	for i := 0; i < state.Config.Please.NumThreads; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for target := range ch {
+				cmds, err := compileCommands(state, target, subshells)
+				if err != nil {
+					log.Warning("Failed to get compile commands for %s: %s", target, err)
+					continue
+				}
+				mutex.Lock()
+				packages[target.Label.PackageName] = append(packages[target.Label.PackageName], cmds...)
+				mutex.Unlock()
+			}
+		}()
+	}
+	for _, target := range compiles {
+		ch <- target
+	}
+	close(ch)
+	wg.Wait()
+
+	pkgNames := make([]string, 0, len(packages))
+	for pkg := range packages {
+		pkgNames = append(pkgNames, pkg)
+	}
+	sort.Strings(pkgNames)
+	all := []compileCommand{}
+	for _, pkg := range pkgNames {
+		cmds := packages[pkg]
+		sort.Slice(cmds, func(i, j int) bool { return cmds[i].File < cmds[j].File })
+		if err := writeJSONIfChanged(path.Join(compileCommandsDir, pkg, "compile_commands.json"), cmds); err != nil {
+			log.Fatalf("Failed to write compile commands for %s: %s", pkg, err)
+		}
+		all = append(all, cmds...)
+	}
+	if err := writeJSONIfChanged(path.Join(dir, "compile_commands.json"), all); err != nil {
+		log.Fatalf("Failed to write compile_commands.json: %s", err)
+	}
+	log.Notice("Wrote compile commands for %d sources in %d packages", len(all), len(packages))
+}
+
+// isCompile returns true if the given target compiles C or C++ sources (as identified by using the
+// "cc" tool on the "srcs" sources, as the rules in cc_rules.build_defs do).
+func isCompile(target *core.BuildTarget) bool {
+	return len(target.NamedTools("cc")) > 0 && len(target.NamedSources["srcs"]) > 0
+}
+
+// compileCommands returns the compile commands for each source of a target.
+func compileCommands(state *core.BuildState, target *core.BuildTarget, subshells *subshells) ([]compileCommand, error) {
+	if target.PreBuildFunction != nil {
+		// This is called directly since the build (and hence anything that'd listen to its progress) is done.
+		// The C++ rules' functions don't add any dependencies, so there's nothing else to do after.
+		// The target isn't actually built, but its pre-build function expects it to be being built
+		// (get_labels checks that it is), so it's marked as such while that runs.
+		pkg := state.Graph.PackageOrDie(target.Label)
+		if before := target.State(); before < core.Building {
+			target.SetState(core.Building)
+			defer target.SetState(before)
+		}
+		if _, err := pkg.EnterBuildCallback(func() error { return target.PreBuildFunction.Call(target) }); err != nil {
+			return nil, err
+		}
+	}
+	cmd, err := core.ReplaceSequences(state, target, target.GetCommand(state))
+	if err != nil {
+		return nil, err
+	}
+	cmd = compileSegment(cmd)
+	if cmd == "" {
+		return nil, nil // Not a compile after all (or at least not one we understand)
+	}
+	// The commands are run from the repo root instead of a temporary directory, so generated headers
+	// are found in plz-out/gen instead of alongside the others.
+	env := core.BuildEnvironment(state, target, core.RepoRoot)
+	ret := []compileCommand{}
+	for _, src := range target.NamedSources["srcs"] {
+		for _, file := range src.FullPaths(state.Graph) {
+			env.Replace("SRCS_SRCS", file)
+			command := subshells.Replace(os.Expand(cmd, env.ReplaceEnvironment)) + " -I " + core.GenDir
+			c := compileCommand{
+				Directory: core.RepoRoot,
+				File:      file,
+				Command:   command,
+			}
+			if outs := target.Outputs(); len(outs) == 1 {
+				c.Output = path.Join(target.OutDir(), outs[0])
+			}
+			ret = append(ret, c)
+		}
+	}
+	return ret, nil
+}
+
+// compileSegment returns the part of a build command that actually invokes the compiler.
+func compileSegment(cmd string) string {
+	for _, part := range strings.Split(cmd, " && ") {
+		if part = strings.TrimSpace(part); strings.HasPrefix(part, "$TOOLS_CC ") && strings.Contains(part, " -c ") {
+			return part
+		}
+	}
+	return ""
+}
+
+// subshells replaces backquoted commands (e.g. `pkg-config --cflags x`) with their output,
+// since tools reading compile_commands.json won't run them. Each is only run once.
+// They're run in plz-out/gen if it exists, since that's where the files they refer to (e.g. the flags
+// written by pkg_config rules) are once they're built.
+type subshells struct {
+	outputs map[string]string
+	mutex   sync.Mutex
+}
+
+// Replace replaces all the subshells in the given string.
+func (s *subshells) Replace(cmd string) string {
+	for {
+		start := strings.IndexByte(cmd, '`')
+		if start == -1 {
+			return cmd
+		}
+		end := strings.IndexByte(cmd[start+1:], '`')
+		if end == -1 {
+			return cmd
+		}
+		end += start + 1
+		cmd = cmd[:start] + s.run(cmd[start+1:end]) + cmd[end+1:]
+	}
+}
+
+func (s *subshells) run(cmd string) string {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	if out, present := s.outputs[cmd]; present {
+		return out
+	}
+	c := exec.Command("sh", "-c", cmd)
+	if fs.PathExists(core.GenDir) {
+		c.Dir = core.GenDir
+	}
+	b, err := c.Output()
+	if err != nil {
+		log.Warning("Failed to run %s: %s", cmd, err)
+	}
+	out := strings.Join(strings.Fields(string(b)), " ")
+	s.outputs[cmd] = out
+	return out
+}
+
+// writeJSONIfChanged writes the given object to a file as JSON, unless it already contains exactly that.
+func writeJSONIfChanged(filename string, v interface{}) error {
+	b, err := json.MarshalIndent(v, "", "  ")
+	if err != nil {
+		return err
+	}
+	b = append(b, '\n')
+	if existing, err := os.ReadFile(filename); err == nil && bytes.Equal(existing, b) {
+		return nil
+	}
+	return fs.WriteFile(bytes.NewReader(b), filename, 0644)
+}
@@ -0,0 +1,57 @@
+package export
+
+import (
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/parse"
+)
+
+func TestCompileSegment(t *testing.T) {
+	assert.Equal(t, `$TOOLS_CC -c -I . ${SRCS_SRCS} -O2 -fPIC`,
+		compileSegment(`$TOOLS_CC -c -I . ${SRCS_SRCS} -O2 -fPIC && "$TOOLS_JARCAT" ar -r --index`))
+	// With module scanning the scan comes first, then the real compile.
+	assert.Equal(t, `$TOOLS_CC -c -I . ${SRCS_SRCS} -O2 $MODULE_FLAGS`,
+		compileSegment(`"$TOOLS_SCAN" -format=p1689 -- $TOOLS_CC -c -I . ${SRCS_SRCS} -O2 -o .scan.o > .scan.ddi && `+
+			`MODULE_FLAGS="$("$TOOLS_JARCAT" modules --scan .scan.ddi)" && $TOOLS_CC -c -I . ${SRCS_SRCS} -O2 $MODULE_FLAGS && "$TOOLS_JARCAT" ar -r`))
+	assert.Equal(t, "", compileSegment(`"$TOOLS_JARCAT" ar --combine`))
+}
+
+func TestSubshells(t *testing.T) {
+	s := &subshells{outputs: map[string]string{}}
+	assert.Equal(t, "-c a.cc -Ifoo -Ibar -O2", s.Replace("-c a.cc `echo -Ifoo; echo -Ibar` -O2"))
+	assert.Equal(t, "-Ifoo -Ibar", s.outputs["echo -Ifoo; echo -Ibar"])
+	assert.Equal(t, "unterminated `echo", s.Replace("unterminated `echo"))
+}
+
+func TestCompileCommandsRunsPreBuildFunction(t *testing.T) {
+	state := core.NewDefaultBuildState()
+	parse.InitParser(state)
+	pkg := core.NewPackage("src/export")
+	// The defines are applied by the library's pre-build function, from its own labels.
+	require.NoError(t, state.Parser.ParseReader(state, pkg, strings.NewReader(
+		`cc_library(name = "lib", srcs = ["lib.cc"], defines = ["FOO"])`)))
+	state.Graph.AddPackage(pkg)
+	var compiles []*core.BuildTarget
+	for _, target := range pkg.AllTargets() {
+		if isCompile(target) {
+			compiles = append(compiles, target)
+		}
+	}
+	require.Equal(t, 1, len(compiles))
+	target := compiles[0]
+	require.NotNil(t, target.PreBuildFunction)
+	before := target.State()
+
+	cmds, err := compileCommands(state, target, &subshells{outputs: map[string]string{}})
+	require.NoError(t, err)
+	require.Equal(t, 1, len(cmds))
+	assert.Equal(t, "src/export/lib.cc", cmds[0].File)
+	assert.Contains(t, cmds[0].Command, "-DFOO")
+	// It's left as it was, since it hasn't really been built.
+	assert.Equal(t, before, target.State())
+}
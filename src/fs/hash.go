@@ -19,12 +19,14 @@ var boolTrueHashValue = []byte{2}
 type PathHasher struct {
 	new       func() hash.Hash
 	memo      map[string][]byte
+	groups    map[string][]byte
 	wait      map[string]*pendingHash
 	mutex     sync.RWMutex
 	root      string
 	xattrName string
 	useXattrs bool
 	algo      string
+	index     *hashIndex
 }
 
 type pendingHash struct {
@@ -42,6 +44,7 @@ func NewPathHasher(root string, useXattrs bool, hash func() hash.Hash, algo stri
 	return &PathHasher{
 		new:       hash,
 		memo:      map[string][]byte{},
+		groups:    map[string][]byte{},
 		wait:      map[string]*pendingHash{},
 		root:      root,
 		useXattrs: useXattrs,
@@ -65,6 +68,17 @@ func (hasher *PathHasher) DisableXattrs() {
 	hasher.useXattrs = false
 }
 
+// UseIndex makes this hasher persist the hashes of source files in the given file between runs,
+// so they aren't read again unless they've changed. SaveIndex must be called to write it out again.
+func (hasher *PathHasher) UseIndex(filename string) {
+	hasher.index = &hashIndex{filename: filename}
+}
+
+// SaveIndex saves the index of source file hashes, if UseIndex has been called.
+func (hasher *PathHasher) SaveIndex() error {
+	return hasher.index.Save()
+}
+
 // AlgoName returns the name of the algorithm. Used to aid with better error messages.
 func (hasher *PathHasher) AlgoName() string {
 	return hasher.algo
@@ -113,6 +127,34 @@ func (hasher *PathHasher) Hash(path string, recalc, store bool) ([]byte, error)
 	return result, err
 }
 
+// HashGroup hashes a group of paths together. The result is memoised as a whole, so it's cheap for
+// several targets to hash the same group (for example the headers of a C++ library, which each of
+// the rules compiling one of its sources has).
+// It should only be used for source files, which mustn't change during the build.
+func (hasher *PathHasher) HashGroup(paths []string) ([]byte, error) {
+	key := strings.Join(paths, "\x00")
+	hasher.mutex.RLock()
+	cached, present := hasher.groups[key]
+	hasher.mutex.RUnlock()
+	if present {
+		return cached, nil
+	}
+	h := hasher.new()
+	for _, path := range paths {
+		result, err := hasher.Hash(path, false, true)
+		if err != nil {
+			return nil, err
+		}
+		h.Write(result)
+		h.Write([]byte(path))
+	}
+	result := h.Sum(nil)
+	hasher.mutex.Lock()
+	hasher.groups[key] = result
+	hasher.mutex.Unlock()
+	return result, nil
+}
+
 // MustHash is as Hash but panics on error.
 func (hasher *PathHasher) MustHash(path string) []byte {
 	hash, err := hasher.Hash(path, false, false)
@@ -157,6 +199,11 @@ func (hasher *PathHasher) hash(path string, store, read bool) ([]byte, error) {
 	}
 	h := hasher.new()
 	info, err := os.Lstat(path)
+	if read && err == nil {
+		if hash := hasher.index.Get(path, info); hash != nil {
+			return hash, nil
+		}
+	}
 	if err == nil && info.Mode()&os.ModeSymlink != 0 {
 		// Handle symlinks specially (don't attempt to read their contents).
 		dest, err := os.Readlink(path)
@@ -204,7 +251,9 @@ func (hasher *PathHasher) hash(path string, store, read bool) ([]byte, error) {
 	hash := h.Sum(nil)
 	if err != nil {
 		return hash, err
-	} else if store && hasher.useXattrs {
+	}
+	hasher.index.Set(path, info, hash)
+	if store && hasher.useXattrs {
 		hasher.storeHash(path, hash)
 	}
 	return hash, err
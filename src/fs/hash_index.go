@@ -0,0 +1,138 @@
+package fs
+
+import (
+	"bytes"
+	"encoding/gob"
+	"os"
+	"strings"
+	"sync"
+	"syscall"
+	"time"
+)
+
+// racyInterval is how recently a file can have been modified for us to not trust its timestamps
+// to tell us about any further changes to it; filesystems' timestamps are only so precise.
+// It's a variable so tests can shorten it.
+var racyInterval = time.Second
+
+// A hashIndex persists the hashes of source files between runs, so they don't need to be read again
+// if they haven't changed. Each is keyed by path and validated against the file's size, modification
+// & change times, inode and mode, in much the same way as git's index. The change time matters because
+// anything can set the modification time back to what it was, but nothing but the kernel sets that.
+// It's loaded on first use so it costs nothing if we never hash anything.
+type hashIndex struct {
+	filename string
+	entries  map[string]hashIndexEntry
+	changed  bool
+	once     sync.Once
+	mutex    sync.Mutex
+}
+
+type hashIndexEntry struct {
+	Size       int64
+	ModTime    int64
+	ChangeTime int64
+	Inode      uint64
+	Mode       os.FileMode
+	Hash       []byte
+}
+
+func newHashIndexEntry(info os.FileInfo, hash []byte) hashIndexEntry {
+	entry := hashIndexEntry{
+		Size:    info.Size(),
+		ModTime: info.ModTime().UnixNano(),
+		Mode:    info.Mode(),
+		Hash:    hash,
+	}
+	if s, ok := info.Sys().(*syscall.Stat_t); ok {
+		entry.Inode = s.Ino
+		entry.ChangeTime = changeTime(s)
+	}
+	return entry
+}
+
+// matches returns true if the given entry is for the same version of the file as this one.
+func (entry hashIndexEntry) matches(other hashIndexEntry) bool {
+	return entry.Size == other.Size && entry.ModTime == other.ModTime && entry.ChangeTime == other.ChangeTime &&
+		entry.Inode == other.Inode && entry.Mode == other.Mode
+}
+
+// lastChanged returns the later of the entry's modification and change times.
+func (entry hashIndexEntry) lastChanged() time.Time {
+	if entry.ChangeTime > entry.ModTime {
+		return time.Unix(0, entry.ChangeTime)
+	}
+	return time.Unix(0, entry.ModTime)
+}
+
+func (index *hashIndex) load() {
+	index.entries = map[string]hashIndexEntry{}
+	if f, err := os.Open(index.filename); err == nil {
+		defer f.Close()
+		if err := gob.NewDecoder(f).Decode(&index.entries); err != nil {
+			log.Warning("Failed to load hash index %s: %s", index.filename, err)
+			index.entries = map[string]hashIndexEntry{}
+		}
+	}
+}
+
+// Get returns the hash recorded for the given file, or nil if there isn't one or the file has changed since.
+func (index *hashIndex) Get(path string, info os.FileInfo) []byte {
+	if !index.indexes(path, info) {
+		return nil
+	}
+	index.once.Do(index.load)
+	index.mutex.Lock()
+	entry, present := index.entries[path]
+	index.mutex.Unlock()
+	if !present || !newHashIndexEntry(info, nil).matches(entry) {
+		return nil
+	}
+	return entry.Hash
+}
+
+// Set records the hash of the given file, which had the given info before it was hashed.
+func (index *hashIndex) Set(path string, info os.FileInfo, hash []byte) {
+	if !index.indexes(path, info) {
+		return
+	}
+	entry := newHashIndexEntry(info, hash)
+	if time.Since(entry.lastChanged()) < racyInterval {
+		return
+	}
+	index.once.Do(index.load)
+	index.mutex.Lock()
+	defer index.mutex.Unlock()
+	index.entries[path] = entry
+	index.changed = true
+}
+
+// indexes returns true if the index should be used for the given file. Only regular source files are,
+// since outputs can store their hashes in xattrs and are mostly in plz-out/tmp at the time they're hashed.
+func (index *hashIndex) indexes(path string, info os.FileInfo) bool {
+	return index != nil && info.Mode().IsRegular() && !strings.HasPrefix(path, "plz-out/")
+}
+
+// Save saves the index, if anything's changed. Entries for files that no longer exist are dropped
+// first; that's only worth a stat of each one when we're rewriting it anyway.
+func (index *hashIndex) Save() error {
+	if index == nil {
+		return nil
+	}
+	index.mutex.Lock()
+	defer index.mutex.Unlock()
+	if !index.changed {
+		return nil
+	}
+	for path := range index.entries {
+		if _, err := os.Lstat(path); os.IsNotExist(err) {
+			delete(index.entries, path)
+		}
+	}
+	var buf bytes.Buffer
+	if err := gob.NewEncoder(&buf).Encode(index.entries); err != nil {
+		return err
+	}
+	index.changed = false
+	return WriteFile(&buf, index.filename, 0644)
+}
@@ -0,0 +1,10 @@
+// +build linux
+
+package fs
+
+import "syscall"
+
+// changeTime returns the inode change time from the given stat result.
+func changeTime(s *syscall.Stat_t) int64 {
+	return s.Ctim.Nano()
+}
@@ -5,7 +5,9 @@ import (
 	"crypto/sha256"
 	"encoding/hex"
 	"os"
+	"path"
 	"testing"
+	"time"
 
 	"github.com/stretchr/testify/assert"
 	"github.com/stretchr/testify/require"
@@ -46,6 +48,23 @@ func TestSetHash(t *testing.T) {
 	assert.EqualValues(t, b1, b2)
 }
 
+func TestHashGroup(t *testing.T) {
+	wd, err := os.Getwd()
+	require.NoError(t, err)
+	h := NewPathHasher(wd, true, sha1.New, "")
+	paths := []string{"src/fs/test_data/test_subfolder1/a.txt", "src/fs/test_data/test.txt"}
+	b1, err := h.HashGroup(paths)
+	require.NoError(t, err)
+	b2, err := h.HashGroup([]string{paths[1], paths[0]})
+	require.NoError(t, err)
+	assert.NotEqual(t, b1, b2)
+	b3, err := h.HashGroup(paths)
+	require.NoError(t, err)
+	assert.Equal(t, b1, b3)
+	_, err = h.HashGroup([]string{paths[0], "doesnt_exist.txt"})
+	assert.Error(t, err)
+}
+
 func TestHashConstructorSHA1(t *testing.T) {
 	wd, err := os.Getwd()
 	require.NoError(t, err)
@@ -62,3 +81,71 @@ func TestHashConstructorSHA256(t *testing.T) {
 	assert.NoError(t, err)
 	assert.Equal(t, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", hex.EncodeToString(b))
 }
+
+func TestHashIndex(t *testing.T) {
+	// Setting the modification time updates the change time, so the file's always just been changed.
+	defer func(interval time.Duration) { racyInterval = interval }(racyInterval)
+	racyInterval = 0
+	dir := t.TempDir()
+	filename := path.Join(dir, "a.txt")
+	require.NoError(t, os.WriteFile(filename, []byte("hello"), 0644))
+	then := time.Now().Add(-time.Hour)
+	require.NoError(t, os.Chtimes(filename, then, then))
+	indexFile := path.Join(dir, "index")
+	wd, err := os.Getwd()
+	require.NoError(t, err)
+
+	h := NewPathHasher(wd, false, sha1.New, "sha1")
+	h.UseIndex(indexFile)
+	b1, err := h.Hash(filename, false, false)
+	require.NoError(t, err)
+	require.NoError(t, h.SaveIndex())
+
+	// A new hasher gets the hash from the index.
+	info, err := os.Lstat(filename)
+	require.NoError(t, err)
+	h = NewPathHasher(wd, false, sha1.New, "sha1")
+	h.UseIndex(indexFile)
+	assert.Equal(t, b1, h.index.Get(filename, info))
+
+	// Once the contents have changed it's rehashed, even with the same size and modification time
+	// as before, because the change time is different.
+	require.NoError(t, os.WriteFile(filename, []byte("world"), 0644))
+	require.NoError(t, os.Chtimes(filename, then, then))
+	h = NewPathHasher(wd, false, sha1.New, "sha1")
+	h.UseIndex(indexFile)
+	b2, err := h.Hash(filename, false, false)
+	require.NoError(t, err)
+	assert.NotEqual(t, b1, b2)
+}
+
+func TestHashIndexPrunesDeletedFiles(t *testing.T) {
+	defer func(interval time.Duration) { racyInterval = interval }(racyInterval)
+	racyInterval = 0
+	dir := t.TempDir()
+	a := path.Join(dir, "a.txt")
+	b := path.Join(dir, "b.txt")
+	require.NoError(t, os.WriteFile(a, []byte("hello"), 0644))
+	require.NoError(t, os.WriteFile(b, []byte("world"), 0644))
+	indexFile := path.Join(dir, "index")
+	wd, err := os.Getwd()
+	require.NoError(t, err)
+
+	h := NewPathHasher(wd, false, sha1.New, "sha1")
+	h.UseIndex(indexFile)
+	_, err = h.Hash(a, false, false)
+	require.NoError(t, err)
+	require.NoError(t, h.SaveIndex())
+
+	require.NoError(t, os.Remove(a))
+	h = NewPathHasher(wd, false, sha1.New, "sha1")
+	h.UseIndex(indexFile)
+	_, err = h.Hash(b, false, false)
+	require.NoError(t, err)
+	require.NoError(t, h.SaveIndex())
+
+	index := &hashIndex{filename: indexFile}
+	index.load()
+	assert.NotContains(t, index.entries, a)
+	assert.Contains(t, index.entries, b)
+}
@@ -15,6 +15,7 @@ There are several different .plzconfig files that can be loaded, which override
 const tracing = `
 Please can generate output compatible with Chrome's built-in tracing tool. It can be switched on with the ${BOLD_CYAN}--trace_file${RESET} flag and, once done, you can load the file by visiting ${BLUE}chrome://tracing${RESET}.
 This is a handy way to visualise where time is spent during a build and can be useful to diagnose slow builds.
+Alongside each builder's targets is a track of the phases of building them (pre-build functions, preparing sources, running commands, storing in the cache etc), and clang's own trace of each source it compiles if ${CYAN}timetrace${RESET} is set in the ${CYAN}[cpp]${RESET} section of the config.
 `
 
 const toplevel = `
@@ -42,3 +42,16 @@ func NewCounter(subsystem, name, help string) prometheus.Counter {
 	MustRegister(counter)
 	return counter
 }
+
+// NewHistogramVec creates & registers a new histogram, partitioned by the given labels.
+func NewHistogramVec(subsystem, name, help string, buckets []float64, labelNames []string) *prometheus.HistogramVec {
+	histogram := prometheus.NewHistogramVec(prometheus.HistogramOpts{
+		Namespace: "plz",
+		Subsystem: subsystem,
+		Name:      name,
+		Help:      help,
+		Buckets:   buckets,
+	}, labelNames)
+	MustRegister(histogram)
+	return histogram
+}
@@ -82,6 +82,7 @@ func MonitorState(ctx context.Context, state *core.BuildState, plainOutput, deta
 	}
 	<-ctx.Done()
 	wg.Wait()
+	tw.AddSpans(state.TraceSpans())
 	if err := tw.Close(); err != nil {
 		log.Error("Failed to write trace data: %s", err)
 	}
@@ -72,11 +72,6 @@ func (tw *traceWriter) AddTrace(result *core.BuildResult, previous core.BuildLab
 }
 
 func (tw *traceWriter) writeEvent(result *core.BuildResult, phase string) {
-	if !tw.first {
-		tw.first = true
-	} else {
-		tw.b.Write([]byte{',', '\n'})
-	}
 	entry := traceEntry{
 		Name:  result.Label.String(),
 		Cat:   result.Status.Category(),
@@ -93,6 +88,62 @@ func (tw *traceWriter) writeEvent(result *core.BuildResult, phase string) {
 	} else if entry.Cat == "Test" {
 		entry.Cname = "good"
 	}
+	tw.write(entry)
+}
+
+// AddSpans adds the phases of building each target, and any trace events written by their build actions.
+// These go on a track of their own for each builder, alongside the one for the targets themselves.
+func (tw *traceWriter) AddSpans(spans []core.TraceSpan, actions []core.ActionTrace) {
+	if tw.b == nil {
+		return
+	}
+	for _, span := range spans {
+		entry := traceEntry{
+			Name: span.Name,
+			Cat:  "Phase",
+			Ph:   "X",
+			Tid:  fmt.Sprintf("Builder %d: phases", span.ThreadID),
+			Ts:   span.Start.UnixNano() / 1000,
+			Dur:  span.End.Sub(span.Start).Microseconds(),
+		}
+		entry.Args.Description = span.Label.String()
+		tw.write(entry)
+	}
+	for _, action := range actions {
+		var trace struct {
+			TraceEvents     []map[string]interface{} `json:"traceEvents"`
+			BeginningOfTime int64                    `json:"beginningOfTime"`
+		}
+		if err := json.Unmarshal(action.Data, &trace); err != nil {
+			log.Warning("Failed to read trace events from %s for %s: %s", action.Name, action.Label, err)
+			continue
+		}
+		offset := trace.BeginningOfTime
+		if offset == 0 {
+			offset = action.Start.UnixNano() / 1000
+		}
+		tid := fmt.Sprintf("Builder %d: %s", action.ThreadID, action.Name)
+		for _, event := range trace.TraceEvents {
+			if event["ph"] == "M" {
+				continue // Metadata naming the process & threads that wrote them; we've got our own names.
+			}
+			event["pid"] = 0
+			event["tid"] = tid
+			if ts, ok := event["ts"].(float64); ok {
+				event["ts"] = int64(ts) + offset
+			}
+			tw.write(event)
+		}
+	}
+}
+
+// write writes a single entry as JSON.
+func (tw *traceWriter) write(entry interface{}) {
+	if !tw.first {
+		tw.first = true
+	} else {
+		tw.b.Write([]byte{',', '\n'})
+	}
 	b, _ := json.Marshal(entry)
 	tw.b.Write(b)
 }
@@ -104,6 +155,7 @@ type traceEntry struct {
 	Pid   int32  `json:"pid"`
 	Tid   string `json:"tid"`
 	Ts    int64  `json:"ts"`
+	Dur   int64  `json:"dur,omitempty"`
 	Cname string `json:"cname,omitempty"`
 	Args  struct {
 		Description string `json:"description"`
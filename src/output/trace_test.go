@@ -0,0 +1,51 @@
+package output
+
+import (
+	"encoding/json"
+	"os"
+	"path"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+
+	"github.com/thought-machine/please/src/core"
+)
+
+func TestAddSpans(t *testing.T) {
+	filename := path.Join(t.TempDir(), "trace.json")
+	label := core.BuildLabel{PackageName: "src/core", Name: "core"}
+	start := time.Unix(1000, 0)
+	tw := newTraceWriter(filename)
+	tw.AddSpans([]core.TraceSpan{{
+		Label:    label,
+		ThreadID: 2,
+		Name:     "command",
+		Start:    start,
+		End:      start.Add(3 * time.Millisecond),
+	}}, []core.ActionTrace{{
+		Label:    label,
+		ThreadID: 2,
+		Name:     "state.json",
+		Start:    start,
+		Data: []byte(`{"traceEvents": [
+			{"pid": 123, "tid": 123, "ph": "X", "ts": 5, "dur": 10, "name": "Source", "args": {"detail": "state.h"}},
+			{"pid": 123, "tid": 123, "ph": "M", "ts": 0, "name": "process_name", "args": {"name": "clang"}}
+		]}`),
+	}})
+	require.NoError(t, tw.Close())
+
+	b, err := os.ReadFile(filename)
+	require.NoError(t, err)
+	var events []map[string]interface{}
+	require.NoError(t, json.Unmarshal(b, &events))
+	require.Equal(t, 2, len(events))
+	assert.Equal(t, "command", events[0]["name"])
+	assert.Equal(t, "Builder 2: phases", events[0]["tid"])
+	assert.EqualValues(t, 1000000000, events[0]["ts"])
+	assert.EqualValues(t, 3000, events[0]["dur"])
+	assert.Equal(t, "Source", events[1]["name"])
+	assert.Equal(t, "Builder 2: state.json", events[1]["tid"])
+	assert.EqualValues(t, 1000000005, events[1]["ts"])
+}
@@ -56,6 +56,7 @@ func registerBuiltins(s *scope) {
 	setNativeCode(s, "get_licences", getLicences)
 	setNativeCode(s, "get_command", getCommand)
 	setNativeCode(s, "set_command", setCommand)
+	setNativeCode(s, "set_cache_key_command", setCacheKeyCommand)
 	setNativeCode(s, "json", valueAsJSON)
 	setNativeCode(s, "breakpoint", breakpoint)
 	setNativeCode(s, "is_semver", isSemver)
@@ -695,6 +696,9 @@ func getLabelsInternal(target *core.BuildTarget, prefix string, minState core.Bu
 	if target.State() < minState {
 		log.Fatalf("get_labels called on a target that is not yet built: %s", target.Label)
 	}
+	if !all {
+		return fromStringList(target.TransitiveLabels(prefix))
+	}
 	labels := map[string]bool{}
 	done := map[*core.BuildTarget]bool{}
 	var getLabels func(*core.BuildTarget)
@@ -705,11 +709,9 @@ func getLabelsInternal(target *core.BuildTarget, prefix string, minState core.Bu
 			}
 		}
 		done[t] = true
-		if !t.OutputIsComplete || t == target || all {
-			for _, dep := range t.Dependencies() {
-				if !done[dep] {
-					getLabels(dep)
-				}
+		for _, dep := range t.Dependencies() {
+			if !done[dep] {
+				getLabels(dep)
 			}
 		}
 	}
@@ -843,6 +845,19 @@ func setCommand(s *scope, args []pyObject) pyObject {
 	return None
 }
 
+// setCacheKeyCommand sets the cache key command of a target, optionally for a configuration.
+func setCacheKeyCommand(s *scope, args []pyObject) pyObject {
+	target := getTargetPost(s, string(args[0].(pyString)))
+	config := string(args[1].(pyString))
+	command := string(args[2].(pyString))
+	if command == "" {
+		target.CacheKeyCommand = config
+	} else {
+		target.AddCacheKeyCommand(config, command)
+	}
+	return None
+}
+
 // selectFunc implements the select() builtin.
 func selectFunc(s *scope, args []pyObject) pyObject {
 	d, _ := asDict(args[0])
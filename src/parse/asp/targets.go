@@ -64,6 +64,9 @@ const (
 	entryPointsArgIdx
 	envArgIdx
 	fileContentArgIdx
+	depfileArgIdx
+	cacheKeyCmdArgIdx
+	testShardsArgIdx
 )
 
 // createTarget creates a new build target as part of build_rule().
@@ -102,6 +105,9 @@ func createTarget(s *scope, args []pyObject) *core.BuildTarget {
 	target.IsTextFile = isTruthy(fileContentArgIdx)
 	target.Local = isTruthy(localBuildRuleArgIdx)
 	target.ExitOnError = isTruthy(exitOnErrorArgIdx)
+	if depfile := args[depfileArgIdx]; depfile != nil && depfile != None {
+		target.Depfile = string(depfile.(pyString))
+	}
 	for _, o := range asStringList(s, args[outDirsBuildRuleArgIdx], "output_dirs") {
 		target.AddOutputDirectory(o)
 	}
@@ -127,6 +133,7 @@ func createTarget(s *scope, args []pyObject) *core.BuildTarget {
 		target.AddLabel("bin")
 	}
 	target.Command, target.Commands = decodeCommands(s, args[cmdBuildRuleArgIdx])
+	target.CacheKeyCommand, target.CacheKeyCommands = decodeCommands(s, args[cacheKeyCmdArgIdx])
 	if test {
 		if flaky := args[flakyBuildRuleArgIdx]; flaky != nil {
 			if flaky == True {
@@ -151,6 +158,9 @@ func createTarget(s *scope, args []pyObject) *core.BuildTarget {
 		target.TestTimeout = sizeAndTimeout(s, size, args[testTimeoutBuildRuleArgIdx], s.state.Config.Test.Timeout)
 		target.TestSandbox = isTruthy(testSandboxBuildRuleArgIdx)
 		target.NoTestOutput = isTruthy(noTestOutputBuildRuleArgIdx)
+		if shards, ok := args[testShardsArgIdx].(pyInt); ok && shards > 1 {
+			target.TestShards = int(shards)
+		}
 	}
 	return target
 }
@@ -55,7 +55,7 @@ var opts struct {
 	Usage      string `usage:"Please is a high-performance multi-language build system.\n\nIt uses BUILD files to describe what to build and how to build it.\nSee https://please.build for more information about how it works and what Please can do for you."`
 	BuildFlags struct {
 		Config     string               `short:"c" long:"config" env:"PLZ_BUILD_CONFIG" description:"Build config to use. Defaults to opt."`
-		Arch       cli.Arch             `short:"a" long:"arch" description:"Architecture to compile for."`
+		Arch       []cli.Arch           `short:"a" long:"arch" description:"Architecture to compile for. Can be given multiple times to build for several at once."`
 		RepoRoot   cli.Filepath         `short:"r" long:"repo_root" description:"Root of repository to build."`
 		NumThreads int                  `short:"n" long:"num_threads" description:"Number of concurrent build operations. Default is number of CPUs + 2."`
 		Include    []string             `short:"i" long:"include" description:"Label of targets to include in automatic detection."`
@@ -275,6 +275,12 @@ var opts struct {
 				Targets []core.BuildLabel `positional-arg-name:"targets" description:"Targets to export."`
 			} `positional-args:"true"`
 		} `command:"outputs" description:"Exports outputs of a set of targets"`
+
+		CompileCommands struct {
+			Args struct {
+				Targets []core.BuildLabel `positional-arg-name:"targets" description:"Targets to export compile commands for. Defaults to everything."`
+			} `positional-args:"true"`
+		} `command:"compile_commands" description:"Writes a compile_commands.json for the C and C++ sources in a set of targets, without building them"`
 	} `command:"export" subcommands-optional:"true" description:"Exports a set of targets and files from the repo."`
 
 	Format struct {
@@ -339,6 +345,12 @@ var opts struct {
 				Fragments cli.StdinStrings `positional-arg-name:"fragment" description:"Initial fragment to attempt to complete"`
 			} `positional-args:"true"`
 		} `command:"completions" subcommands-optional:"true" description:"Prints possible completions for a string."`
+		IncludeCost struct {
+			Num  int `short:"n" long:"num" default:"20" description:"Number of headers to print in each list (0 for all of them)"`
+			Args struct {
+				Targets []core.BuildLabel `positional-arg-name:"targets" description:"Targets to consider, along with their dependencies. Defaults to the whole repo."`
+			} `positional-args:"true"`
+		} `command:"includecost" description:"Prints which C & C++ headers cost the most compile time and cause the most rebuilds."`
 		Input struct {
 			Args struct {
 				Targets []core.BuildLabel `positional-arg-name:"targets" description:"Targets to display inputs for" required:"true"`
@@ -607,6 +619,11 @@ var buildFunctions = map[string]func() int{
 		}
 		return toExitCode(success, state)
 	},
+	"compile_commands": func() int {
+		return runQuery(true, opts.Export.CompileCommands.Args.Targets, func(state *core.BuildState) {
+			export.CompileCommands(state, opts.Export.Output, state.ExpandOriginalLabels())
+		})
+	},
 	"help": func() int {
 		return toExitCode(help.Help(string(opts.Help.Args.Topic)), nil)
 	},
@@ -645,6 +662,11 @@ var buildFunctions = map[string]func() int{
 			query.Print(state.Graph, state.ExpandOriginalLabels(), opts.Query.Print.Fields, opts.Query.Print.Labels)
 		})
 	},
+	"includecost": func() int {
+		return runQuery(true, opts.Query.IncludeCost.Args.Targets, func(state *core.BuildState) {
+			query.IncludeCost(state, state.ExpandOriginalLabels(), opts.Query.IncludeCost.Num)
+		})
+	},
 	"input": func() int {
 		return runQuery(true, opts.Query.Input.Args.Targets, func(state *core.BuildState) {
 			query.TargetInputs(state.Graph, state.ExpandOriginalLabels())
@@ -917,11 +939,12 @@ func Please(targets []core.BuildLabel, config *core.Configuration, shouldBuild,
 	state.ShowTestOutput = opts.Test.ShowOutput || opts.Cover.ShowOutput
 	state.DebugTests = debugTests
 	state.ShowAllOutput = opts.OutputFlags.ShowAllOutput
+	state.Tracing = opts.OutputFlags.TraceFile != ""
 	state.ParsePackageOnly = opts.ParsePackageOnly
 	state.DownloadOutputs = (!opts.Build.NoDownload && !opts.Run.Remote && len(targets) > 0 && (!targets[0].IsAllSubpackages() || len(opts.BuildFlags.Include) > 0)) || opts.Build.Download
 	state.SetIncludeAndExclude(opts.BuildFlags.Include, opts.BuildFlags.Exclude)
-	if opts.BuildFlags.Arch.OS != "" {
-		state.TargetArch = opts.BuildFlags.Arch
+	if len(opts.BuildFlags.Arch) > 0 {
+		state.TargetArch = opts.BuildFlags.Arch[0]
 	}
 
 	if state.DebugTests && len(targets) != 1 {
@@ -963,7 +986,11 @@ func runPlease(state *core.BuildState, targets []core.BuildLabel) {
 		output.MonitorState(ctx, state, !pretty, detailedTests, streamTests, string(opts.OutputFlags.TraceFile))
 		wg.Done()
 	}()
-	plz.Run(targets, opts.BuildFlags.PreTargets, state, config, state.TargetArch)
+	archs := opts.BuildFlags.Arch
+	if len(archs) == 0 {
+		archs = []cli.Arch{state.TargetArch}
+	}
+	plz.Run(targets, opts.BuildFlags.PreTargets, state, config, archs)
 	cancel()
 	wg.Wait()
 }
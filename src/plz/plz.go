@@ -24,7 +24,7 @@ var log = logging.MustGetLogger("plz")
 // afterwards to find success / failure.
 // To get detailed results as it runs, use state.Results. You should call that *before*
 // starting this (otherwise a sufficiently fast build may bypass you completely).
-func Run(targets, preTargets []core.BuildLabel, state *core.BuildState, config *core.Configuration, arch cli.Arch) {
+func Run(targets, preTargets []core.BuildLabel, state *core.BuildState, config *core.Configuration, archs []cli.Arch) {
 	parse.InitParser(state)
 	build.Init(state)
 	if state.Config.Remote.URL != "" {
@@ -35,7 +35,7 @@ func Run(targets, preTargets []core.BuildLabel, state *core.BuildState, config *
 	}
 
 	// Start looking for the initial targets to kick the build off
-	go findOriginalTasks(state, preTargets, targets, arch)
+	go findOriginalTasks(state, preTargets, targets, archs)
 
 	parses, builds, remoteBuilds, tests, remoteTests := state.TaskQueues()
 
@@ -70,6 +70,7 @@ func Run(targets, preTargets []core.BuildLabel, state *core.BuildState, config *
 	if state.Cache != nil {
 		state.Cache.Shutdown()
 	}
+	state.SaveBuildHistory()
 	if state.RemoteClient != nil {
 		_, _, in, out := state.RemoteClient.DataRate()
 		log.Info("Total remote RPC data in: %d out: %d", in, out)
@@ -81,7 +82,7 @@ func Run(targets, preTargets []core.BuildLabel, state *core.BuildState, config *
 // RunHost is a convenience function that uses the host architecture, the given state's
 // configuration and no pre targets. It is otherwise identical to Run.
 func RunHost(targets []core.BuildLabel, state *core.BuildState) {
-	Run(targets, nil, state, state.Config, cli.HostArch())
+	Run(targets, nil, state, state.Config, []cli.Arch{cli.HostArch()})
 }
 
 func doTasks(tid int, state *core.BuildState, builds <-chan core.BuildTask, tests <-chan core.TestTask, remote bool) {
@@ -106,18 +107,24 @@ func doTasks(tid int, state *core.BuildState, builds <-chan core.BuildTask, test
 }
 
 // findOriginalTasks finds the original parse tasks for the original set of targets.
-func findOriginalTasks(state *core.BuildState, preTargets, targets []core.BuildLabel, arch cli.Arch) {
+// If there are several architectures they're all built at once, so they share the same host
+// tools and packages that aren't specific to any of them.
+func findOriginalTasks(state *core.BuildState, preTargets, targets []core.BuildLabel, archs []cli.Arch) {
 	if state.Config.Bazel.Compatibility && fs.FileExists("WORKSPACE") {
 		// We have to parse the WORKSPACE file before anything else to understand subrepos.
 		// This is a bit crap really since it inhibits parallelism for the first step.
 		parse.Parse(0, state, core.NewBuildLabel("workspace", "all"), core.OriginalTarget, false)
 	}
-	if arch.Arch != "" {
-		// Set up a new subrepo for this architecture.
-		state.Graph.AddSubrepo(core.SubrepoForArch(state, arch))
+	for _, arch := range archs {
+		if arch.Arch != "" {
+			// Set up a new subrepo for this architecture.
+			state.Graph.AddSubrepo(core.SubrepoForArch(state, arch))
+		}
 	}
 	if len(preTargets) > 0 {
-		findOriginalTaskSet(state, preTargets, false, arch)
+		for _, arch := range archs {
+			findOriginalTaskSet(state, preTargets, false, arch)
+		}
 		for _, target := range preTargets {
 			if target.IsAllTargets() {
 				log.Debug("Waiting for pre-target %s...", target)
@@ -131,7 +138,9 @@ func findOriginalTasks(state *core.BuildState, preTargets, targets []core.BuildL
 			log.Debug("Pre-target %s built, continuing...", target)
 		}
 	}
-	findOriginalTaskSet(state, targets, true, arch)
+	for _, arch := range archs {
+		findOriginalTaskSet(state, targets, true, arch)
+	}
 	log.Debug("Original target scan complete")
 	state.TaskDone() // initial target adding counts as one.
 }
@@ -6,6 +6,9 @@ import (
 	"syscall"
 )
 
+// maxRSSUnit is the unit of ru_maxrss in bytes; Linux reports it in kilobytes.
+const maxRSSUnit = 1024
+
 // ExecCommand executes an external command.
 // We set Pdeathsig to try to make sure commands don't outlive us if we die.
 // N.B. This does not start the command - the caller must handle that (or use one
@@ -71,11 +74,3 @@ func (e *Executor) ExecCommand(sandbox SandboxConfig, command string, args ...st
 	}
 	return cmd
 }
-
-// Say nothing...
-func boolToString(value bool) string {
-	if value {
-		return "1"
-	}
-	return "0"
-}
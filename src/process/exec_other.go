@@ -3,10 +3,16 @@
 package process
 
 import (
+	"context"
+	"fmt"
+	"io"
 	"os/exec"
 	"syscall"
 )
 
+// maxRSSUnit is the unit of ru_maxrss in bytes; unlike Linux, macOS reports it in bytes.
+const maxRSSUnit = 1
+
 // ExecCommand executes an external command.
 // N.B. This does not start the command - the caller must handle that (or use one
 //      of the other functions which are higher-level interfaces).
@@ -17,3 +23,20 @@ func (e *Executor) ExecCommand(sandbox SandboxConfig, command string, args ...st
 	}
 	return cmd
 }
+
+// sandboxServer is not supported on non-Linux platforms.
+type sandboxServer struct{}
+
+func newSandboxServer(tool string) *sandboxServer {
+	return nil
+}
+
+func (s *sandboxServer) Start() error {
+	return fmt.Errorf("the sandbox server is only supported on Linux")
+}
+
+func (s *sandboxServer) Stop() {}
+
+func (s *sandboxServer) Run(ctx context.Context, sandbox SandboxConfig, dir string, env, argv []string, stdin io.Reader, stdout, stderr io.Writer) (ResourceUsage, error) {
+	return ResourceUsage{}, s.Start()
+}
@@ -35,11 +35,16 @@ type Executor struct {
 	// The tool that will do the network/mount sandboxing
 	sandboxTool      string
 	usePleaseSandbox bool
-	processes        map[*exec.Cmd]*os.Process
-	mutex            sync.Mutex
+	// A long-lived instance of the sandbox tool which sandboxed actions are sent to, if enabled.
+	sandboxServer *sandboxServer
+	processes     map[*exec.Cmd]*os.Process
+	mutex         sync.Mutex
 }
 
-func NewSandboxingExecutor(usePleaseSandbox bool, namespace NamespacingPolicy, sandboxTool string) *Executor {
+// NewSandboxingExecutor returns a new Executor that sandboxes actions as requested.
+// If useSandboxServer is true and an external sandbox tool is given, it will be started once as
+// a server and reused for all sandboxed actions.
+func NewSandboxingExecutor(usePleaseSandbox bool, namespace NamespacingPolicy, sandboxTool string, useSandboxServer bool) *Executor {
 	if usePleaseSandbox {
 		log.Warning("The please built in sandboxing is experimental and may not work as expected. Caveat usor!")
 	}
@@ -49,13 +54,17 @@ func NewSandboxingExecutor(usePleaseSandbox bool, namespace NamespacingPolicy, s
 		sandboxTool:      sandboxTool,
 		processes:        map[*exec.Cmd]*os.Process{},
 	}
+	// The server does its own namespacing so doesn't make sense in combination with doing it here.
+	if useSandboxServer && !usePleaseSandbox && sandboxTool != "" && namespace != NamespaceAlways && namespace != NamespaceSandbox {
+		o.sandboxServer = newSandboxServer(sandboxTool)
+	}
 	cli.AtExit(o.killAll) // Kill any subprocess if we are ourselves killed
 	return o
 }
 
 // New returns a new Executor.
 func New() *Executor {
-	return NewSandboxingExecutor(false, NamespaceNever, "")
+	return NewSandboxingExecutor(false, NamespaceNever, "", false)
 }
 
 // SandboxConfig contains what namespaces should be sandboxed
@@ -95,38 +104,57 @@ func (e *Executor) ExecWithTimeout(ctx context.Context, target Target, dir strin
 	// control over how the process gets terminated.
 	ctx, cancel := context.WithTimeout(ctx, timeout)
 	defer cancel()
-	cmd := e.ExecCommand(sandbox, argv[0], argv[1:]...)
-	cmd.Dir = dir
-	cmd.Env = append(cmd.Env, env...)
-
 	var out bytes.Buffer
 	var outerr safeBuffer
 	var progress *float32
+	var stdin io.Reader
+	var stdout, stderr io.Writer
 	if showOutput {
-		cmd.Stdout = io.MultiWriter(os.Stderr, &out, &outerr)
-		cmd.Stderr = io.MultiWriter(os.Stderr, &outerr)
+		stdout = io.MultiWriter(os.Stderr, &out, &outerr)
+		stderr = io.MultiWriter(os.Stderr, &outerr)
 	} else {
-		cmd.Stdout = io.MultiWriter(&out, &outerr)
-		cmd.Stderr = &outerr
+		stdout = io.MultiWriter(&out, &outerr)
+		stderr = &outerr
 	}
 	if target != nil && target.ShouldShowProgress() {
 		progress = new(float32)
-		cmd.Stdout = newProgressWriter(target, progress, cmd.Stdout)
-		cmd.Stderr = newProgressWriter(target, progress, cmd.Stderr)
+		stdout = newProgressWriter(target, progress, stdout)
+		stderr = newProgressWriter(target, progress, stderr)
 	}
 	if attachStdin {
-		cmd.Stdin = os.Stdin
+		stdin = os.Stdin
 	}
 	if attachStdout {
-		cmd.Stdout = os.Stdout
-		cmd.Stderr = os.Stderr
+		stdout = os.Stdout
+		stderr = os.Stderr
 	}
 	if target != nil {
 		go logProgress(ctx, target, progress)
 	}
+	if e.sandboxServer != nil && sandbox != NoSandbox && e.sandboxServer.Start() == nil {
+		env = append([]string{"SHARE_NETWORK=" + boolToString(!sandbox.Network), "SHARE_MOUNT=" + boolToString(!sandbox.Mount)}, env...)
+		start := time.Now()
+		usage, err := e.sandboxServer.Run(ctx, sandbox, dir, env, argv, stdin, stdout, stderr)
+		if err != nil && ctx.Err() != nil {
+			// As below, a process that we killed for running out of time reports the context's error,
+			// whatever went wrong with the connection to the server as a result.
+			return out.Bytes(), outerr.Bytes(), ctx.Err()
+		}
+		// Usage is only known if the process actually completed, rather than us killing it.
+		usage.Wall = time.Since(start)
+		recordResourceUsage(target, usage)
+		return out.Bytes(), outerr.Bytes(), err
+	}
+	cmd := e.ExecCommand(sandbox, argv[0], argv[1:]...)
+	cmd.Dir = dir
+	cmd.Env = append(cmd.Env, env...)
+	cmd.Stdin = stdin
+	cmd.Stdout = stdout
+	cmd.Stderr = stderr
 	// Start the command, wait for the timeout & then kill it.
 	// We deliberately don't use CommandContext because it will only send SIGKILL which
 	// child processes can't handle themselves.
+	start := time.Now()
 	err := cmd.Start()
 	if err != nil {
 		return nil, nil, err
@@ -137,7 +165,9 @@ func (e *Executor) ExecWithTimeout(ctx context.Context, target Target, dir strin
 	go runCommand(cmd, ch)
 	select {
 	case err = <-ch:
-		// Do nothing.
+		usage := processResourceUsage(cmd.ProcessState)
+		usage.Wall = time.Since(start)
+		recordResourceUsage(target, usage)
 	case <-ctx.Done():
 		err = ctx.Err()
 		e.KillProcess(cmd)
@@ -265,6 +295,10 @@ func progressMessage(progress *float32) string {
 
 // killAll kills all subprocesses of this executor.
 func (e *Executor) killAll() {
+	if e.sandboxServer != nil {
+		// This kills everything running within it too.
+		e.sandboxServer.Stop()
+	}
 	e.mutex.Lock()
 	processes := make([]*exec.Cmd, 0, len(e.processes))
 	for proc := range e.processes {
@@ -293,6 +327,14 @@ func ExecCommand(args ...string) ([]byte, error) {
 	return cmd.CombinedOutput()
 }
 
+// Say nothing...
+func boolToString(value bool) string {
+	if value {
+		return "1"
+	}
+	return "0"
+}
+
 // BashCommand returns the command that we'd use to execute a subprocess in a shell with.
 func BashCommand(binary, command string, exitOnError bool) []string {
 	if exitOnError {
@@ -43,6 +43,20 @@ func TestExecWithTimeoutStderr(t *testing.T) {
 	assert.Equal(t, "hello\n", string(stderr))
 }
 
+func TestExecWithTimeoutRecordsResourceUsage(t *testing.T) {
+	targ := &UsageRecordingTarget{Target: &target{}}
+	_, _, err := New().ExecWithTimeoutShell(targ, "", nil, 10*time.Second, false, NoSandbox, "head -c 10000000 /dev/zero | tail -c 1 > /dev/null")
+	assert.NoError(t, err)
+	assert.True(t, targ.Usage.MaxRSS > 0)
+}
+
+func TestResourceUsageAdd(t *testing.T) {
+	a := ResourceUsage{User: time.Second, System: 2 * time.Second, MaxRSS: 100}
+	b := ResourceUsage{User: 3 * time.Second, System: time.Second, MaxRSS: 50}
+	assert.Equal(t, ResourceUsage{User: 4 * time.Second, System: 3 * time.Second, MaxRSS: 100}, a.Add(b))
+	assert.Equal(t, 7*time.Second, a.Add(b).CPU())
+}
+
 func TestKillSubprocesses(t *testing.T) {
 	e := New()
 	cmd := e.ExecCommand(NoSandbox, "sleep", "infinity")
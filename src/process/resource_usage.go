@@ -0,0 +1,75 @@
+package process
+
+import (
+	"os"
+	"syscall"
+	"time"
+)
+
+// ResourceUsage describes the resources consumed by a subprocess, including any of its
+// descendants that it waited for.
+type ResourceUsage struct {
+	// Elapsed real time from starting the process to its exit.
+	Wall time.Duration
+	// CPU time spent in user and kernel mode respectively.
+	User, System time.Duration
+	// Peak resident set size, in bytes.
+	MaxRSS int64
+}
+
+// Add returns the combination of this usage with another that ran after it.
+// Times accumulate, but memory is the peak of either.
+func (u ResourceUsage) Add(other ResourceUsage) ResourceUsage {
+	u.Wall += other.Wall
+	u.User += other.User
+	u.System += other.System
+	if other.MaxRSS > u.MaxRSS {
+		u.MaxRSS = other.MaxRSS
+	}
+	return u
+}
+
+// CPU returns the total CPU time used.
+func (u ResourceUsage) CPU() time.Duration {
+	return u.User + u.System
+}
+
+// A ResourceUsageRecorder is an optional extension to Target which is informed of the
+// resources used by each process run for it.
+type ResourceUsageRecorder interface {
+	RecordResourceUsage(ResourceUsage)
+}
+
+// A UsageRecordingTarget wraps a Target and accumulates the resource usage of processes run for it.
+// Callers should create one per action, since a single target may run several concurrently (e.g.
+// multiple runs of a test).
+type UsageRecordingTarget struct {
+	Target
+	Usage ResourceUsage
+}
+
+// RecordResourceUsage implements the ResourceUsageRecorder interface.
+func (t *UsageRecordingTarget) RecordResourceUsage(usage ResourceUsage) {
+	t.Usage = t.Usage.Add(usage)
+}
+
+// recordResourceUsage passes the resources used by a finished process to the target, if it wants them.
+func recordResourceUsage(target Target, usage ResourceUsage) {
+	if recorder, ok := target.(ResourceUsageRecorder); ok {
+		recorder.RecordResourceUsage(usage)
+	}
+}
+
+// processResourceUsage returns the resources used by a process that has been waited for.
+func processResourceUsage(state *os.ProcessState) ResourceUsage {
+	if state != nil {
+		if ru, ok := state.SysUsage().(*syscall.Rusage); ok {
+			return ResourceUsage{
+				User:   time.Duration(ru.Utime.Nano()),
+				System: time.Duration(ru.Stime.Nano()),
+				MaxRSS: int64(ru.Maxrss) * maxRSSUnit,
+			}
+		}
+	}
+	return ResourceUsage{}
+}
@@ -0,0 +1,99 @@
+package process
+
+import (
+	"bytes"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"os"
+	"sync"
+	"syscall"
+	"time"
+)
+
+// These must match the definitions in src/sandbox/server_linux.c
+const (
+	sandboxRequestNet   = 1
+	sandboxRequestMount = 2
+)
+
+// encodeSandboxRequest encodes a request to the server, returning the header and payload.
+func encodeSandboxRequest(sandbox SandboxConfig, dir string, env, argv []string) ([]byte, []byte) {
+	var payload bytes.Buffer
+	for _, strs := range [][]string{{dir}, argv, env} {
+		for _, s := range strs {
+			payload.WriteString(s)
+			payload.WriteByte(0)
+		}
+	}
+	flags := 0
+	if sandbox.Network {
+		flags |= sandboxRequestNet
+	}
+	if sandbox.Mount {
+		flags |= sandboxRequestMount
+	}
+	header := make([]byte, 12)
+	binary.BigEndian.PutUint32(header, uint32(payload.Len()))
+	binary.BigEndian.PutUint32(header[4:], uint32(flags))
+	binary.BigEndian.PutUint32(header[8:], uint32(len(argv)))
+	return header, payload.Bytes()
+}
+
+// readSandboxStatus reads the final exit status and resource usage of a process from the server.
+func readSandboxStatus(r io.Reader) (ResourceUsage, error) {
+	var buf [4 + 3*8]byte
+	if _, err := io.ReadFull(r, buf[:]); err != nil {
+		return ResourceUsage{}, fmt.Errorf("failed to read exit status from sandbox server: %w", err)
+	}
+	usage := ResourceUsage{
+		User:   time.Duration(binary.BigEndian.Uint64(buf[4:])) * time.Microsecond,
+		System: time.Duration(binary.BigEndian.Uint64(buf[12:])) * time.Microsecond,
+		MaxRSS: int64(binary.BigEndian.Uint64(buf[20:])),
+	}
+	if status := syscall.WaitStatus(binary.BigEndian.Uint32(buf[:])); status != 0 {
+		return usage, &SandboxExitError{Status: status}
+	}
+	return usage, nil
+}
+
+// stdinFile returns a file to pass as the stdin of the new process, and a function to close it afterwards.
+func stdinFile(stdin io.Reader) (*os.File, func(), error) {
+	if f, ok := stdin.(*os.File); ok {
+		return f, func() {}, nil
+	}
+	f, err := os.Open(os.DevNull)
+	if err != nil {
+		return nil, nil, err
+	}
+	return f, func() { f.Close() }, nil
+}
+
+// copyAndClose copies from the given reader into the writer until EOF, then closes the reader.
+func copyAndClose(wg *sync.WaitGroup, w io.Writer, r *os.File) {
+	defer wg.Done()
+	defer r.Close()
+	if w == nil {
+		w = io.Discard
+	}
+	io.Copy(w, r)
+}
+
+// A SandboxExitError is returned when a process run in the sandbox server exits unsuccessfully.
+// It is analogous to an exec.ExitError.
+type SandboxExitError struct {
+	Status syscall.WaitStatus
+}
+
+// Error implements the builtin error interface.
+func (err *SandboxExitError) Error() string {
+	if err.Status.Signaled() {
+		return "signal: " + err.Status.Signal().String()
+	}
+	return fmt.Sprintf("exit status %d", err.Status.ExitStatus())
+}
+
+// ExitCode returns the exit code of the process, or -1 if it was terminated by a signal.
+func (err *SandboxExitError) ExitCode() int {
+	return err.Status.ExitStatus()
+}
@@ -0,0 +1,150 @@
+// +build linux
+
+package process
+
+import (
+	"context"
+	"encoding/binary"
+	"fmt"
+	"io"
+	"net"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"sync"
+	"syscall"
+	"time"
+)
+
+// A sandboxServer manages a long-lived instance of the sandbox tool running in server mode.
+// Each process started through it avoids the cost of exec'ing the tool and setting up a new
+// user namespace, which is significant when running large numbers of small actions.
+type sandboxServer struct {
+	tool   string
+	dir    string
+	socket string
+	once   sync.Once
+	cmd    *exec.Cmd
+	err    error
+}
+
+func newSandboxServer(tool string) *sandboxServer {
+	return &sandboxServer{tool: tool}
+}
+
+// Start starts the server if it isn't already running.
+func (s *sandboxServer) Start() error {
+	s.once.Do(func() {
+		s.err = s.start()
+		if s.err != nil {
+			log.Warning("Failed to start sandbox server, will fall back to running %s per action: %s", s.tool, s.err)
+		}
+	})
+	return s.err
+}
+
+func (s *sandboxServer) start() error {
+	dir, err := os.MkdirTemp("", "plz_sandbox_server")
+	if err != nil {
+		return err
+	}
+	s.dir = dir
+	s.socket = filepath.Join(dir, "sandbox.sock")
+	s.cmd = exec.Command(s.tool, "--server", s.socket)
+	s.cmd.Stderr = os.Stderr
+	s.cmd.SysProcAttr = &syscall.SysProcAttr{Pdeathsig: syscall.SIGHUP}
+	if err := s.cmd.Start(); err != nil {
+		return err
+	}
+	// Wait for it to start listening; this should take a handful of milliseconds at most.
+	for i := 0; i < 100; i++ {
+		if conn, err := net.Dial("unix", s.socket); err == nil {
+			conn.Close()
+			return nil
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+	s.Stop()
+	return fmt.Errorf("timed out waiting for sandbox server to listen on %s", s.socket)
+}
+
+// Stop stops the server and cleans up its socket.
+func (s *sandboxServer) Stop() {
+	if s.cmd != nil && s.cmd.Process != nil {
+		s.cmd.Process.Kill()
+		s.cmd.Wait()
+	}
+	if s.dir != "" {
+		os.RemoveAll(s.dir)
+	}
+}
+
+// Run runs a single command in the sandbox server and waits for it to complete.
+// If the context expires the process is terminated and the context's error is returned.
+// It returns the resources used by the process (which are only known if it completed).
+func (s *sandboxServer) Run(ctx context.Context, sandbox SandboxConfig, dir string, env, argv []string, stdin io.Reader, stdout, stderr io.Writer) (ResourceUsage, error) {
+	c, err := net.Dial("unix", s.socket)
+	if err != nil {
+		return ResourceUsage{}, err
+	}
+	conn := c.(*net.UnixConn)
+	defer conn.Close()
+
+	stdinFile, closeStdin, err := stdinFile(stdin)
+	if err != nil {
+		return ResourceUsage{}, err
+	}
+	defer closeStdin()
+	outR, outW, err := os.Pipe()
+	if err != nil {
+		return ResourceUsage{}, err
+	}
+	errR, errW, err := os.Pipe()
+	if err != nil {
+		outR.Close()
+		outW.Close()
+		return ResourceUsage{}, err
+	}
+	header, payload := encodeSandboxRequest(sandbox, dir, env, argv)
+	rights := syscall.UnixRights(int(stdinFile.Fd()), int(outW.Fd()), int(errW.Fd()))
+	_, _, err = conn.WriteMsgUnix(header, rights, nil)
+	// Our copies of the write ends must be closed so we see EOF once the process is done with them.
+	outW.Close()
+	errW.Close()
+	var wg sync.WaitGroup
+	wg.Add(2)
+	go copyAndClose(&wg, stdout, outR)
+	go copyAndClose(&wg, stderr, errR)
+	defer wg.Wait()
+	if err != nil {
+		return ResourceUsage{}, err
+	} else if _, err := conn.Write(payload); err != nil {
+		return ResourceUsage{}, err
+	}
+
+	type result struct {
+		usage ResourceUsage
+		err   error
+	}
+	ch := make(chan result, 1)
+	go func() {
+		usage, err := readSandboxStatus(conn)
+		ch <- result{usage: usage, err: err}
+	}()
+	select {
+	case r := <-ch:
+		return r.usage, r.err
+	case <-ctx.Done():
+		// Mirror KillProcess; try a SIGTERM first, then kill it if it doesn't respond.
+		// Closing the connection causes the server to SIGKILL the process.
+		var sig [4]byte
+		binary.BigEndian.PutUint32(sig[:], uint32(syscall.SIGTERM))
+		conn.Write(sig[:])
+		select {
+		case <-ch:
+		case <-time.After(30 * time.Millisecond):
+		}
+		conn.Close()
+		return ResourceUsage{}, ctx.Err()
+	}
+}
@@ -0,0 +1,49 @@
+package process
+
+import (
+	"bytes"
+	"encoding/binary"
+	"syscall"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+)
+
+func TestEncodeSandboxRequest(t *testing.T) {
+	header, payload := encodeSandboxRequest(NewSandboxConfig(true, false), "/tmp/dir", []string{"A=B"}, []string{"echo", "hello"})
+	assert.Equal(t, 12, len(header))
+	assert.EqualValues(t, len(payload), binary.BigEndian.Uint32(header))
+	assert.EqualValues(t, sandboxRequestNet, binary.BigEndian.Uint32(header[4:]))
+	assert.EqualValues(t, 2, binary.BigEndian.Uint32(header[8:]))
+	assert.Equal(t, "/tmp/dir\x00echo\x00hello\x00A=B\x00", string(payload))
+}
+
+func TestReadSandboxStatus(t *testing.T) {
+	usage, err := readSandboxStatus(bytes.NewReader(sandboxStatus(0, 1500000, 20, 4096)))
+	assert.NoError(t, err)
+	assert.Equal(t, ResourceUsage{User: 1500 * time.Millisecond, System: 20 * time.Microsecond, MaxRSS: 4096}, usage)
+
+	_, err = readSandboxStatus(bytes.NewReader(sandboxStatus(0x300, 0, 0, 0)))
+	assert.Error(t, err)
+	assert.Equal(t, "exit status 3", err.Error())
+	assert.Equal(t, 3, err.(*SandboxExitError).ExitCode())
+
+	_, err = readSandboxStatus(bytes.NewReader(sandboxStatus(uint32(syscall.SIGKILL), 0, 0, 0)))
+	assert.Error(t, err)
+	assert.Equal(t, "signal: killed", err.Error())
+	assert.Equal(t, -1, err.(*SandboxExitError).ExitCode())
+
+	_, err = readSandboxStatus(bytes.NewReader([]byte{0, 0, 0, 0}))
+	assert.Error(t, err)
+}
+
+// sandboxStatus encodes a response from the sandbox server.
+func sandboxStatus(status uint32, user, system, maxRSS uint64) []byte {
+	b := make([]byte, 28)
+	binary.BigEndian.PutUint32(b, status)
+	binary.BigEndian.PutUint64(b[4:], user)
+	binary.BigEndian.PutUint64(b[12:], system)
+	binary.BigEndian.PutUint64(b[20:], maxRSS)
+	return b
+}
@@ -0,0 +1,167 @@
+package query
+
+import (
+	"fmt"
+	"sort"
+	"strings"
+	"time"
+
+	"github.com/thought-machine/please/src/build"
+	"github.com/thought-machine/please/src/core"
+)
+
+// A headerCost describes what a single header costs the build.
+type headerCost struct {
+	Header string
+	// The library that declares it in its hdrs, if any.
+	Owner core.BuildLabel
+	// The total time taken by the compile actions that included it, and the number of them,
+	// according to their depfiles the last time they were built.
+	Time      time.Duration
+	Includers int
+	// The number of compile actions that are given the header, and so are rebuilt when it changes
+	// (unless their depfiles say otherwise).
+	Rebuilds int
+}
+
+// IncludeCost prints the headers that cost the most compile time among the given targets & their
+// dependencies, and the library headers that cause the most compile actions to rebuild when they change.
+// The compile times come from the depfiles that compile actions wrote the last time they were built
+// locally, so these should have been built with cpp.usedepfiles set first.
+func IncludeCost(state *core.BuildState, labels []core.BuildLabel, num int) {
+	targets := []*core.BuildTarget{}
+	done := map[*core.BuildTarget]bool{}
+	var find func(target *core.BuildTarget)
+	find = func(target *core.BuildTarget) {
+		if !done[target] {
+			done[target] = true
+			targets = append(targets, target)
+			for _, dep := range target.Dependencies() {
+				find(dep)
+			}
+		}
+	}
+	for _, label := range labels {
+		find(state.Graph.TargetOrDie(label))
+	}
+	costs := includeCosts(state.Graph, targets, build.LoadTargetMetadata)
+
+	byTime := sortHeaderCosts(costs, func(cost *headerCost) int64 { return int64(cost.Time) })
+	if len(byTime) == 0 {
+		log.Warning("No compile actions recorded which headers they used; build with usedepfiles set in the [cpp] section of your config first")
+	} else {
+		fmt.Printf("Total compile time of the sources that include each header:\n")
+		for _, cost := range truncateHeaderCosts(byTime, num) {
+			fmt.Printf("%12s %6d  %s\n", cost.Time.Round(time.Millisecond), cost.Includers, cost.Header)
+		}
+	}
+	byRebuilds := sortHeaderCosts(costs, func(cost *headerCost) int64 {
+		if cost.Owner.IsEmpty() {
+			return 0
+		}
+		return int64(cost.Rebuilds)
+	})
+	if len(byRebuilds) > 0 {
+		fmt.Printf("Compile actions rebuilt when each library header changes (and that actually include it):\n")
+		for _, cost := range truncateHeaderCosts(byRebuilds, num) {
+			fmt.Printf("%6d %6d  %s (%s)\n", cost.Rebuilds, cost.Includers, cost.Header, cost.Owner)
+		}
+	}
+}
+
+// includeCosts works out the cost of each header used by the compile actions among the given targets.
+// The metadata of each is loaded by the given function.
+func includeCosts(graph *core.BuildGraph, targets []*core.BuildTarget, loadMetadata func(*core.BuildTarget) (*core.BuildMetadata, error)) map[string]*headerCost {
+	costs := map[string]*headerCost{}
+	cost := func(header string) *headerCost {
+		header = strings.TrimPrefix(header, core.GenDir+"/")
+		c, present := costs[header]
+		if !present {
+			c = &headerCost{Header: header}
+			costs[header] = c
+		}
+		return c
+	}
+	// The number of compile actions that have each library (or the compile action itself) among their
+	// transitive dependencies, and hence are given its headers.
+	dependents := map[core.BuildLabel]int{}
+	owned := map[core.BuildLabel][]*headerCost{}
+	for _, target := range targets {
+		if !isCompile(target) {
+			continue
+		}
+		owner := target.Label.Parent()
+		for _, hdr := range target.SourcePaths(graph, target.NamedSources["hdrs"]) {
+			if c := cost(hdr); c.Owner.IsEmpty() {
+				c.Owner = owner
+				owned[owner] = append(owned[owner], c)
+			}
+		}
+		done := map[core.BuildLabel]bool{owner: true}
+		var visit func(t *core.BuildTarget)
+		visit = func(t *core.BuildTarget) {
+			for _, dep := range t.Dependencies() {
+				if !done[dep.Label] {
+					done[dep.Label] = true
+					visit(dep)
+				}
+			}
+		}
+		visit(target)
+		for label := range done {
+			dependents[label]++
+		}
+		md, err := loadMetadata(target)
+		if err != nil || len(md.UsedInputs) == 0 {
+			continue
+		}
+		srcs := map[string]bool{}
+		for _, src := range target.SourcePaths(graph, target.NamedSources["srcs"]) {
+			srcs[src] = true
+		}
+		for _, input := range md.UsedInputs {
+			if !srcs[input] {
+				c := cost(input)
+				c.Time += md.ResourceUsage.Wall
+				c.Includers++
+			}
+		}
+	}
+	for owner, hdrs := range owned {
+		for _, c := range hdrs {
+			c.Rebuilds = dependents[owner]
+		}
+	}
+	return costs
+}
+
+// isCompile returns true if the given target compiles C or C++ sources (i.e. it uses the cc tool on
+// its srcs, as the rules in cc_rules.build_defs do).
+func isCompile(target *core.BuildTarget) bool {
+	return len(target.NamedTools("cc")) > 0 && len(target.NamedSources["srcs"]) > 0
+}
+
+// sortHeaderCosts returns the header costs with a nonzero value for the given function, highest first.
+func sortHeaderCosts(costs map[string]*headerCost, value func(cost *headerCost) int64) []*headerCost {
+	ret := make([]*headerCost, 0, len(costs))
+	for _, cost := range costs {
+		if value(cost) > 0 {
+			ret = append(ret, cost)
+		}
+	}
+	sort.Slice(ret, func(i, j int) bool {
+		if vi, vj := value(ret[i]), value(ret[j]); vi != vj {
+			return vi > vj
+		}
+		return ret[i].Header < ret[j].Header
+	})
+	return ret
+}
+
+// truncateHeaderCosts returns at most the first num costs; all of them if num isn't positive.
+func truncateHeaderCosts(costs []*headerCost, num int) []*headerCost {
+	if num > 0 && len(costs) > num {
+		return costs[:num]
+	}
+	return costs
+}
@@ -0,0 +1,72 @@
+package query
+
+import (
+	"fmt"
+	"testing"
+	"time"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/process"
+)
+
+func TestIncludeCosts(t *testing.T) {
+	graph := core.NewGraph()
+	compile := func(label, src, hdr string, deps ...*core.BuildTarget) *core.BuildTarget {
+		target := core.NewBuildTarget(core.ParseBuildLabel(label, ""))
+		target.AddNamedTool("cc", core.SystemPathLabel{Name: "cc", Path: []string{"/usr/bin"}})
+		target.AddNamedSource("srcs", core.FileLabel{File: src, Package: target.Label.PackageName})
+		if hdr != "" {
+			target.AddNamedSource("hdrs", core.FileLabel{File: hdr, Package: target.Label.PackageName})
+		}
+		for _, dep := range deps {
+			target.AddDependency(dep.Label)
+		}
+		graph.AddTarget(target)
+		require.NoError(t, target.ResolveDependencies(graph))
+		return target
+	}
+	aCompile := compile("//lib:_a#a", "a.cc", "a.h")
+	a := core.NewBuildTarget(core.ParseBuildLabel("//lib:a", ""))
+	a.AddDependency(aCompile.Label)
+	graph.AddTarget(a)
+	require.NoError(t, a.ResolveDependencies(graph))
+	bCompile := compile("//bin:_b#b", "b.cc", "", a)
+
+	metadata := map[*core.BuildTarget]*core.BuildMetadata{
+		aCompile: {
+			ResourceUsage: process.ResourceUsage{Wall: 2 * time.Second},
+			UsedInputs:    []string{"lib/a.cc", "lib/a.h"},
+		},
+		bCompile: {
+			ResourceUsage: process.ResourceUsage{Wall: 3 * time.Second},
+			UsedInputs:    []string{"bin/b.cc", "bin/b.h", "plz-out/gen/lib/a.h"},
+		},
+	}
+	costs := includeCosts(graph, []*core.BuildTarget{aCompile, a, bCompile}, func(target *core.BuildTarget) (*core.BuildMetadata, error) {
+		if md, present := metadata[target]; present {
+			return md, nil
+		}
+		return nil, fmt.Errorf("no metadata for %s", target)
+	})
+	assert.Equal(t, map[string]*headerCost{
+		"lib/a.h": {
+			Header:    "lib/a.h",
+			Owner:     a.Label,
+			Time:      5 * time.Second,
+			Includers: 2,
+			Rebuilds:  2,
+		},
+		"bin/b.h": {
+			Header:    "bin/b.h",
+			Time:      3 * time.Second,
+			Includers: 1,
+		},
+	}, costs)
+
+	byTime := sortHeaderCosts(costs, func(cost *headerCost) int64 { return int64(cost.Time) })
+	assert.Equal(t, []*headerCost{costs["lib/a.h"], costs["bin/b.h"]}, byTime)
+	assert.Equal(t, []*headerCost{costs["lib/a.h"]}, truncateHeaderCosts(byTime, 1))
+}
@@ -2,6 +2,7 @@ package remote
 
 import (
 	"context"
+	"crypto/sha1"
 	"encoding/hex"
 	"fmt"
 	"os"
@@ -9,6 +10,7 @@ import (
 	"runtime"
 	"sort"
 	"strings"
+	"sync"
 	"time"
 
 	"github.com/bazelbuild/remote-apis-sdks/go/pkg/digest"
@@ -23,9 +25,10 @@ import (
 	"github.com/thought-machine/please/src/process"
 )
 
-// uploadAction uploads a build action for a target and returns its digest.
-func (c *Client) uploadAction(target *core.BuildTarget, isTest, isRun bool) (*pb.Command, *pb.Digest, error) {
+// uploadAction uploads a build action for a target and returns it and its digest.
+func (c *Client) uploadAction(target *core.BuildTarget, isTest, isRun bool) (*pb.Command, *pb.Action, *pb.Digest, error) {
 	var command *pb.Command
+	var action *pb.Action
 	var digest *pb.Digest
 	err := c.uploadBlobs(func(ch chan<- *uploadinfo.Entry) error {
 		defer close(ch)
@@ -41,17 +44,18 @@ func (c *Client) uploadAction(target *core.BuildTarget, isTest, isRun bool) (*pb
 		}
 		commandEntry, commandDigest := c.protoEntry(command)
 		ch <- commandEntry
-		actionEntry, actionDigest := c.protoEntry(&pb.Action{
+		action = &pb.Action{
 			CommandDigest:   commandDigest,
 			InputRootDigest: inputRootDigest,
 			Timeout:         ptypes.DurationProto(timeout(target, isTest)),
 			Platform:        c.targetPlatformProperties(target),
-		})
+		}
+		actionEntry, actionDigest := c.protoEntry(action)
 		ch <- actionEntry
 		digest = actionDigest
 		return nil
 	})
-	return command, digest, err
+	return command, action, digest, err
 }
 
 // buildAction creates a build action for a target and returns the command and the action digest. No uploading is done.
@@ -199,58 +203,17 @@ func (c *Client) uploadInputs(ch chan<- *uploadinfo.Entry, target *core.BuildTar
 // uploadInputDir uploads the inputs to the build rule. It returns an un-finalised directory builder representing the
 // directory structure of the input dir. The caller is expected to finalise this by calling Build().
 func (c *Client) uploadInputDir(ch chan<- *uploadinfo.Entry, target *core.BuildTarget, isTest bool) (*dirBuilder, error) {
+	// Rules that need their transitive dependencies (notably C++ compiles, of which there are often many for each
+	// library) share the directory structure for the outputs of those between all that have the same ones.
+	// It's only done when uploading; otherwise we'd have to upload it anyway to know it's safe to share.
+	if ch != nil && !isTest && !target.IsFilegroup && target.NeedsTransitiveDependencies {
+		return c.uploadSharedInputDir(ch, target)
+	}
 	b := newDirBuilder(c)
 	for input := range c.state.IterInputs(target, isTest) {
 		if l, ok := input.Label(); ok {
-			o := c.targetOutputs(l)
-			if o == nil {
-				if dep := c.state.Graph.TargetOrDie(l); dep.Local {
-					// We have built this locally, need to upload its outputs
-					if err := c.uploadLocalTarget(dep); err != nil {
-						return nil, err
-					}
-					o = c.targetOutputs(l)
-				} else {
-					// Classic "we shouldn't get here" stuff
-					return nil, fmt.Errorf("Outputs not known for %s (should be built by now)", l)
-				}
-			}
-			pkgName := l.PackageName
-			if target.IsFilegroup {
-				pkgName = target.Label.PackageName
-			} else if isTest && l == target.Label {
-				// At test time the target itself is put at the root rather than in the normal dir.
-				// This is just How Things Are, so mimic it here.
-				pkgName = "."
-			}
-			// Recall that (as noted in setOutputs) these can have full paths on them, which
-			// we now need to sort out again to create well-formed Directory protos.
-			for _, f := range o.Files {
-				d := b.Dir(path.Join(pkgName, path.Dir(f.Name)))
-				d.Files = append(d.Files, &pb.FileNode{
-					Name:         path.Base(f.Name),
-					Digest:       f.Digest,
-					IsExecutable: f.IsExecutable,
-				})
-			}
-			for _, d := range o.Directories {
-				dir := b.Dir(path.Join(pkgName, path.Dir(d.Name)))
-				dir.Directories = append(dir.Directories, &pb.DirectoryNode{
-					Name:   path.Base(d.Name),
-					Digest: d.Digest,
-				})
-				if target.IsFilegroup {
-					if err := c.addChildDirs(b, path.Join(pkgName, d.Name), d.Digest); err != nil {
-						return b, err
-					}
-				}
-			}
-			for _, s := range o.Symlinks {
-				d := b.Dir(path.Join(pkgName, path.Dir(s.Name)))
-				d.Symlinks = append(d.Symlinks, &pb.SymlinkNode{
-					Name:   path.Base(s.Name),
-					Target: s.Target,
-				})
+			if err := c.addTargetOutputs(b, target, l, isTest); err != nil {
+				return nil, err
 			}
 			continue
 		}
@@ -258,19 +221,167 @@ func (c *Client) uploadInputDir(ch chan<- *uploadinfo.Entry, target *core.BuildT
 			return nil, err
 		}
 	}
-	if !isTest && target.Stamp {
-		stamp := core.StampFile(target)
-		entry := uploadinfo.EntryFromBlob(stamp)
-		if ch != nil {
-			ch <- entry
+	c.addGeneratedFiles(b, ch, target, isTest)
+	return b, nil
+}
+
+// uploadSharedInputDir is like uploadInputDir, but starts from a shared directory structure for all the target's
+// dependencies' outputs, which only has to be built and uploaded once between all the actions that use it.
+func (c *Client) uploadSharedInputDir(ch chan<- *uploadinfo.Entry, target *core.BuildTarget) (*dirBuilder, error) {
+	var labels []core.BuildLabel
+	var inputs []core.BuildInput
+	for input := range c.state.IterInputs(target, false) {
+		if l, ok := input.Label(); ok {
+			labels = append(labels, l)
+		} else {
+			inputs = append(inputs, input)
+		}
+	}
+	shared, err := c.sharedInputDir(target, labels)
+	if err != nil {
+		return nil, err
+	}
+	b := shared.clone()
+	for _, input := range inputs {
+		if err := c.uploadInput(b, ch, input); err != nil {
+			return nil, err
+		}
+	}
+	c.addGeneratedFiles(b, ch, target, false)
+	return b, nil
+}
+
+// A sharedInputDir is the directory structure of a set of targets' outputs, as used by any action that needs them.
+type sharedInputDir struct {
+	once sync.Once
+	b    *dirBuilder
+	err  error
+}
+
+// sharedInputDir returns the finalised directory structure for the outputs of the given targets, which are
+// dependencies of the given target. It's built and uploaded the first time it's requested; concurrent requests
+// for the same one wait for that rather than also doing so.
+func (c *Client) sharedInputDir(target *core.BuildTarget, labels []core.BuildLabel) (*dirBuilder, error) {
+	sort.Slice(labels, func(i, j int) bool { return labels[i].Less(labels[j]) })
+	h := sha1.New()
+	for _, l := range labels {
+		h.Write([]byte(l.String()))
+		h.Write([]byte{0})
+	}
+	key := string(h.Sum(nil))
+	c.sharedInputMutex.Lock()
+	s, present := c.sharedInputDirs[key]
+	if !present {
+		s = &sharedInputDir{}
+		c.sharedInputDirs[key] = s
+	}
+	c.sharedInputMutex.Unlock()
+	s.once.Do(func() {
+		b := newDirBuilder(c)
+		for _, l := range labels {
+			if err := c.addTargetOutputs(b, target, l, false); err != nil {
+				s.err = err
+				return
+			}
+		}
+		s.err = c.uploadBlobs(func(ch chan<- *uploadinfo.Entry) error {
+			defer close(ch)
+			b.Build(ch)
+			return nil
+		})
+		s.b = b
+	})
+	if s.err != nil {
+		// Don't hang onto failures, whoever needs it next can try again.
+		c.sharedInputMutex.Lock()
+		if c.sharedInputDirs[key] == s {
+			delete(c.sharedInputDirs, key)
+		}
+		c.sharedInputMutex.Unlock()
+	}
+	return s.b, s.err
+}
+
+// addTargetOutputs adds the outputs of the given target, which is an input to target, to a directory builder.
+func (c *Client) addTargetOutputs(b *dirBuilder, target *core.BuildTarget, l core.BuildLabel, isTest bool) error {
+	o := c.targetOutputs(l)
+	if o == nil {
+		if dep := c.state.Graph.TargetOrDie(l); dep.Local {
+			// We have built this locally, need to upload its outputs
+			if err := c.uploadLocalTarget(dep); err != nil {
+				return err
+			}
+			o = c.targetOutputs(l)
+		} else {
+			// Classic "we shouldn't get here" stuff
+			return fmt.Errorf("Outputs not known for %s (should be built by now)", l)
 		}
-		d := b.Dir(".")
+	}
+	pkgName := l.PackageName
+	if target.IsFilegroup {
+		pkgName = target.Label.PackageName
+	} else if isTest && l == target.Label {
+		// At test time the target itself is put at the root rather than in the normal dir.
+		// This is just How Things Are, so mimic it here.
+		pkgName = "."
+	}
+	// Recall that (as noted in setOutputs) these can have full paths on them, which
+	// we now need to sort out again to create well-formed Directory protos.
+	for _, f := range o.Files {
+		d := b.Dir(path.Join(pkgName, path.Dir(f.Name)))
 		d.Files = append(d.Files, &pb.FileNode{
-			Name:   target.StampFileName(),
-			Digest: entry.Digest.ToProto(),
+			Name:         path.Base(f.Name),
+			Digest:       f.Digest,
+			IsExecutable: f.IsExecutable,
 		})
 	}
-	return b, nil
+	for _, d := range o.Directories {
+		dir := b.Dir(path.Join(pkgName, path.Dir(d.Name)))
+		dir.Directories = append(dir.Directories, &pb.DirectoryNode{
+			Name:   path.Base(d.Name),
+			Digest: d.Digest,
+		})
+		if target.IsFilegroup {
+			if err := c.addChildDirs(b, path.Join(pkgName, d.Name), d.Digest); err != nil {
+				return err
+			}
+		}
+	}
+	for _, s := range o.Symlinks {
+		d := b.Dir(path.Join(pkgName, path.Dir(s.Name)))
+		d.Symlinks = append(d.Symlinks, &pb.SymlinkNode{
+			Name:   path.Base(s.Name),
+			Target: s.Target,
+		})
+	}
+	return nil
+}
+
+// addGeneratedFiles adds the files that Please writes into the build directory to a directory builder,
+// i.e. the stamp file and the list of link inputs, if the target needs them.
+func (c *Client) addGeneratedFiles(b *dirBuilder, ch chan<- *uploadinfo.Entry, target *core.BuildTarget, isTest bool) {
+	if isTest {
+		return
+	}
+	if target.Stamp {
+		c.addGeneratedFile(b, ch, target.StampFileName(), core.StampFile(target))
+	}
+	if target.HasLabel(core.LinkInputsLabel) {
+		c.addGeneratedFile(b, ch, core.LinkInputsFileName, core.LinkInputsFile(c.state.Graph, target))
+	}
+}
+
+// addGeneratedFile adds a file with the given contents to the root of a directory builder.
+func (c *Client) addGeneratedFile(b *dirBuilder, ch chan<- *uploadinfo.Entry, name string, contents []byte) {
+	entry := uploadinfo.EntryFromBlob(contents)
+	if ch != nil {
+		ch <- entry
+	}
+	d := b.Dir(".")
+	d.Files = append(d.Files, &pb.FileNode{
+		Name:   name,
+		Digest: entry.Digest.ToProto(),
+	})
 }
 
 // addChildDirs adds a set of child directories to a builder.
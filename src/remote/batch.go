@@ -0,0 +1,378 @@
+// Support for batching small remote build actions together.
+//
+// Some actions (C++ compiles of small sources being the main example) take less time to run than
+// it takes to schedule them remotely. Those that need their transitive dependencies and last took
+// less than the configured duration wait briefly for others from the same package, and are then
+// executed as one action in which each runs in its own directory, with its own input root.
+// The result of each is split out again afterwards and stored under its own action digest, so
+// they're still cached individually.
+
+package remote
+
+import (
+	"bufio"
+	"bytes"
+	"context"
+	"fmt"
+	"path"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+
+	"github.com/bazelbuild/remote-apis-sdks/go/pkg/digest"
+	"github.com/bazelbuild/remote-apis-sdks/go/pkg/uploadinfo"
+	pb "github.com/bazelbuild/remote-apis/build/bazel/remote/execution/v2"
+	"github.com/golang/protobuf/ptypes"
+	"google.golang.org/genproto/googleapis/longrunning"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/process"
+)
+
+// batchDelay is how long actions wait for others to be batched with.
+const batchDelay = 20 * time.Millisecond
+
+// maxBatchSize is the most actions that we'll put in a single batch.
+const maxBatchSize = 64
+
+// Names of the files that each action's stdout & stderr are written to, within its directory.
+const batchStdout = ".plz_stdout"
+const batchStderr = ".plz_stderr"
+
+// batchStatus is the file that the exit code of each action in a batch is written to.
+const batchStatus = ".plz_batch_status"
+
+// A batcher groups actions into batches.
+type batcher struct {
+	c         *Client
+	threshold time.Duration
+	pending   map[string]*pendingBatch
+	mutex     sync.Mutex
+}
+
+// A pendingBatch is a batch that's waiting for more actions to be added to it.
+type pendingBatch struct {
+	members  []*batchMember
+	duration time.Duration
+}
+
+// A batchMember is a single action in a batch.
+type batchMember struct {
+	tid        int
+	target     *core.BuildTarget
+	command    *pb.Command
+	action     *pb.Action
+	digest     *pb.Digest
+	duration   time.Duration
+	needStdout bool
+	done       chan batchResult
+}
+
+// A batchResult is the result of a single action in a batch.
+// If ok is false, it wasn't successful and should be retried individually.
+type batchResult struct {
+	metadata *core.BuildMetadata
+	ar       *pb.ActionResult
+	ok       bool
+}
+
+func newBatcher(c *Client, threshold time.Duration) *batcher {
+	return &batcher{
+		c:         c,
+		threshold: threshold,
+		pending:   map[string]*pendingBatch{},
+	}
+}
+
+// eligible returns true if the given target could be batched with others.
+func (b *batcher) eligible(target *core.BuildTarget) bool {
+	return target.NeedsTransitiveDependencies && !target.Stamp && !target.IsFilegroup && len(target.OutputDirectories) == 0
+}
+
+// record records how long an action took to execute, from its result.
+func (b *batcher) record(target *core.BuildTarget, ar *pb.ActionResult) {
+	if ar.ExecutionMetadata != nil && b.eligible(target) {
+		md := ar.ExecutionMetadata
+		b.c.state.RecordDuration(target, toTime(md.ExecutionCompletedTimestamp).Sub(toTime(md.ExecutionStartTimestamp)))
+	}
+}
+
+// execute executes the given action as part of a batch, if it was quick enough last time.
+// It returns false if it wasn't, or it didn't succeed as part of the batch, in which case it should be executed
+// individually (which also deals with reporting any errors from it).
+// The action & its inputs must have already been uploaded.
+func (b *batcher) execute(tid int, target *core.BuildTarget, command *pb.Command, action *pb.Action, digest *pb.Digest, needStdout bool) (*core.BuildMetadata, *pb.ActionResult, bool) {
+	duration, present := b.c.state.ActionDuration(target)
+	if !present || duration >= b.threshold {
+		return nil, nil, false
+	}
+	m := &batchMember{
+		tid:        tid,
+		target:     target,
+		command:    command,
+		action:     action,
+		digest:     digest,
+		duration:   duration,
+		needStdout: needStdout,
+		done:       make(chan batchResult, 1),
+	}
+	// Actions in a batch have to share a platform; we also keep them to the same package since they're
+	// likely to have many of the same inputs, which the remote worker can then share between them.
+	key := target.Label.PackageName + "|" + string(mustMarshal(action.Platform))
+	b.mutex.Lock()
+	batch, present := b.pending[key]
+	if !present {
+		batch = &pendingBatch{}
+		b.pending[key] = batch
+		time.AfterFunc(batchDelay, func() { b.flush(key, batch) })
+	}
+	batch.members = append(batch.members, m)
+	batch.duration += duration
+	full := batch.duration >= b.threshold || len(batch.members) >= maxBatchSize
+	b.mutex.Unlock()
+	b.c.state.LogBuildResult(tid, target, core.TargetBuilding, "Batching...")
+	if full {
+		b.flush(key, batch)
+	}
+	result := <-m.done
+	return result.metadata, result.ar, result.ok
+}
+
+// flush executes a pending batch, unless it's already been done.
+func (b *batcher) flush(key string, batch *pendingBatch) {
+	b.mutex.Lock()
+	if b.pending[key] != batch {
+		b.mutex.Unlock()
+		return
+	}
+	delete(b.pending, key)
+	b.mutex.Unlock()
+	if len(batch.members) == 1 {
+		batch.members[0].done <- batchResult{} // Nothing to batch it with, just run it individually.
+		return
+	}
+	results, err := b.c.executeBatch(batch.members)
+	if err != nil {
+		log.Warning("Failed to execute batch of %d actions, will execute them individually: %s", len(batch.members), err)
+	}
+	for i, m := range batch.members {
+		if err != nil {
+			m.done <- batchResult{}
+			continue
+		}
+		// We don't know how long each took individually; apportion the total between them as predicted.
+		if md := results[i].ar.GetExecutionMetadata(); md != nil && results[i].ok {
+			total := toTime(md.ExecutionCompletedTimestamp).Sub(toTime(md.ExecutionStartTimestamp))
+			b.c.state.RecordDuration(m.target, time.Duration(float64(total)*float64(m.duration)/float64(batch.duration)))
+		}
+		m.done <- results[i]
+	}
+}
+
+// executeBatch executes a batch of actions as a single remote action, and returns the result of each.
+func (c *Client) executeBatch(members []*batchMember) ([]batchResult, error) {
+	root, command, timeout := batchCommand(c.shellPath, members)
+	var digest *pb.Digest
+	if err := c.uploadBlobs(func(ch chan<- *uploadinfo.Entry) error {
+		defer close(ch)
+		rootEntry, rootDigest := c.protoEntry(root)
+		ch <- rootEntry
+		commandEntry, commandDigest := c.protoEntry(command)
+		ch <- commandEntry
+		actionEntry, actionDigest := c.protoEntry(&pb.Action{
+			CommandDigest:   commandDigest,
+			InputRootDigest: rootDigest,
+			Timeout:         ptypes.DurationProto(timeout),
+			Platform:        members[0].action.Platform,
+		})
+		ch <- actionEntry
+		digest = actionDigest
+		return nil
+	}); err != nil {
+		return nil, err
+	}
+	for _, m := range members {
+		c.state.LogBuildResult(m.tid, m.target, core.TargetBuilding, fmt.Sprintf("Building (batch of %d)...", len(members)))
+	}
+	resp, err := c.client.ExecuteAndWaitProgress(c.contextWithMetadata(members[0].target), &pb.ExecuteRequest{
+		InstanceName: c.instance,
+		ActionDigest: digest,
+	}, func(*pb.ExecuteOperationMetadata) {})
+	if err != nil {
+		return nil, err
+	}
+	result, ok := resp.Result.(*longrunning.Operation_Response)
+	if !ok {
+		return nil, fmt.Errorf("unexpected response type %T", resp.Result)
+	}
+	response := &pb.ExecuteResponse{}
+	if err := ptypes.UnmarshalAny(result.Response, response); err != nil {
+		return nil, err
+	} else if response.Status != nil && convertError(response.Status) != nil {
+		return nil, convertError(response.Status)
+	} else if response.Result == nil {
+		return nil, fmt.Errorf("Build server did not return valid result")
+	} else if response.Result.ExitCode != 0 {
+		return nil, fmt.Errorf("Remotely executed command exited with %d", response.Result.ExitCode)
+	}
+	status, err := c.readBatchStatus(response.Result)
+	if err != nil {
+		return nil, err
+	}
+	ctx := context.Background()
+	results := make([]batchResult, len(members))
+	for i, m := range members {
+		if code, present := status[i]; !present || code != 0 {
+			log.Debug("%s failed in batch, will execute it individually", m.target)
+			continue
+		}
+		ar := splitBatchResult(response.Result, i)
+		if err := c.verifyActionResult(m.target, m.command, m.digest, ar, c.state.Config.Remote.VerifyOutputs, false); err != nil {
+			log.Debug("Invalid result for %s in batch, will execute it individually: %s", m.target, err)
+			continue
+		}
+		metadata, err := c.buildMetadata(ar, m.needStdout, false)
+		if err != nil {
+			continue
+		}
+		if _, err := c.client.UpdateActionResult(ctx, &pb.UpdateActionResultRequest{
+			InstanceName: c.instance,
+			ActionDigest: m.digest,
+			ActionResult: ar,
+		}); err != nil {
+			log.Warning("Failed to store action result for %s: %s", m.target, err)
+		}
+		c.locallyCacheResults(m.target, m.digest, metadata, ar)
+		results[i] = batchResult{metadata: metadata, ar: ar, ok: true}
+	}
+	return results, nil
+}
+
+// readBatchStatus reads the exit codes of each action from the result of a batch.
+func (c *Client) readBatchStatus(ar *pb.ActionResult) (map[int]int, error) {
+	for _, f := range ar.OutputFiles {
+		if f.Path == batchStatus {
+			b, _, err := c.client.ReadBlob(context.Background(), digest.NewFromProtoUnvalidated(f.Digest))
+			if err != nil {
+				return nil, err
+			}
+			return parseBatchStatus(b)
+		}
+	}
+	return nil, fmt.Errorf("batch did not produce %s", batchStatus)
+}
+
+// batchCommand returns the input root, command and timeout for a batch of actions.
+// Each action's input root is a directory within the batch's, named by its index, that it's run in.
+func batchCommand(shell string, members []*batchMember) (*pb.Directory, *pb.Command, time.Duration) {
+	root := &pb.Directory{}
+	outs := []string{batchStatus}
+	var script strings.Builder
+	var timeout time.Duration
+	for i, m := range members {
+		dir := strconv.Itoa(i)
+		root.Directories = append(root.Directories, &pb.DirectoryNode{Name: dir, Digest: m.action.InputRootDigest})
+		for _, out := range m.command.OutputPaths {
+			outs = append(outs, path.Join(dir, out))
+		}
+		outs = append(outs, path.Join(dir, batchStdout), path.Join(dir, batchStderr))
+		if d, err := ptypes.Duration(m.action.Timeout); err == nil {
+			timeout += d
+		}
+		// Each runs with exactly the environment & arguments it would have individually.
+		script.WriteString("(cd " + dir + " && exec env -i")
+		for _, v := range m.command.EnvironmentVariables {
+			script.WriteString(" " + shellQuote(v.Name+"="+v.Value))
+		}
+		for _, arg := range m.command.Arguments {
+			script.WriteString(" " + shellQuote(arg))
+		}
+		fmt.Fprintf(&script, ") >%s/%s 2>%s/%s && s=0 || s=$?; echo \"%s $s\" >> %s\n", dir, batchStdout, dir, batchStderr, dir, batchStatus)
+	}
+	// The protocol requires these to be sorted.
+	sort.Slice(root.Directories, func(i, j int) bool { return root.Directories[i].Name < root.Directories[j].Name })
+	sort.Strings(outs)
+	return root, &pb.Command{
+		Platform:             members[0].command.Platform,
+		Arguments:            process.BashCommand(shell, script.String(), false),
+		EnvironmentVariables: batchEnv(members[0].command),
+		OutputPaths:          outs,
+	}, timeout
+}
+
+// batchEnv returns the environment for the batch command itself, which only needs a path to find env.
+func batchEnv(command *pb.Command) []*pb.Command_EnvironmentVariable {
+	for _, v := range command.EnvironmentVariables {
+		if v.Name == "PATH" {
+			return []*pb.Command_EnvironmentVariable{v}
+		}
+	}
+	return nil
+}
+
+// splitBatchResult returns the result of a single action from the result of its batch.
+func splitBatchResult(ar *pb.ActionResult, index int) *pb.ActionResult {
+	prefix := strconv.Itoa(index) + "/"
+	ret := &pb.ActionResult{ExecutionMetadata: ar.ExecutionMetadata}
+	for _, f := range ar.OutputFiles {
+		if name := strings.TrimPrefix(f.Path, prefix); name == f.Path {
+			continue
+		} else if name == batchStdout {
+			ret.StdoutDigest = f.Digest
+		} else if name == batchStderr {
+			ret.StderrDigest = f.Digest
+		} else {
+			ret.OutputFiles = append(ret.OutputFiles, &pb.OutputFile{
+				Path:           name,
+				Digest:         f.Digest,
+				IsExecutable:   f.IsExecutable,
+				NodeProperties: f.NodeProperties,
+			})
+		}
+	}
+	for _, d := range ar.OutputDirectories {
+		if name := strings.TrimPrefix(d.Path, prefix); name != d.Path {
+			ret.OutputDirectories = append(ret.OutputDirectories, &pb.OutputDirectory{Path: name, TreeDigest: d.TreeDigest})
+		}
+	}
+	for _, s := range ar.OutputSymlinks {
+		if name := strings.TrimPrefix(s.Path, prefix); name != s.Path {
+			ret.OutputSymlinks = append(ret.OutputSymlinks, &pb.OutputSymlink{Path: name, Target: s.Target})
+		}
+	}
+	for _, s := range ar.OutputFileSymlinks {
+		if name := strings.TrimPrefix(s.Path, prefix); name != s.Path {
+			ret.OutputFileSymlinks = append(ret.OutputFileSymlinks, &pb.OutputSymlink{Path: name, Target: s.Target})
+		}
+	}
+	return ret
+}
+
+// parseBatchStatus parses the exit codes written by a batch, one action per line.
+func parseBatchStatus(b []byte) (map[int]int, error) {
+	ret := map[int]int{}
+	scanner := bufio.NewScanner(bytes.NewReader(b))
+	for scanner.Scan() {
+		fields := strings.Fields(scanner.Text())
+		if len(fields) != 2 {
+			return nil, fmt.Errorf("invalid batch status line: %s", scanner.Text())
+		}
+		index, err := strconv.Atoi(fields[0])
+		if err != nil {
+			return nil, err
+		}
+		code, err := strconv.Atoi(fields[1])
+		if err != nil {
+			return nil, err
+		}
+		ret[index] = code
+	}
+	return ret, scanner.Err()
+}
+
+// shellQuote quotes a string for bash.
+func shellQuote(s string) string {
+	return "'" + strings.ReplaceAll(s, "'", `'\''`) + "'"
+}
@@ -0,0 +1,95 @@
+package remote
+
+import (
+	"os"
+	"os/exec"
+	"path"
+	"testing"
+	"time"
+
+	pb "github.com/bazelbuild/remote-apis/build/bazel/remote/execution/v2"
+	"github.com/golang/protobuf/ptypes"
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+func TestBatchCommand(t *testing.T) {
+	member := func(cmd string, env ...*pb.Command_EnvironmentVariable) *batchMember {
+		return &batchMember{
+			command: &pb.Command{
+				Arguments:            []string{"bash", "-c", cmd},
+				EnvironmentVariables: append(env, &pb.Command_EnvironmentVariable{Name: "PATH", Value: os.Getenv("PATH")}),
+				OutputPaths:          []string{"out.o"},
+			},
+			action: &pb.Action{
+				InputRootDigest: &pb.Digest{Hash: cmd},
+				Timeout:         ptypes.DurationProto(time.Minute),
+			},
+		}
+	}
+	members := []*batchMember{
+		member(`echo "$X" > out.o && echo hello`, &pb.Command_EnvironmentVariable{Name: "X", Value: "it's"}),
+		member(`echo "${X:-unset}" > out.o; echo failed >&2; exit 3`),
+	}
+	root, command, timeout := batchCommand("bash", members)
+	assert.Equal(t, 2*time.Minute, timeout)
+	assert.Equal(t, 2, len(root.Directories))
+	assert.Equal(t, "0", root.Directories[0].Name)
+	assert.Equal(t, members[1].action.InputRootDigest, root.Directories[1].Digest)
+	assert.Equal(t, []string{
+		batchStatus,
+		"0/" + batchStderr,
+		"0/" + batchStdout,
+		"0/out.o",
+		"1/" + batchStderr,
+		"1/" + batchStdout,
+		"1/out.o",
+	}, command.OutputPaths)
+
+	// Now run it to check each action ran as it would have done individually.
+	dir := t.TempDir()
+	require.NoError(t, os.Mkdir(path.Join(dir, "0"), 0755))
+	require.NoError(t, os.Mkdir(path.Join(dir, "1"), 0755))
+	cmd := exec.Command(command.Arguments[0], command.Arguments[1:]...)
+	cmd.Dir = dir
+	require.NoError(t, cmd.Run())
+	assertFile := func(expected, filename string) {
+		b, err := os.ReadFile(path.Join(dir, filename))
+		require.NoError(t, err)
+		assert.Equal(t, expected, string(b))
+	}
+	assertFile("0 0\n1 3\n", batchStatus)
+	assertFile("it's\n", "0/out.o")
+	assertFile("hello\n", "0/"+batchStdout)
+	assertFile("unset\n", "1/out.o")
+	assertFile("failed\n", "1/"+batchStderr)
+}
+
+func TestSplitBatchResult(t *testing.T) {
+	ar := &pb.ActionResult{
+		OutputFiles: []*pb.OutputFile{
+			{Path: batchStatus, Digest: &pb.Digest{Hash: "status"}},
+			{Path: "0/" + batchStdout, Digest: &pb.Digest{Hash: "stdout0"}},
+			{Path: "0/package/a.o", Digest: &pb.Digest{Hash: "a"}},
+			{Path: "1/" + batchStderr, Digest: &pb.Digest{Hash: "stderr1"}},
+			{Path: "1/package/b.o", Digest: &pb.Digest{Hash: "b"}, IsExecutable: true},
+			{Path: "10/package/c.o", Digest: &pb.Digest{Hash: "c"}},
+		},
+		ExecutionMetadata: &pb.ExecutedActionMetadata{Worker: "kev"},
+	}
+	assert.Equal(t, &pb.ActionResult{
+		OutputFiles: []*pb.OutputFile{
+			{Path: "package/b.o", Digest: &pb.Digest{Hash: "b"}, IsExecutable: true},
+		},
+		StderrDigest:      &pb.Digest{Hash: "stderr1"},
+		ExecutionMetadata: ar.ExecutionMetadata,
+	}, splitBatchResult(ar, 1))
+}
+
+func TestParseBatchStatus(t *testing.T) {
+	status, err := parseBatchStatus([]byte("0 0\n1 3\n"))
+	assert.NoError(t, err)
+	assert.Equal(t, map[int]int{0: 0, 1: 3}, status)
+	_, err = parseBatchStatus([]byte("0\n"))
+	assert.Error(t, err)
+}
@@ -97,6 +97,13 @@ type Client struct {
 	// existingBlobs is used to track the set of existing blobs remotely.
 	existingBlobs     map[string]struct{}
 	existingBlobMutex sync.Mutex
+
+	// Batches small actions together, if enabled.
+	batcher *batcher
+
+	// sharedInputDirs are the input directory structures shared between actions with the same dependencies.
+	sharedInputDirs  map[string]*sharedInputDir
+	sharedInputMutex sync.Mutex
 }
 
 type actionDigestMap struct {
@@ -133,10 +140,14 @@ func New(state *core.BuildState) *Client {
 		existingBlobs: map[string]struct{}{
 			digest.Empty.Hash: {},
 		},
+		sharedInputDirs:   map[string]*sharedInputDir{},
 		fileMetadataCache: filemetadata.NewNoopCache(),
 		shellPath:         state.Config.Remote.Shell,
 	}
 	c.stats = newStatsHandler(c)
+	if state.Config.Remote.BatchDuration > 0 {
+		c.batcher = newBatcher(c, time.Duration(state.Config.Remote.BatchDuration))
+	}
 	go c.CheckInitialised() // Kick off init now, but we don't have to wait for it.
 	return c
 }
@@ -360,7 +371,7 @@ func (c *Client) Run(target *core.BuildTarget) error {
 	if err := c.CheckInitialised(); err != nil {
 		return err
 	}
-	cmd, digest, err := c.uploadAction(target, false, true)
+	cmd, _, digest, err := c.uploadAction(target, false, true)
 	if err != nil {
 		return err
 	}
@@ -593,7 +604,7 @@ func (c *Client) execute(tid int, target *core.BuildTarget, command *pb.Command,
 		}
 	}
 	// We didn't actually upload the inputs before, so we must do so now.
-	command, digest, err := c.uploadAction(target, isTest, false)
+	command, action, digest, err := c.uploadAction(target, isTest, false)
 	if err != nil {
 		return nil, nil, fmt.Errorf("Failed to upload build action: %s", err)
 	}
@@ -612,6 +623,11 @@ func (c *Client) execute(tid int, target *core.BuildTarget, command *pb.Command,
 	skipCacheLookup := (isTest && c.state.ForceRerun) || (!isTest && c.state.ForceRebuild)
 	skipCacheLookup = skipCacheLookup && c.state.IsOriginalTarget(target)
 
+	if c.batcher != nil && !isTest && !skipCacheLookup && c.batcher.eligible(target) {
+		if metadata, ar, ok := c.batcher.execute(tid, target, command, action, digest, needStdout); ok {
+			return metadata, ar, nil
+		}
+	}
 	return c.reallyExecute(tid, target, command, digest, needStdout, isTest, skipCacheLookup)
 }
 
@@ -769,6 +785,9 @@ func (c *Client) reallyExecute(tid int, target *core.BuildTarget, command *pb.Co
 			return metadata, response.Result, err
 		}
 		c.locallyCacheResults(target, digest, metadata, response.Result)
+		if c.batcher != nil && !isTest {
+			c.batcher.record(target, response.Result)
+		}
 		return metadata, response.Result, nil
 	default:
 		if !resp.Done {
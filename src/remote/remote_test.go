@@ -10,6 +10,7 @@ import (
 	"time"
 
 	"github.com/bazelbuild/remote-apis-sdks/go/pkg/digest"
+	"github.com/bazelbuild/remote-apis-sdks/go/pkg/uploadinfo"
 	pb "github.com/bazelbuild/remote-apis/build/bazel/remote/execution/v2"
 	"github.com/golang/protobuf/ptypes"
 	"github.com/stretchr/testify/assert"
@@ -212,6 +213,47 @@ func TestRemoteFilesHashConsistently(t *testing.T) {
 	assert.Equal(t, digest, digest2)
 }
 
+func TestSharedInputDirs(t *testing.T) {
+	c := newClientInstance("test")
+	require.NoError(t, c.CheckInitialised())
+	// One dependency in the same package as its dependents, so they have to modify the shared directory.
+	dep1 := core.NewBuildTarget(core.BuildLabel{PackageName: "package", Name: "dep1"})
+	dep2 := core.NewBuildTarget(core.BuildLabel{PackageName: "package2", Name: "dep2"})
+	for _, dep := range []*core.BuildTarget{dep1, dep2} {
+		c.state.Graph.AddTarget(dep)
+		c.outputs[dep.Label] = &pb.Directory{
+			Files: []*pb.FileNode{{
+				Name:   "include/" + dep.Label.Name + ".h",
+				Digest: digest.NewFromBlob([]byte(dep.Label.Name)).ToProto(),
+			}},
+		}
+	}
+	newTarget := func(name, src string) *core.BuildTarget {
+		target := core.NewBuildTarget(core.BuildLabel{PackageName: "package", Name: name})
+		target.NeedsTransitiveDependencies = true
+		target.AddSource(dep2.Label)
+		target.AddSource(dep1.Label)
+		target.AddSource(core.FileLabel{File: src, Package: "package"})
+		target.AddOutput(name + ".o")
+		c.state.Graph.AddTarget(target)
+		return target
+	}
+	for _, target := range []*core.BuildTarget{newTarget("a", "src1.txt"), newTarget("b", "src2.txt")} {
+		var shared *pb.Directory
+		err := c.uploadBlobs(func(ch chan<- *uploadinfo.Entry) error {
+			defer close(ch)
+			root, err := c.uploadInputs(ch, target, false)
+			shared = root
+			return err
+		})
+		require.NoError(t, err)
+		unshared, err := c.uploadInputs(nil, target, false)
+		require.NoError(t, err)
+		assert.Equal(t, c.digestMessage(unshared), c.digestMessage(shared))
+	}
+	assert.Equal(t, 1, len(c.sharedInputDirs))
+}
+
 func TestOutDirsSetOutsOnTarget(t *testing.T) {
 	c := newClientInstance("mock")
 
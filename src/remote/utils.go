@@ -351,6 +351,9 @@ type dirBuilder struct {
 	c    *Client
 	root *pb.Directory
 	dirs map[string]*pb.Directory
+	// cloned is true if this was cloned from another builder that was already built.
+	// Digests of directories modified since then have to be invalidated.
+	cloned bool
 }
 
 func newDirBuilder(c *Client) *dirBuilder {
@@ -365,11 +368,59 @@ func newDirBuilder(c *Client) *dirBuilder {
 	}
 }
 
+// clone returns a copy of this builder which can be modified without affecting it.
+// It should have been built already; the copy only recalculates digests for directories that are modified in it.
+func (b *dirBuilder) clone() *dirBuilder {
+	cloned := make(map[*pb.Directory]*pb.Directory, len(b.dirs))
+	dirs := make(map[string]*pb.Directory, len(b.dirs))
+	for name, dir := range b.dirs {
+		d, present := cloned[dir]
+		if !present {
+			d = &pb.Directory{
+				Files:       append([]*pb.FileNode{}, dir.Files...),
+				Directories: make([]*pb.DirectoryNode, len(dir.Directories)),
+				Symlinks:    append([]*pb.SymlinkNode{}, dir.Symlinks...),
+			}
+			for i, node := range dir.Directories {
+				d.Directories[i] = &pb.DirectoryNode{Name: node.Name, Digest: node.Digest}
+			}
+			cloned[dir] = d
+		}
+		dirs[name] = d
+	}
+	return &dirBuilder{
+		c:      b.c,
+		root:   cloned[b.root],
+		dirs:   dirs,
+		cloned: true,
+	}
+}
+
 // Dir ensures the given directory exists, and constructs any necessary parents.
 func (b *dirBuilder) Dir(name string) *pb.Directory {
+	if b.cloned {
+		b.invalidate(name)
+	}
 	return b.dir(name, "")
 }
 
+// invalidate clears the digests of an existing directory & all its parents, since it's about to be modified.
+func (b *dirBuilder) invalidate(name string) {
+	for name = strings.TrimSuffix(name, "/"); name != "." && name != "" && name != "/"; name = path.Dir(name) {
+		if _, present := b.dirs[name]; !present {
+			continue // It'll be added to its parent without a digest.
+		}
+		if parent, present := b.dirs[path.Dir(name)]; present {
+			base := path.Base(name)
+			for _, d := range parent.Directories {
+				if d.Name == base {
+					d.Digest = nil
+				}
+			}
+		}
+	}
+}
+
 func (b *dirBuilder) dir(dir, child string) *pb.Directory {
 	if dir == "." || dir == "/" {
 		return b.root
@@ -401,7 +452,7 @@ func (b *dirBuilder) Build(ch chan<- *uploadinfo.Entry) *pb.Directory {
 
 // Node returns either the file or directory corresponding to the given path (or nil for both if not found)
 func (b *dirBuilder) Node(name string) (*pb.DirectoryNode, *pb.FileNode) {
-	dir := b.Dir(path.Dir(name))
+	dir := b.dir(path.Dir(name), "")
 	base := path.Base(name)
 	for _, d := range dir.Directories {
 		if d.Name == base {
@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include "sandbox.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// The leaf cgroup created for the current process's child, or NULL if there isn't one.
+// This is inherited by the child when it's cloned, which then uses it in cgroup_enter.
+static char* leaf = NULL;
+
+// The environment variables that set limits on the leaf cgroup, and the files they're written to.
+static const char* limits[][2] = {
+    {"SANDBOX_MEMORY_MAX", "memory.max"},
+    {"SANDBOX_CPU_MAX", "cpu.max"},
+    {"SANDBOX_PIDS_MAX", "pids.max"},
+};
+
+// write_cgroup_file writes the given value into a file in the leaf cgroup.
+static int write_cgroup_file(const char* name, const char* value) {
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", leaf, name) >= (int)sizeof(path)) {
+        fprintf(stderr, "cgroup path %s/%s is too long\n", leaf, name);
+        return 1;
+    }
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "fopen %s: ", path);
+        perror("");
+        return 1;
+    }
+    if (fputs(value, f) < 0 || fclose(f) != 0) {
+        fprintf(stderr, "write %s to %s: ", value, path);
+        perror("");
+        return 1;
+    }
+    return 0;
+}
+
+// has_cgroup_kill returns true if the leaf supports cgroup.kill (which needs Linux >= 5.14).
+static bool has_cgroup_kill() {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/cgroup.kill", leaf);
+    return access(path, W_OK) == 0;
+}
+
+int cgroup_create() {
+    const char* parent = getenv("SANDBOX_CGROUP");
+    if (!parent || !*parent) {
+        return 0;
+    }
+    // We only ever start one child per process (the server forks a new handler for each),
+    // so our own pid is enough to keep leaves unique.
+    if (asprintf(&leaf, "%s/plz-%d", parent, getpid()) == -1) {
+        perror("asprintf");
+        leaf = NULL;
+        return 1;
+    }
+    if (mkdir(leaf, S_IRWXU) != 0 && errno != EEXIST) {
+        fprintf(stderr, "mkdir %s: ", leaf);
+        perror("");
+        free(leaf);
+        leaf = NULL;
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); ++i) {
+        const char* value = getenv(limits[i][0]);
+        if (value && *value && write_cgroup_file(limits[i][1], value) != 0) {
+            fputs("Check that the controller is enabled in cgroup.subtree_control of SANDBOX_CGROUP\n", stderr);
+            cgroup_remove();
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int cgroup_fd() {
+    if (!leaf) {
+        return -1;
+    }
+    const int fd = open(leaf, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        fprintf(stderr, "open %s: ", leaf);
+        perror("");
+    }
+    return fd;
+}
+
+int cgroup_enter() {
+    // Writing 0 moves the writing process, which saves needing any handshake with our parent.
+    return leaf ? write_cgroup_file("cgroup.procs", "0") : 0;
+}
+
+void cgroup_remove() {
+    if (!leaf) {
+        return;
+    }
+    // The leaf can't be removed while anything is still in it. Anything left behind by the child
+    // (which was the init of its pid namespace) is being killed by the kernel, but that can take a
+    // moment, so kill them explicitly and retry a few times.
+    const struct timespec delay = { .tv_sec = 0, .tv_nsec = 1000 * 1000 };
+    for (int i = 0; rmdir(leaf) != 0; ++i) {
+        if (errno != EBUSY || i >= 100) {
+            fprintf(stderr, "rmdir %s: ", leaf);
+            perror("");
+            break;
+        }
+        if (i == 0 && has_cgroup_kill()) {
+            write_cgroup_file("cgroup.kill", "1");
+        }
+        nanosleep(&delay, NULL);
+    }
+    free(leaf);
+    leaf = NULL;
+}
+
+#else  // __linux__
+
+int cgroup_create() {
+    return 0;
+}
+
+int cgroup_fd() {
+    return -1;
+}
+
+int cgroup_enter() {
+    return 0;
+}
+
+void cgroup_remove() {}
+
+#endif  // __linux__
@@ -1,5 +1,84 @@
-// lo_up brings up the loopback interface in the new network namespace.
-// By default the namespace is created with lo but it is down.
-// Note that this can't be done with system() because it loses the
-// required capabilities.
-int lo_up();
\ No newline at end of file
+#include <stdbool.h>
+#include <sys/types.h>
+
+// contain separates the process into new namespaces to sandbox it.
+// It should be passed the argv for the new process, and booleans indicating
+// whether it should move to new network and mount namespaces.
+// It returns an exit code (so 0 on success, nonzero on failure).
+int contain(char* argv[], bool net, bool mount);
+
+// spawn clones a new child into fresh namespaces which then execs the given argv.
+// If userns is false the caller must already be within a user namespace of its own
+// (e.g. from enter_userns), which the new child will share.
+// If mnt_template isn't -1, it's a descriptor for a mount namespace from mount_template which the
+// child starts from a copy of, rather than setting up its mounts from scratch. Likewise if net_ns
+// isn't -1, it's a network namespace from new_netns which the child moves into instead of a new one.
+// It returns the pid of the child, or -1 on failure. If the kernel supports it, pidfd is set
+// to a pidfd referring to the child (which the caller should close), otherwise it's set to -1.
+pid_t spawn(char* argv[], bool net, bool mount, bool userns, int mnt_template, int net_ns, int* pidfd);
+
+// mount_template moves the calling process into a new mount namespace with the parts of the
+// sandbox set up that are the same for every process: / is private and readonly, and the
+// directories in $SANDBOX_DIRS are hidden. Children given it by spawn then only have to mount
+// their own /tmp, build directory and /proc.
+// It returns a descriptor for the namespace, or -1 on failure (in which case the caller's mounts
+// may be partly set up, but that doesn't stop a new namespace being set up from them as usual).
+int mount_template();
+
+// new_netns moves the calling process into a new network namespace and brings up loopback in it.
+// It returns a descriptor for the namespace, or -1 on failure.
+int new_netns();
+
+// sandbox_exec sets up the sandbox within the current process and then execs the given argv.
+// The caller must already be within new namespaces (e.g. as set up by spawn, or by Please when
+// it runs `plz sandbox`); net and mount indicate whether the network and mount namespaces are new.
+// It only returns on failure, with a nonzero exit code.
+int sandbox_exec(char* argv[], bool net, bool mount);
+
+// enter_userns moves the calling process into a new user namespace, mapping its user and group
+// ids to the same ones inside it.
+// It returns an exit code (so 0 on success, nonzero on failure).
+int enter_userns();
+
+// cgroup_create creates a new leaf cgroup for the next child of this process, under the cgroup v2
+// directory named by $SANDBOX_CGROUP, and applies any limits given by $SANDBOX_MEMORY_MAX,
+// $SANDBOX_CPU_MAX and $SANDBOX_PIDS_MAX to it. It does nothing if $SANDBOX_CGROUP isn't set.
+// It returns an exit code (so 0 on success, nonzero on failure).
+int cgroup_create();
+
+// cgroup_fd returns a new descriptor for the leaf cgroup made by cgroup_create, or -1 if there
+// isn't one.
+int cgroup_fd();
+
+// cgroup_enter moves the calling process into the leaf cgroup made by its parent's cgroup_create.
+// It returns an exit code (so 0 on success, nonzero on failure).
+int cgroup_enter();
+
+// cgroup_remove removes the leaf cgroup made by cgroup_create, once the child has exited.
+void cgroup_remove();
+
+// serve runs a long-lived sandbox server listening on a Unix socket at the given path.
+// This amortises the cost of setting up the user namespace over many sandboxed processes;
+// each request on the socket starts one new process in its own set of namespaces. Their mount
+// namespaces are copied from templates (see mount_template) kept for each value of $SANDBOX_DIRS,
+// and their network namespaces are taken from a pool made in advance by other processes.
+// It only returns on failure, with a nonzero exit code.
+int serve(const char* socket_path);
+
+// exec_name returns the name of the new binary to exec() as.
+// old_name is the current name; if it's within old_dir it will be re-prefixed to new_dir.
+char* exec_name(const char* old_name, const char* old_dir, const char* new_dir);
+
+// change_path takes a string or environment variable and changes a prefix from one path to another.
+// For example:
+//   old_name:   RESULTS_FILE=/home/peter/git/please/plz-out/tmp/my_test/test.results
+//   old_dir:    /home/peter/git/please/plz-out/tmp/my_test
+//   new_dir:    /tmp/plz_sandbox
+//   prefix_len: 13
+// Result:       RESULTS_FILE=/tmp/plz_sandbox/test.results
+char* change_path(const char* old_name, const char* old_dir, const char* new_dir, int prefix_len);
+
+// change_env_vars changes any environment variables prefixed with the old directory to the new one.
+// The variables are changed in-place within the given array; if new_dir is no longer than
+// old_dir the strings themselves are rewritten, so they must be writable.
+void change_env_vars(char** environ, const char* old_dir, const char* new_dir);
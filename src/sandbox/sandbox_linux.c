@@ -1,14 +1,33 @@
+#define _GNU_SOURCE
 #include "sandbox.h"
 
-#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
 #include <net/if.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
-
+// lo_up brings up the loopback interface in the new network namespace.
+// By default the namespace is created with lo but it is down.
+// Note that this can't be done with system() because it loses the
+// required capabilities.
 int lo_up() {
     const int sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock < 0) {
@@ -33,3 +52,610 @@ int lo_up() {
     return 0;
 }
 
+// deny_groups disables the ability to call setgroups(2). This is required
+// before we can successfully write to gid_map in map_ids.
+int deny_groups() {
+    FILE* f = fopen("/proc/self/setgroups", "w");
+    if (!f) {
+        perror("fopen /proc/self/setgroups");
+        return 1;
+    }
+    if (fputs("deny\n", f) < 0) {
+        perror("fputs");
+        return 1;
+    }
+    return fclose(f);
+}
+
+// map_ids maps the user id or group id inside the namespace to those outside.
+// Without this we fail to create directories in the tmpfs with an EOVERFLOW.
+int map_ids(int out_id, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        perror("fopen");
+        return 1;
+    }
+    if (fprintf(f, "%d %d 1\n", out_id, out_id) < 0) {
+        perror("fprintf");
+        return 1;
+    }
+    if (fclose(f) != 0) {
+        perror("fclose");
+        return 1;
+    }
+    return 0;
+}
+
+// mount_overlay mounts an overlayfs at the given location, with the given colon-separated lower
+// directories underneath the build directory dir (which becomes the writable upper directory).
+// This makes the contents of the lower directories visible within the build directory without
+// having to link them all into it first. The overlay's work directory is created alongside dir.
+int mount_overlay(const char* lower, const char* dir, const char* target) {
+    int ret = 1;
+    char* opts = NULL;
+    char* work = malloc(strlen(dir) + 6);
+    if (!work) {
+        perror("malloc");
+        return 1;
+    }
+    strcpy(work, dir);
+    strcat(work, ".work");
+    if (mkdir(work, S_IRWXU) != 0 && errno != EEXIST) {
+        perror("mkdir overlay workdir");
+        goto out;
+    }
+    const char* format = "lowerdir=%s,upperdir=%s,workdir=%s";
+    const int len = snprintf(NULL, 0, format, lower, dir, work) + 1;
+    opts = malloc(len);
+    if (!opts) {
+        perror("malloc");
+        goto out;
+    }
+    snprintf(opts, len, format, lower, dir, work);
+    if (mount("overlay", target, "overlay", MS_NODEV | MS_NOSUID, opts) != 0) {
+        perror("mount overlay");
+        fputs("SANDBOX_OVERLAY requires overlayfs support in user namespaces (usually >= Linux 5.11)\n", stderr);
+        goto out;
+    }
+    ret = 0;
+out:
+    free(opts);
+    free(work);
+    return ret;
+}
+
+// mask_dirs mounts a readonly tmpfs over each of the given comma-separated directories in order to hide them.
+// If one or more directories don't exist, that is OK, but any other error is fatal.
+static int mask_dirs(const char* dirs, int flags) {
+    char* copy = strdup(dirs);
+    if (!copy) {
+        perror("strdup");
+        return 1;
+    }
+    for (char* token = strtok(copy, ","); token; token = strtok(NULL, ",")) {
+        if (mount("tmpfs", token, "tmpfs", flags | MS_RDONLY, NULL) != 0) {
+            if (errno == ENOTDIR) {
+                // This isn't fatal, it's OK for them not to exist (in that case we just have nothing to sandbox).
+                fprintf(stderr, "Not mounting over %s since it isn't a directory\n", token);
+            } else {
+                perror("mount tmpfs");
+                free(copy);
+                return 1;
+            }
+        }
+    }
+    free(copy);
+    return 0;
+}
+
+// mount_writable makes a bind mount of something on the readonly root of a template writable again.
+// Its other flags have to be kept as they are, since they can't be changed within a user namespace;
+// the ST_ flags from statvfs have the same values as the corresponding MS_ ones.
+static int mount_writable(const char* dir) {
+    struct statvfs st;
+    if (statvfs(dir, &st) != 0) {
+        perror("statvfs");
+        return 1;
+    }
+    if (!(st.f_flag & ST_RDONLY)) {
+        return 0;
+    }
+    const unsigned long kept = st.f_flag & (ST_NOSUID | ST_NODEV | ST_NOEXEC | ST_NOATIME | ST_NODIRATIME | ST_RELATIME);
+    if (mount("none", dir, NULL, MS_REMOUNT | MS_BIND | kept, NULL) != 0) {
+        perror("remount rw");
+        return 1;
+    }
+    return 0;
+}
+
+int mount_template() {
+    if (unshare(CLONE_NEWNS) != 0) {
+        perror("unshare");
+        return -1;
+    }
+    if (mount("none", "/", NULL, MS_REC | MS_PRIVATE, NULL) != 0) {
+        perror("remount");
+        return -1;
+    }
+    const char* dirs = getenv("SANDBOX_DIRS");
+    if (dirs && mask_dirs(dirs, MS_LAZYTIME | MS_NOATIME | MS_NODEV | MS_NOSUID) != 0) {
+        return -1;
+    }
+    if (mount("none", "/", NULL, MS_REMOUNT | MS_RDONLY | MS_BIND, NULL) != 0) {
+        perror("remount ro");
+        return -1;
+    }
+    const int fd = open("/proc/self/ns/mnt", O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        perror("open /proc/self/ns/mnt");
+    }
+    return fd;
+}
+
+int new_netns() {
+    if (unshare(CLONE_NEWNET) != 0) {
+        perror("unshare");
+        return -1;
+    }
+    if (lo_up() != 0) {
+        return -1;
+    }
+    const int fd = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        perror("open /proc/self/ns/net");
+    }
+    return fd;
+}
+
+// mount_tmp mounts a tmpfs on /tmp for the tests to muck about in and
+// bind mounts the test directory to /tmp/plz_sandbox.
+// If the given string pointer (the argv[0] of the new process) is within the old temp dir
+// then it will be replaced with a new version pointing into the new sandbox dir.
+// If templated is true, the process is in a copy of a namespace from mount_template, so / is
+// already private and readonly and the SANDBOX_DIRS are already hidden.
+int mount_tmp(char** argv0, bool templated) {
+    // Don't mount on /tmp if our tmp dir is under there, otherwise we won't be able to see it.
+    // This is copied since it points into environ, whose variables are rewritten below.
+    // It's never freed; we're about to exec anyway.
+    const char* dir = getenv("TMP_DIR");
+    const char* d = "/tmp/plz_sandbox";
+    if (dir) {
+        dir = strdup(dir);
+        if (strncmp(dir, "/tmp/", 5) == 0) {
+            fputs("Not mounting tmpfs on /tmp since TMP_DIR is a subdir\n", stderr);
+            return 0;
+        }
+    }
+    // Remounting / as private is necessary so that the tmpfs mount isn't visible to anyone else.
+    if (!templated && mount("none", "/", NULL, MS_REC | MS_PRIVATE, NULL) != 0) {
+        perror("remount");
+        return 1;
+    }
+    // SANDBOX_TMPFS optionally gives mount options for the tmpfs (e.g. size=1G,nr_inodes=1M), or
+    // can be "none" for actions that don't need any scratch space outside their own directory.
+    // In that case the tmpfs is only big enough to hold the mountpoint for it, and is made
+    // readonly after that's done; TMPDIR points to the sandbox dir instead.
+    const char* tmpfs_opts = getenv("SANDBOX_TMPFS");
+    const bool scratch = !tmpfs_opts || strcmp(tmpfs_opts, "none") != 0;
+    if (!scratch) {
+        tmpfs_opts = "size=4k,nr_inodes=16";
+    } else if (tmpfs_opts && !*tmpfs_opts) {
+        tmpfs_opts = NULL;
+    }
+    const int flags = MS_LAZYTIME | MS_NOATIME | MS_NODEV | MS_NOSUID;
+    if (mount("tmpfs", "/tmp", "tmpfs", flags, tmpfs_opts) != 0) {
+        perror("mount");
+        return 1;
+    }
+    unsetenv("SANDBOX_TMPFS");
+    if (setenv("TMPDIR", "/tmp", 1) != 0) {
+        perror("setenv");
+        return 1;
+    }
+    // If SANDBOX_DIRS is set, we expect a comma-separated list of directories to mount a tmpfs over in order to hide them.
+    // If one or more directories don't exist, that is OK, but any other error is fatal.
+    const char* dirs = getenv("SANDBOX_DIRS");
+    if (dirs != NULL) {
+      if (!templated && mask_dirs(dirs, flags) != 0) {
+        return 1;
+      }
+      // Remove the env var; downstream things don't need to know what these were.
+      unsetenv("SANDBOX_DIRS");
+    }
+    if (!dir) {
+        fputs("TMP_DIR not set, will not bind-mount to /tmp/plz_sandbox\n", stderr);
+        return 0;
+    }
+    if (mkdir(d, S_IRWXU) != 0) {
+        perror("mkdir /tmp/plz_sandbox");
+        return 1;
+    }
+    const char* overlay = getenv("SANDBOX_OVERLAY");
+    if (overlay && *overlay) {
+        if (mount_overlay(overlay, dir, d) != 0) {
+            return 1;
+        }
+        unsetenv("SANDBOX_OVERLAY");
+    } else if (mount(dir, d, "", MS_BIND, NULL) != 0) {
+        perror("bind mount");
+        return 1;
+    } else if (templated && mount_writable(d) != 0) {
+        return 1;
+    }
+    if (!scratch) {
+        if (mount("none", "/tmp", NULL, MS_REMOUNT | MS_RDONLY | flags, NULL) != 0) {
+            perror("remount /tmp ro");
+            return 1;
+        } else if (setenv("TMPDIR", d, 1) != 0) {
+            perror("setenv");
+            return 1;
+        }
+    }
+    change_env_vars(environ, dir, d);
+    if (setenv("TEST_DIR", d, 1) != 0 ||
+        setenv("TMP_DIR", d, 1) != 0 ||
+        setenv("HOME", d, 1) != 0) {
+        perror("setenv");
+        return 1;
+    }
+    // Now make root readonly (once we have bind-mounted in the non-readonly workdir)
+    if (!templated && mount("none", "/", NULL, MS_REMOUNT | MS_RDONLY | MS_BIND, NULL) != 0) {
+        perror("remount ro");
+        return 1;
+    }
+    *argv0 = exec_name(*argv0, dir, d);
+    return chdir(d);
+}
+
+// mount_tmpfs mounts an empty tmpfs at the given location.
+int mount_tmpfs(const char* dir) {
+    const int flags = MS_LAZYTIME | MS_NOATIME | MS_NODEV | MS_NOSUID | MS_NOEXEC;
+    if (mount("tmpfs", dir, "tmpfs", flags, NULL) != 0) {
+        perror("mount tmpfs");
+        return 1;
+    }
+    return 0;
+}
+
+// mount_proc mounts a new procfs on /proc
+int mount_proc() {
+  if (mount("proc", "/proc", "proc", 0, NULL) != 0) {
+    perror("mount proc");
+    return 1;
+  }
+  return 0;
+}
+
+typedef struct _clone_arg {
+  uid_t uid;
+  uid_t gid;
+  bool  net;
+  bool  mount;
+  bool  userns;
+  bool  in_cgroup;
+  int   mnt_template;
+  int   net_ns;
+  char** argv;
+} clone_arg;
+
+static int exec_sandboxed(char* argv[], bool net, bool mount, bool templated);
+
+// contain_child is the entrypoint for the child process.
+int contain_child(void* p) {
+  clone_arg* arg = p;
+  if (arg->userns) {
+    if (deny_groups() != 0) {
+      return 1;
+    }
+    if (map_ids(arg->uid, "/proc/self/uid_map") != 0 ||
+        map_ids(arg->gid, "/proc/self/gid_map") != 0) {
+      return 1;
+    }
+  }
+  // This has to happen after the id mapping, otherwise we don't have permission to move ourselves.
+  if (!arg->in_cgroup && cgroup_enter() != 0) {
+    return 1;
+  }
+  if (prctl(PR_SET_PDEATHSIG, SIGKILL) == -1) {
+    perror("failed to set PDEATHSIG");
+    return 1;
+  }
+  if (arg->mnt_template != -1) {
+    // We weren't cloned into a new mount namespace; start from a copy of the template instead.
+    if (setns(arg->mnt_template, CLONE_NEWNS) != 0) {
+      perror("setns");
+      return 1;
+    } else if (unshare(CLONE_NEWNS) != 0) {
+      perror("unshare");
+      return 1;
+    }
+    close(arg->mnt_template);
+  }
+  if (arg->net_ns != -1) {
+    // Similarly, this one already has loopback up.
+    if (setns(arg->net_ns, CLONE_NEWNET) != 0) {
+      perror("setns");
+      return 1;
+    }
+    close(arg->net_ns);
+  }
+  return exec_sandboxed(arg->argv, arg->net && arg->net_ns == -1, arg->mount, arg->mnt_template != -1);
+}
+
+int sandbox_exec(char* argv[], bool net, bool mount) {
+  return exec_sandboxed(argv, net, mount, false);
+}
+
+static int exec_sandboxed(char* argv[], bool net, bool mount, bool templated) {
+  if (mount) {
+    if (mount_tmp(&argv[0], templated) != 0) {
+      return 1;
+    }
+    if (mount_proc() != 0) {
+      return 1;
+    }
+  }
+  if (net) {
+    if (lo_up() != 0) {
+      return 1;
+    }
+  }
+  // Don't leak any signal mask our parent had set up into the new process.
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigprocmask(SIG_SETMASK, &mask, NULL);
+  execvp(argv[0], argv);  // If this returns, an error has occurred.
+  fprintf(stderr, "exec %s: ", argv[0]);
+  perror("");
+  return 1;
+}
+
+// Our own definition of struct clone_args from linux/sched.h, which can't be included alongside
+// sched.h on many systems.
+struct clone3_args {
+  uint64_t flags;
+  uint64_t pidfd;
+  uint64_t child_tid;
+  uint64_t parent_tid;
+  uint64_t exit_signal;
+  uint64_t stack;
+  uint64_t stack_size;
+  uint64_t tls;
+  uint64_t set_tid;
+  uint64_t set_tid_size;
+  uint64_t cgroup;
+};
+
+#ifndef SYS_clone3
+#define SYS_clone3 435  // This is the same on all architectures.
+#endif
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x1000
+#endif
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL
+#endif
+#ifndef CLONE_ARGS_SIZE_VER0
+#define CLONE_ARGS_SIZE_VER0 64  // The size of clone_args before set_tid & cgroup were added.
+#endif
+
+// spawn_clone3 starts the child with clone3(2), which behaves like fork (so doesn't need a new
+// stack), gives us a pidfd for it and can start it directly in its cgroup (Linux >= 5.7).
+// It returns -1 with errno set to ENOSYS if clone3 isn't available, or E2BIG / EINVAL if it
+// doesn't support what we asked of it.
+static pid_t spawn_clone3(clone_arg* arg, int ns, int* pidfd) {
+  const int cgroup = cgroup_fd();
+  struct clone3_args args;
+  memset(&args, 0, sizeof(args));
+  args.flags = ns | CLONE_PIDFD | (cgroup != -1 ? CLONE_INTO_CGROUP : 0);
+  args.pidfd = (uint64_t)(uintptr_t)pidfd;
+  args.exit_signal = SIGCHLD;
+  args.cgroup = cgroup;
+  arg->in_cgroup = cgroup != -1;  // Must be set before the child gets its copy of it.
+  pid_t pid = syscall(SYS_clone3, &args, sizeof(args));
+  if (pid == -1 && cgroup != -1 && (errno == E2BIG || errno == EINVAL)) {
+    // Kernel is too old for CLONE_INTO_CGROUP (5.3 - 5.6); the child can still move itself.
+    // Those kernels don't know about the fields after tls either, so we don't pass them.
+    args.flags &= ~CLONE_INTO_CGROUP;
+    args.cgroup = 0;
+    arg->in_cgroup = false;
+    pid = syscall(SYS_clone3, &args, CLONE_ARGS_SIZE_VER0);
+  }
+  if (pid == 0) {
+    _exit(contain_child(arg));
+  }
+  if (cgroup != -1) {
+    close(cgroup);
+  }
+  return pid;
+}
+
+// spawn clones a new child into fresh namespaces which then execs the given argv.
+pid_t spawn(char* argv[], bool net, bool mount, bool userns, int mnt_template, int net_ns, int* pidfd) {
+  clone_arg arg;
+  arg.uid = getuid();
+  arg.gid = getgid();
+  arg.argv = argv;
+  arg.net = net;
+  arg.mount = mount;
+  arg.userns = userns;
+  arg.in_cgroup = false;
+  arg.mnt_template = mount ? mnt_template : -1;
+  arg.net_ns = net ? net_ns : -1;
+  *pidfd = -1;
+
+  if (cgroup_create() != 0) {
+    return -1;
+  }
+  const int ns = (userns ? CLONE_NEWUSER : 0) | CLONE_NEWUTS | CLONE_NEWIPC | CLONE_NEWPID | (net && arg.net_ns == -1 ? CLONE_NEWNET : 0) | (mount && arg.mnt_template == -1 ? CLONE_NEWNS : 0);
+  pid_t pid = spawn_clone3(&arg, ns, pidfd);
+  if (pid == -1 && (errno == ENOSYS || errno == E2BIG || errno == EINVAL)) {
+    // Fall back to plain clone for kernels older than 5.3, or ones whose clone3 won't do what we want.
+    *pidfd = -1;
+    arg.in_cgroup = false;
+    static const int stack_size = 100 * 1024;
+    char* stack = mmap(NULL, stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+      perror("mmap");
+      cgroup_remove();
+      return -1;
+    }
+    pid = clone(contain_child, stack + stack_size, ns | SIGCHLD, &arg);
+    // The child has its own copy of the stack now (we don't share memory with it).
+    const int err = errno;
+    munmap(stack, stack_size);
+    errno = err;
+  }
+  if (pid == -1) {
+    perror("clone");
+    fputs("Your user doesn't seem to have enough permissions to call clone(2).\n", stderr);
+    fputs("please_sandbox requires support for user namespaces (usually >= Linux 3.10)\n", stderr);
+    cgroup_remove();
+  }
+  return pid;
+}
+
+// enter_userns moves the calling process into a new user namespace, mapping its user and group
+// ids to the same ones inside it. Children of this process can then be namespaced further
+// without having to set up their own user namespace each time.
+int enter_userns() {
+  const uid_t uid = getuid();
+  const gid_t gid = getgid();
+  if (unshare(CLONE_NEWUSER) != 0) {
+    perror("unshare");
+    return 1;
+  }
+  if (deny_groups() != 0) {
+    return 1;
+  }
+  if (map_ids(uid, "/proc/self/uid_map") != 0 ||
+      map_ids(gid, "/proc/self/gid_map") != 0) {
+    return 1;
+  }
+  return 0;
+}
+
+// contain separates the process into new namespaces to sandbox it.
+int contain(char* argv[], bool net, bool mount) {
+  int pidfd;
+  pid_t pid = spawn(argv, net, mount, true, -1, -1, &pidfd);
+  if (pid == -1) {
+    return 1;
+  }
+  if (pidfd != -1) {
+    close(pidfd);  // We've nothing else to do in the meantime, so may as well just wait for it.
+  }
+  // We're the parent process; wait on the child and exit with its status.
+  int status = 0;
+  if (waitpid(pid, &status, 0) == -1) {
+    perror("waitpid failed");
+  }
+  cgroup_remove();
+  if (WIFEXITED(status)) {
+    return WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    kill(getpid(), WTERMSIG(status));
+  }
+  fprintf(stderr, "child exit failed\n");
+  return 1;
+}
+
+#else  // __linux__
+
+// On non-Linux systems contain simply execs a subprocess.
+// It's not really expected to be used there, this is simply to make it compile.
+int contain(char* argv[], bool net, bool mount) {
+  return execvp(argv[0], argv);
+}
+
+int sandbox_exec(char* argv[], bool net, bool mount) {
+  return execvp(argv[0], argv);
+}
+
+#endif  // __linux__
+
+// exec_name returns the name of the new binary to exec() as.
+// old_name is the current name; if it's within old_dir it will be re-prefixed to new_dir.
+char* exec_name(const char* old_name, const char* old_dir, const char* new_dir) {
+  return change_path(old_name, old_dir, new_dir, 0);
+}
+
+// change_path takes a string or environment variable and changes a prefix from one path to another.
+char* change_path(const char* old_name, const char* old_dir, const char* new_dir, int prefix_len) {
+  const int new_dir_len = strlen(new_dir);
+  const int old_dir_len = strlen(old_dir);
+  const int old_name_len = strlen(old_name);
+  if (strncmp(old_dir, old_name + prefix_len, old_dir_len) != 0) {  // is the value of old_name prefixed with old_dir
+    return (char*)old_name;  // Dodgy cast but we know we don't alter it again later.
+  }
+  const int new_len = new_dir_len + old_name_len - old_dir_len + 1;
+  char* new_name = malloc(new_len + 1);
+  strncpy(new_name, old_name, prefix_len);
+  strcpy(new_name + prefix_len, new_dir);
+  strcpy(new_name + prefix_len + new_dir_len, old_name + prefix_len + old_dir_len);
+  new_name[new_len] = 0;
+  return new_name;
+}
+
+// prefixed_value returns a pointer to the value of the given environment variable if it begins
+// with the given directory, or NULL if it doesn't.
+static char* prefixed_value(char* var, const char* dir, size_t dir_len) {
+  char* equals = strchr(var, '=');
+  if (equals && strncmp(equals + 1, dir, dir_len) == 0) {
+    return equals + 1;
+  }
+  return NULL;
+}
+
+// change_env_vars changes any environment variables prefixed with the old directory to the new one.
+// This runs for every sandboxed action over environments that can be quite large, so tries to be
+// efficient; when the new directory is no longer than the old one (which is the usual case) the
+// variables are rewritten in place, otherwise all the changed ones share a single allocation.
+// old_dir may point into one of the variables itself (e.g. if it came from getenv("TMP_DIR")), so
+// it's copied first.
+void change_env_vars(char** environ, const char* old_dir, const char* new_dir) {
+  const size_t old_len = strlen(old_dir);
+  const size_t new_len = strlen(new_dir);
+  char old_copy[old_len + 1];
+  memcpy(old_copy, old_dir, old_len + 1);
+  old_dir = old_copy;
+  if (new_len <= old_len) {
+    for (char** env = environ; *env; ++env) {
+      char* value = prefixed_value(*env, old_dir, old_len);
+      if (value) {
+        memcpy(value, new_dir, new_len);
+        if (new_len != old_len) {
+          memmove(value + new_len, value + old_len, strlen(value + old_len) + 1);
+        }
+      }
+    }
+    return;
+  }
+  // First work out how much space we need for all the changed variables.
+  size_t size = 0;
+  for (char** env = environ; *env; ++env) {
+    if (prefixed_value(*env, old_dir, old_len)) {
+      size += strlen(*env) - old_len + new_len + 1;
+    }
+  }
+  if (size == 0) {
+    return;
+  }
+  char* arena = malloc(size);
+  if (!arena) {
+    perror("malloc");
+    return;
+  }
+  for (char** env = environ; *env; ++env) {
+    const char* value = prefixed_value(*env, old_dir, old_len);
+    if (value) {
+      const size_t key_len = value - *env;
+      const size_t rest_len = strlen(value + old_len) + 1;
+      memcpy(arena, *env, key_len);
+      memcpy(arena + key_len, new_dir, new_len);
+      memcpy(arena + key_len + new_len, value + old_len, rest_len);
+      *env = arena;
+      arena += key_len + new_len + rest_len;
+    }
+  }
+}
@@ -0,0 +1,490 @@
+#define _GNU_SOURCE
+#include "sandbox.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+// The protocol on the socket is deliberately very simple. Each connection runs exactly one process.
+// The client sends a fixed-size header, with its stdin, stdout and stderr attached as SCM_RIGHTS:
+//   uint32 length of the payload following the header
+//   uint32 flags (a combination of the REQUEST_* values below)
+//   uint32 number of arguments
+// followed by the payload, which is a series of nul-terminated strings: first the working
+// directory, then the arguments, and then any remaining strings are the environment.
+// While the process runs the client may send a uint32 signal number to deliver to it; closing
+// the connection kills it. When it exits the server replies with its uint32 wait status, followed
+// by three uint64s describing its resource usage: user and system CPU time in microseconds, and
+// its peak resident set size in bytes. All integers are in network byte order.
+#define REQUEST_NET 1
+#define REQUEST_MOUNT 2
+#define HEADER_SIZE 12
+#define MAX_PAYLOAD (64 * 1024 * 1024)
+
+// Templates for the mount namespaces of new processes, keyed by the value of SANDBOX_DIRS they were
+// made with (see mount_template). Handlers make them as needed and send them back to the server on
+// a socket, so each handler has all the ones that existed when it was forked.
+#define MAX_TEMPLATES 16
+#define MAX_TEMPLATE_KEY 4096
+static char* template_keys[MAX_TEMPLATES];
+static int template_fds[MAX_TEMPLATES];
+static int num_templates = 0;
+
+// A pool of network namespaces with loopback already up, each of which is given to one handler.
+// Making them serialises in the kernel, so they're made ahead of time by separate processes rather
+// than as each process is started. They aren't reused; whatever one process leaves behind in its
+// namespace (sockets in TIME_WAIT, routes etc.) isn't meant to be visible to the next.
+#define NET_POOL_SIZE 8
+static int net_pool[NET_POOL_SIZE];
+static int num_net = 0;
+static int net_pending = 0;  // Number of processes currently making one for the pool.
+static bool net_failed = false;  // Set if one of them failed, after which we don't try again.
+
+// Kinds of namespace that are sent to the server on its namespace socket.
+#define NS_MOUNT_TEMPLATE 'm'
+#define NS_NET 'n'
+#define NS_NET_UNUSED 'u'  // One from the pool that a handler didn't need after all.
+
+// read_full reads exactly n bytes from the given fd.
+static int read_full(int fd, char* buf, size_t n) {
+    while (n > 0) {
+        const ssize_t r = read(fd, buf, n);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        } else if (r <= 0) {
+            return 1;
+        }
+        buf += r;
+        n -= r;
+    }
+    return 0;
+}
+
+// recv_header receives the request header and the three stdio descriptors that accompany it.
+static int recv_header(int conn, uint32_t header[3], int fds[3]) {
+    char buf[HEADER_SIZE];
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = { .iov_base = buf, .iov_len = HEADER_SIZE };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    const ssize_t n = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0) {
+        perror("recvmsg");
+        return 1;
+    } else if (n == 0) {
+        return 1;  // Client disconnected without sending anything (e.g. checking we are listening)
+    }
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        fputs("sandbox request did not include stdio descriptors\n", stderr);
+        return 1;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+    if (n < HEADER_SIZE && read_full(conn, buf + n, HEADER_SIZE - n) != 0) {
+        fputs("short sandbox request header\n", stderr);
+        return 1;
+    }
+    for (int i = 0; i < 3; ++i) {
+        uint32_t x;
+        memcpy(&x, buf + i * sizeof(uint32_t), sizeof(uint32_t));
+        header[i] = ntohl(x);
+    }
+    return 0;
+}
+
+// split_payload breaks the payload up into the working directory, argv and environment.
+// The returned arrays point into the payload buffer.
+static int split_payload(char* payload, uint32_t len, uint32_t argc, char** dir, char*** argv, char*** env) {
+    if (len == 0 || payload[len - 1] != 0) {
+        fputs("malformed sandbox request\n", stderr);
+        return 1;
+    }
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < len; ++i) {
+        n += payload[i] == 0;
+    }
+    if (argc == 0 || n < argc + 1) {
+        fputs("sandbox request has too few arguments\n", stderr);
+        return 1;
+    }
+    char** strs = calloc(n + 2, sizeof(char*));  // Room for a terminating null after both argv and env.
+    if (!strs) {
+        perror("calloc");
+        return 1;
+    }
+    char* s = payload;
+    for (uint32_t i = 0; i < n; ++i) {
+        // The working directory is the first string, argv follows and then env (after argv's null).
+        strs[i < argc + 1 ? i : i + 1] = s;
+        s += strlen(s) + 1;
+    }
+    *dir = strs[0];
+    *argv = strs + 1;
+    *env = strs + argc + 2;
+    return 0;
+}
+
+// wait_child waits for the given child to exit, relaying any signals from the client to it.
+// fd is either a pidfd for the child, or a signalfd receiving SIGCHLD if is_pidfd is false.
+// The child's resource usage is stored in ru.
+static int wait_child(int conn, int fd, bool is_pidfd, pid_t pid, struct rusage* ru) {
+    struct pollfd fds[2] = {
+        { .fd = fd, .events = POLLIN },
+        { .fd = conn, .events = POLLIN | POLLRDHUP },
+    };
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // We can't tell when the child exits any more, so kill it and reap it directly.
+            perror("poll");
+            kill(pid, SIGKILL);
+            int status = 0;
+            if (wait4(pid, &status, 0, ru) < 0) {
+                perror("waitpid failed");
+                return 0xff00;
+            }
+            return status;
+        }
+        if (fds[0].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (!is_pidfd && read(fd, &info, sizeof(info)) < 0) {
+                perror("read signalfd");
+            }
+            int status = 0;
+            const pid_t r = wait4(pid, &status, WNOHANG, ru);
+            if (r == pid) {
+                return status;
+            } else if (r < 0) {
+                perror("waitpid failed");
+                return 0xff00;  // Looks like an exit code of 255
+            }
+        }
+        if (fds[1].revents) {
+            uint32_t sig;
+            if ((fds[1].revents & (POLLRDHUP | POLLHUP | POLLERR)) || read_full(conn, (char*)&sig, sizeof(sig)) != 0) {
+                // Client has gone away, there's nobody left who cares about this process.
+                kill(pid, SIGKILL);
+                fds[1].fd = -1;  // poll ignores negative descriptors
+            } else {
+                kill(pid, ntohl(sig));
+            }
+        }
+    }
+}
+
+// write_result writes the exit status and resource usage of the child back to the client.
+static void write_result(int conn, int status, const struct rusage* ru) {
+    char buf[4 + 3 * 8];
+    const uint32_t s = htonl(status);
+    const uint64_t usage[3] = {
+        htobe64(ru->ru_utime.tv_sec * 1000000ULL + ru->ru_utime.tv_usec),
+        htobe64(ru->ru_stime.tv_sec * 1000000ULL + ru->ru_stime.tv_usec),
+        htobe64(ru->ru_maxrss * 1024ULL),  // Linux reports this in kilobytes
+    };
+    memcpy(buf, &s, sizeof(s));
+    memcpy(buf + sizeof(s), usage, sizeof(usage));
+    if (write(conn, buf, sizeof(buf)) != sizeof(buf)) {
+        perror("write");
+    }
+}
+
+// send_namespace sends a namespace of the given kind to the server, keyed by the given string.
+// If fd is -1, the message is sent without one, indicating that it couldn't be made.
+static void send_namespace(int ns_sock, char kind, const char* key, int fd) {
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov[2] = {
+        { .iov_base = &kind, .iov_len = 1 },
+        { .iov_base = (char*)key, .iov_len = strlen(key) + 1 },
+    };
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = 2,
+        .msg_control = fd != -1 ? control : NULL,
+        .msg_controllen = fd != -1 ? sizeof(control) : 0,
+    };
+    if (fd != -1) {
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    if (sendmsg(ns_sock, &msg, 0) < 0) {
+        perror("sendmsg");
+    }
+}
+
+// keep_template keeps a template from a handler for later ones.
+static void keep_template(const char* key, int fd) {
+    // Two handlers can make the same one at once; we only need to keep one of them.
+    bool keep = num_templates < MAX_TEMPLATES;
+    for (int i = 0; i < num_templates && keep; ++i) {
+        keep = strcmp(template_keys[i], key) != 0;
+    }
+    char* k = keep ? strdup(key) : NULL;
+    if (!k) {
+        close(fd);
+        return;
+    }
+    template_keys[num_templates] = k;
+    template_fds[num_templates++] = fd;
+}
+
+// recv_namespace receives a namespace from one of the server's children and keeps it.
+static void recv_namespace(int ns_sock) {
+    char buf[1 + MAX_TEMPLATE_KEY];
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    const ssize_t n = recvmsg(ns_sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 2) {
+        perror("recvmsg");
+        return;
+    }
+    buf[n - 1] = 0;
+    int fd = -1;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    if (buf[0] == NS_NET) {
+        --net_pending;
+        net_failed = net_failed || fd == -1;
+    }
+    if (fd == -1) {
+        return;
+    } else if (buf[0] == NS_MOUNT_TEMPLATE) {
+        keep_template(buf + 1, fd);
+    } else if (num_net < NET_POOL_SIZE) {
+        net_pool[num_net++] = fd;
+    } else {
+        close(fd);
+    }
+}
+
+// fill_net_pool starts processes to make network namespaces for the pool until there are enough,
+// counting the ones that are already being made.
+static void fill_net_pool(int ns_sock) {
+    for (; !net_failed && num_net + net_pending < NET_POOL_SIZE; ++net_pending) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            send_namespace(ns_sock, NS_NET, "", new_netns());
+            exit(0);
+        } else if (pid == -1) {
+            perror("fork");
+            return;
+        }
+    }
+}
+
+// template_for returns a descriptor for the mount namespace a new process should start from a copy
+// of, or -1 if it should set up its mounts from scratch. If there isn't one yet for the current
+// environment, it's made now (in the calling handler) and sent back to the server too.
+static int template_for(int ns_sock) {
+    // Nothing is mounted if TMP_DIR is under /tmp (see mount_tmp), so there's nothing to save.
+    const char* dir = getenv("TMP_DIR");
+    if (!dir || strncmp(dir, "/tmp/", 5) == 0) {
+        return -1;
+    }
+    // An overlay has to create its work directory and write to its upper one, the build directory,
+    // neither of which is possible under the template's readonly root.
+    const char* overlay = getenv("SANDBOX_OVERLAY");
+    if (overlay && *overlay) {
+        return -1;
+    }
+    const char* key = getenv("SANDBOX_DIRS");
+    if (!key) {
+        key = "";
+    } else if (strlen(key) >= MAX_TEMPLATE_KEY) {
+        return -1;
+    }
+    for (int i = 0; i < num_templates; ++i) {
+        if (strcmp(template_keys[i], key) == 0) {
+            return template_fds[i];
+        }
+    }
+    const int fd = mount_template();
+    if (fd != -1) {
+        send_namespace(ns_sock, NS_MOUNT_TEMPLATE, key, fd);
+    }
+    return fd;
+}
+
+// handle handles a single request. It's called in a forked child of the server and never returns.
+// net_ns is a network namespace from the pool for the new process, or -1 if there wasn't one.
+static void handle(int conn, int ns_sock, int net_ns) {
+    uint32_t header[3];
+    int fds[3];
+    if (recv_header(conn, header, fds) != 0) {
+        exit(1);
+    }
+    const uint32_t len = header[0], flags = header[1], argc = header[2];
+    if (len > MAX_PAYLOAD) {
+        fprintf(stderr, "sandbox request too large (%u bytes)\n", len);
+        exit(1);
+    }
+    char* payload = malloc(len);
+    if (!payload) {
+        perror("malloc");
+        exit(1);
+    }
+    char* dir;
+    char** argv;
+    char** env;
+    if (read_full(conn, payload, len) != 0 || split_payload(payload, len, argc, &dir, &argv, &env) != 0) {
+        exit(1);
+    }
+    // Set up the process state that the new child will inherit.
+    for (int i = 0; i < 3; ++i) {
+        if (dup2(fds[i], i) == -1) {
+            perror("dup2");
+            exit(1);
+        }
+        close(fds[i]);
+    }
+    if (*dir && chdir(dir) != 0) {
+        perror("chdir");
+        exit(1);
+    }
+    environ = env;
+    // Block SIGCHLD so we can receive it through the signalfd; spawn restores the mask in the child.
+    // We only need that if the kernel can't give us a pidfd, but have to set it up before we know.
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    const int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+    if (sfd == -1) {
+        perror("signalfd");
+        exit(1);
+    }
+    const int mnt_template = (flags & REQUEST_MOUNT) ? template_for(ns_sock) : -1;
+    if (net_ns != -1 && !(flags & REQUEST_NET)) {
+        send_namespace(ns_sock, NS_NET_UNUSED, "", net_ns);
+    }
+    int pidfd;
+    const pid_t pid = spawn(argv, flags & REQUEST_NET, flags & REQUEST_MOUNT, false, mnt_template, net_ns, &pidfd);
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    int status = 0x100;  // Looks like an exit code of 1
+    if (pid != -1) {
+        status = pidfd != -1 ? wait_child(conn, pidfd, true, pid, &ru) : wait_child(conn, sfd, false, pid, &ru);
+    }
+    cgroup_remove();
+    write_result(conn, status, &ru);
+    exit(0);
+}
+
+int serve(const char* socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path %s is too long\n", socket_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+    if (enter_userns() != 0) {
+        return 1;
+    }
+    const int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        perror("socket");
+        return 1;
+    }
+    unlink(socket_path);
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror("bind");
+        return 1;
+    }
+    if (listen(sock, SOMAXCONN) != 0) {
+        perror("listen");
+        return 1;
+    }
+    int ns_socks[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, ns_socks) != 0) {
+        perror("socketpair");
+        return 1;
+    }
+    // We never wait for the handlers, let the kernel reap them.
+    signal(SIGCHLD, SIG_IGN);
+    struct pollfd fds[2] = {
+        { .fd = sock, .events = POLLIN },
+        { .fd = ns_socks[0], .events = POLLIN },
+    };
+    for (;;) {
+        fill_net_pool(ns_socks[1]);
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            return 1;
+        }
+        if (fds[1].revents & POLLIN) {
+            recv_namespace(ns_socks[0]);
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+        const int conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("accept");
+            return 1;
+        }
+        const int net_ns = num_net > 0 ? net_pool[--num_net] : -1;
+        const pid_t pid = fork();
+        if (pid == 0) {
+            close(sock);
+            close(ns_socks[0]);
+            signal(SIGCHLD, SIG_DFL);
+            handle(conn, ns_socks[1], net_ns);
+        } else if (pid == -1) {
+            perror("fork");
+        }
+        close(conn);
+        if (net_ns != -1) {
+            close(net_ns);
+        }
+    }
+}
+
+#else  // __linux__
+
+int serve(const char* socket_path) {
+  fputs("please_sandbox server mode is only supported on Linux\n", stderr);
+  return 1;
+}
+
+#endif  // __linux__
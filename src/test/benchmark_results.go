@@ -0,0 +1,196 @@
+// Parser for the JSON output of Google Benchmark (https://github.com/google/benchmark).
+//
+// Each benchmark becomes a test case whose duration is the time taken per iteration. They can
+// optionally be compared against a baseline set of results, in which case any that have become
+// slower than it by more than a given tolerance are reported as failures.
+
+package test
+
+import (
+	"bytes"
+	"encoding/json"
+	"fmt"
+	"os"
+	"strconv"
+	"time"
+
+	"github.com/thought-machine/please/src/core"
+)
+
+// benchmarkResults is the top-level structure of Google Benchmark's JSON output.
+type benchmarkResults struct {
+	Context    map[string]interface{} `json:"context"`
+	Benchmarks []benchmarkResult      `json:"benchmarks"`
+}
+
+// A benchmarkResult is a single run of a benchmark, or an aggregate of several repetitions of it.
+type benchmarkResult struct {
+	Name          string  `json:"name"`
+	RunName       string  `json:"run_name"`
+	RunType       string  `json:"run_type"`
+	AggregateName string  `json:"aggregate_name"`
+	Iterations    int64   `json:"iterations"`
+	RealTime      float64 `json:"real_time"`
+	CPUTime       float64 `json:"cpu_time"`
+	TimeUnit      string  `json:"time_unit"`
+	ErrorOccurred bool    `json:"error_occurred"`
+	ErrorMessage  string  `json:"error_message"`
+}
+
+// unit returns the duration of one of this result's time units.
+func (result *benchmarkResult) unit() time.Duration {
+	switch result.TimeUnit {
+	case "s":
+		return time.Second
+	case "ms":
+		return time.Millisecond
+	case "us":
+		return time.Microsecond
+	default:
+		return time.Nanosecond
+	}
+}
+
+func (result *benchmarkResult) realTime() time.Duration {
+	return time.Duration(result.RealTime * float64(result.unit()))
+}
+
+func (result *benchmarkResult) cpuTime() time.Duration {
+	return time.Duration(result.CPUTime * float64(result.unit()))
+}
+
+func looksLikeBenchmarkResults(b []byte) bool {
+	b = bytes.TrimSpace(b)
+	return bytes.HasPrefix(b, []byte{'{'}) && bytes.Contains(b, []byte(`"benchmarks"`))
+}
+
+// readBenchmarkResults reads a set of benchmark results and returns one for each benchmark, in the
+// order they first appear. If a benchmark was repeated, the median of its repetitions is used.
+func readBenchmarkResults(data []byte) ([]*benchmarkResult, error) {
+	results := benchmarkResults{}
+	if err := json.Unmarshal(data, &results); err != nil {
+		return nil, err
+	}
+	ret := []*benchmarkResult{}
+	byName := map[string]int{}
+	for i := range results.Benchmarks {
+		result := &results.Benchmarks[i]
+		if result.RunName == "" {
+			result.RunName = result.Name
+		}
+		if result.RunType == "aggregate" && result.AggregateName != "median" {
+			continue
+		}
+		if idx, present := byName[result.RunName]; !present {
+			byName[result.RunName] = len(ret)
+			ret = append(ret, result)
+		} else if result.RunType == "aggregate" {
+			ret[idx] = result
+		}
+	}
+	return ret, nil
+}
+
+func parseBenchmarkResults(data []byte) (core.TestSuite, error) {
+	results, err := readBenchmarkResults(data)
+	if err != nil {
+		return core.TestSuite{}, err
+	}
+	suite := core.TestSuite{}
+	for _, result := range results {
+		duration := result.realTime()
+		execution := core.TestExecution{
+			Duration: &duration,
+			Stdout:   fmt.Sprintf("%d iterations, %s real, %s cpu per iteration", result.Iterations, duration, result.cpuTime()),
+		}
+		if result.ErrorOccurred {
+			execution.Error = &core.TestResultFailure{
+				Type:    "BenchmarkError",
+				Message: result.ErrorMessage,
+			}
+		}
+		suite.TestCases = append(suite.TestCases, core.TestCase{
+			Name:       result.RunName,
+			Executions: []core.TestExecution{execution},
+		})
+	}
+	return suite, nil
+}
+
+// compareBenchmarkBaseline compares any benchmark results for the given target against its baseline,
+// if it has one, and adds failures to the results for any that have regressed.
+func compareBenchmarkBaseline(target *core.BuildTarget, results *core.TestSuite, resultsData [][]byte) {
+	baselines := target.PrefixedLabels(core.BenchmarkBaselineLabel)
+	if len(baselines) == 0 {
+		return
+	}
+	tolerance := 0.0
+	if tolerances := target.PrefixedLabels(core.BenchmarkToleranceLabel); len(tolerances) > 0 {
+		tolerance, _ = strconv.ParseFloat(tolerances[0], 64)
+	}
+	baseline, err := os.ReadFile(baselines[0])
+	if err != nil {
+		results.Add(benchmarkFailure(target.Results.Name, "BenchmarkBaseline", fmt.Sprintf("Failed to read benchmark baseline: %s", err)))
+		return
+	}
+	for _, data := range resultsData {
+		if !looksLikeBenchmarkResults(data) {
+			continue
+		}
+		regressions, err := benchmarkRegressions(data, baseline, tolerance)
+		if err != nil {
+			results.Add(benchmarkFailure(target.Results.Name, "BenchmarkBaseline", fmt.Sprintf("Failed to compare against benchmark baseline %s: %s", baselines[0], err)))
+			return
+		}
+		for i, testCase := range results.TestCases {
+			if msg, present := regressions[testCase.Name]; present && len(testCase.Executions) > 0 {
+				results.TestCases[i].Executions[len(testCase.Executions)-1].Failure = &core.TestResultFailure{
+					Type:    "BenchmarkRegression",
+					Message: msg,
+				}
+			}
+		}
+	}
+}
+
+// benchmarkRegressions returns a description of each benchmark whose CPU time is more than the given
+// percentage slower than it is in the baseline, keyed by its name.
+// Benchmarks that don't appear in the baseline are ignored.
+func benchmarkRegressions(current, baseline []byte, tolerance float64) (map[string]string, error) {
+	currentResults, err := readBenchmarkResults(current)
+	if err != nil {
+		return nil, err
+	}
+	baselineResults, err := readBenchmarkResults(baseline)
+	if err != nil {
+		return nil, err
+	}
+	baselines := make(map[string]*benchmarkResult, len(baselineResults))
+	for _, result := range baselineResults {
+		baselines[result.RunName] = result
+	}
+	regressions := map[string]string{}
+	for _, result := range currentResults {
+		base, present := baselines[result.RunName]
+		if !present || result.ErrorOccurred || base.cpuTime() <= 0 {
+			continue
+		}
+		if slowdown := 100.0 * float64(result.cpuTime()-base.cpuTime()) / float64(base.cpuTime()); slowdown > tolerance {
+			regressions[result.RunName] = fmt.Sprintf("CPU time of %s per iteration is %.1f%% slower than the baseline of %s (tolerance %g%%)", result.cpuTime(), slowdown, base.cpuTime(), tolerance)
+		}
+	}
+	return regressions, nil
+}
+
+// benchmarkFailure returns a test case recording a failure to compare against the baseline.
+func benchmarkFailure(name, resultType, msg string) core.TestCase {
+	return core.TestCase{
+		Name: name,
+		Executions: []core.TestExecution{{
+			Error: &core.TestResultFailure{
+				Type:    resultType,
+				Message: msg,
+			},
+		}},
+	}
+}
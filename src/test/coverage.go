@@ -35,6 +35,10 @@ func parseTestCoverage(target *core.BuildTarget, data []byte, run int) (*core.Te
 		return coverage, parseGoCoverageResults(target, coverage, data)
 	} else if looksLikeGcovCoverageResults(data) {
 		return coverage, parseGcovCoverageResults(target, coverage, data)
+	} else if looksLikeGcovJSONCoverageResults(data) {
+		return coverage, parseGcovJSONCoverageResults(target, coverage, data)
+	} else if looksLikeLcovCoverageResults(data) {
+		return coverage, parseLcovCoverageResults(target, coverage, data, run)
 	} else if looksLikeIstanbulCoverageResults(data) {
 		return coverage, parseIstanbulCoverageResults(target, coverage, data, run)
 	} else {
@@ -48,7 +52,7 @@ func parseTestCoverage(target *core.BuildTarget, data []byte, run int) (*core.Te
 // tests, so it's important that we identify anything with zero coverage here.
 func AddOriginalTargetsToCoverage(state *core.BuildState, includeAllFiles bool) {
 	recordedCoverage := state.Coverage
-	state.Coverage = core.TestCoverage{Tests: recordedCoverage.Tests, Files: map[string][]core.LineCoverage{}}
+	state.Coverage = core.TestCoverage{Tests: recordedCoverage.Tests, Files: map[string][]core.LineCoverage{}, Counts: recordedCoverage.Counts}
 	mergeCoverage(state, recordedCoverage, collectCoverageFiles(state, includeAllFiles))
 }
 
@@ -132,6 +136,14 @@ func WriteCoverageToFileOrDie(coverage core.TestCoverage, filename string, incre
 	}
 
 	out.Files = convertCoverage(coverage.Files, allowedFiles)
+	for file, counts := range coverage.Counts {
+		if cli.ContainsString(file, allowedFiles) {
+			if out.Counts == nil {
+				out.Counts = map[string][]uint64{}
+			}
+			out.Counts[file] = counts
+		}
+	}
 	out.Stats = getStats(coverage)
 	out.Stats.Incremental = incrementalStats
 	out.Stats.CoverageByDirectory = getDirectoryCoverage(coverage)
@@ -228,9 +240,10 @@ func convertCoverage(in map[string][]core.LineCoverage, allowedFiles []string) m
 
 // Used to prepare core.TestCoverage objects for JSON marshalling.
 type jsonCoverage struct {
-	Tests map[string]map[string]string `json:"tests"`
-	Files map[string]string            `json:"files"`
-	Stats stats                        `json:"stats"`
+	Tests  map[string]map[string]string `json:"tests"`
+	Files  map[string]string            `json:"files"`
+	Counts map[string][]uint64          `json:"counts,omitempty"`
+	Stats  stats                        `json:"stats"`
 }
 
 // stats is a struct describing summarised coverage stats.
@@ -255,6 +268,11 @@ func RemoveFilesFromCoverage(coverage core.TestCoverage, extensions []string) {
 		removeFilesFromCoverage(files, extensions)
 	}
 	removeFilesFromCoverage(coverage.Files, extensions)
+	for filename := range coverage.Counts {
+		if _, present := coverage.Files[filename]; !present {
+			delete(coverage.Counts, filename)
+		}
+	}
 }
 
 func removeFilesFromCoverage(files map[string][]core.LineCoverage, extensions []string) {
@@ -1,6 +1,9 @@
 package test
 
 import (
+	"bytes"
+	"fmt"
+	"io/ioutil"
 	"testing"
 
 	"github.com/peterebden/tools/cover"
@@ -17,6 +20,8 @@ const (
 	goCoverageFile2       = "src/test/test_data/go_coverage_2.txt"
 	goCoverageFile3       = "src/test/test_data/go_coverage_3.txt"
 	gcovCoverageFile      = "src/test/test_data/gcov_coverage.gcov"
+	gcovJSONCoverageFile  = "src/test/test_data/gcov_coverage.json"
+	lcovCoverageFile      = "src/test/test_data/lcov_coverage.info"
 	istanbulCoverageFile  = "src/test/test_data/istanbul_coverage.json"
 	istanbulCoverageFile2 = "src/test/test_data/istanbul_coverage_2.json"
 )
@@ -181,6 +186,104 @@ func TestGcovParsing(t *testing.T) {
 	assertLine(t, lines, 16, core.Covered)
 	assertLine(t, lines, 17, core.NotExecutable)
 	assertLine(t, lines, 18, core.Covered)
+	counts := coverage.Counts["test/cc_rules/deps_test.cc"]
+	assert.Equal(t, len(lines), len(counts))
+	assert.Equal(t, []uint64{0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 1, 1, 0, 3, 1, 1, 0, 3}, counts[:18])
+	assert.EqualValues(t, 2, coverage.Counts["/usr/include/unittest++/Checks.h"][18])
+}
+
+func TestGcovRepeatedFile(t *testing.T) {
+	// The same header can appear in the gcov output for several sources; its results should be merged.
+	data := []byte(`        -:    0:Source:test.h
+        -:    1:#pragma once
+        2:    2:inline int f() { return 1; }
+    #####:    3:inline int g() { return 2; }
+        -:    0:Source:test.h
+        -:    1:#pragma once
+        1:    2:inline int f() { return 1; }
+       4*:    3:inline int g() { return 2; }
+`)
+	coverage := core.NewTestCoverage()
+	assert.NoError(t, parseGcovCoverageResults(target, coverage, data))
+	assert.Equal(t, []core.LineCoverage{core.NotExecutable, core.Covered, core.Covered}, coverage.Files["test.h"])
+	assert.Equal(t, []uint64{0, 3, 4}, coverage.Counts["test.h"])
+}
+
+func TestGcovTemplateInstantiations(t *testing.T) {
+	// The sections for each instantiation repeat lines whose totals are already given.
+	data := []byte(`        -:    0:Source:test.h
+        -:    1:template <typename T>
+        3:    2:T f(T t) { return t; }
+------------------
+_Z1fIiET_S0_:
+        2:    2:T f(T t) { return t; }
+------------------
+Foo<double>::f(double):
+        1:    2:T f(T t) { return t; }
+------------------
+    #####:    3:inline int g() { return 2; }
+`)
+	coverage := core.NewTestCoverage()
+	assert.NoError(t, parseGcovCoverageResults(target, coverage, data))
+	assert.Equal(t, []core.LineCoverage{core.NotExecutable, core.Covered, core.Uncovered}, coverage.Files["test.h"])
+	assert.Equal(t, []uint64{0, 3, 0}, coverage.Counts["test.h"])
+}
+
+func TestGcovJSONParsing(t *testing.T) {
+	// This is two documents (one for each .gcda file) which both contain a.h.
+	coverage, err := parseTestCoverageFile(target, gcovJSONCoverageFile, 1)
+	assert.NoError(t, err)
+	assert.Equal(t, map[string][]core.LineCoverage{
+		"a.cc": {core.NotExecutable, core.NotExecutable, core.Covered},
+		"b.cc": {core.NotExecutable, core.Covered},
+		"a.h":  {core.Covered},
+	}, coverage.Files)
+	assert.Equal(t, map[string][]uint64{
+		"a.cc": {0, 0, 1},
+		"b.cc": {0, 1},
+		"a.h":  {2},
+	}, coverage.Counts)
+}
+
+func TestLcovParsing(t *testing.T) {
+	coverage, err := parseTestCoverageFile(target, lcovCoverageFile, 1)
+	assert.NoError(t, err)
+	lines := coverage.Files["test/cc_rules/clang/so_test.cc"]
+	assert.Equal(t, 9, len(lines))
+	assertLine(t, lines, 4, core.NotExecutable)
+	assertLine(t, lines, 5, core.Covered)
+	assertLine(t, lines, 6, core.Covered)
+	assertLine(t, lines, 7, core.Uncovered)
+	assertLine(t, lines, 8, core.NotExecutable)
+	assertLine(t, lines, 9, core.Covered)
+	assert.Equal(t, []uint64{0, 0, 0, 0, 3, 3, 0, 0, 1}, coverage.Counts["test/cc_rules/clang/so_test.cc"])
+	assert.Equal(t, []uint64{0, 12, 12}, coverage.Counts["test/cc_rules/clang/embedded_files.h"])
+}
+
+func TestIstanbulIsNotGcovJSON(t *testing.T) {
+	data, err := ioutil.ReadFile(istanbulCoverageFile)
+	assert.NoError(t, err)
+	assert.False(t, looksLikeGcovJSONCoverageResults(data))
+}
+
+func BenchmarkGcovParsing(b *testing.B) {
+	// Simulate the output of a large test by repeating our example for lots of different sources.
+	contents, err := ioutil.ReadFile(gcovCoverageFile)
+	if err != nil {
+		b.Fatalf("%s", err)
+	}
+	var data []byte
+	for i := 0; i < 1000; i++ {
+		data = append(data, bytes.ReplaceAll(contents, []byte(":Source:"), []byte(fmt.Sprintf(":Source:%d/", i)))...)
+	}
+	b.ReportAllocs()
+	b.SetBytes(int64(len(data)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if err := parseGcovCoverageResults(target, core.NewTestCoverage(), data); err != nil {
+			b.Fatalf("%s", err)
+		}
+	}
 }
 
 func TestIstanbulCoverage(t *testing.T) {
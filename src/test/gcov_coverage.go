@@ -4,9 +4,9 @@ package test
 
 import (
 	"bytes"
+	"encoding/json"
 	"fmt"
-	"strconv"
-	"strings"
+	"io"
 
 	"github.com/thought-machine/please/src/core"
 )
@@ -14,53 +14,212 @@ import (
 // gcovPlaceholder is used to mark empty coverage files for C++ tests when coverage is disabled for them.
 var gcovPlaceholder = []byte{'g', 'c', 'o', 'v'}
 
+var gcovSource = []byte("Source:")
+
+// gcovSeparator delimits the sections gcov writes for each instantiation of a template.
+var gcovSeparator = []byte("------------------")
+
+// parseGcovCoverageResults parses a sequence of .gcov files concatenated together.
+// It scans the data in place a line at a time, so it doesn't allocate anything per line; this matters
+// since the coverage output for a large C++ test can be very big.
 func parseGcovCoverageResults(target *core.BuildTarget, coverage *core.TestCoverage, data []byte) error {
 	if bytes.Equal(data, gcovPlaceholder) {
 		return nil // Coverage is disabled, not an error.
 	}
-	// The data we have is a sequence of .gcov files smashed together.
-	lines := bytes.Split(data, []byte{'\n'})
-	if len(lines) == 0 {
-		return fmt.Errorf("Empty coverage file")
+	if coverage.Counts == nil {
+		coverage.Counts = map[string][]uint64{}
 	}
 	currentFilename := ""
-	for lineno, line := range lines {
-		fields := bytes.Split(line, []byte{':'})
-		if len(fields) < 3 {
-			continue
+	var lines []core.LineCoverage
+	var counts []uint64
+	// The same file can appear several times (e.g. a header included from several sources), so
+	// each section is merged into what we've already got for it.
+	finishFile := func() {
+		if currentFilename != "" {
+			coverage.Files[currentFilename] = lines
+			coverage.Counts[currentFilename] = counts
+		}
+	}
+	// Lines in templates are followed by a section for each of their instantiations, which repeat
+	// the lines with the counts for that instantiation alone. The counts before them are already
+	// the totals, so the sections are skipped. Each starts with a separator and then the
+	// function's name, and the last is followed by another separator.
+	afterSeparator, inInstantiation := false, false
+	for lineno := 1; len(data) > 0; lineno++ {
+		line := data
+		if idx := bytes.IndexByte(data, '\n'); idx != -1 {
+			line, data = data[:idx], data[idx+1:]
+		} else {
+			data = nil
 		}
-		if bytes.Equal(fields[2], []byte("Source")) {
-			if len(fields) < 4 {
-				return fmt.Errorf("Bad source on line %d: %s", lineno, string(line))
+		if bytes.Equal(bytes.TrimSpace(line), gcovSeparator) {
+			afterSeparator, inInstantiation = true, false
+			continue
+		} else if afterSeparator {
+			afterSeparator = false
+			if len(line) > 0 && line[0] != ' ' && line[len(line)-1] == ':' {
+				inInstantiation = true
+				continue
 			}
-			currentFilename = string(fields[3])
+		}
+		if inInstantiation {
+			continue
+		}
+		// Each line is count:line number:source, where the source can contain further colons.
+		idx := bytes.IndexByte(line, ':')
+		if idx == -1 {
+			continue
+		}
+		countField, rest := line[:idx], line[idx+1:]
+		if idx = bytes.IndexByte(rest, ':'); idx == -1 {
+			continue
+		}
+		lineField, source := rest[:idx], rest[idx+1:]
+		if bytes.HasPrefix(source, gcovSource) {
+			finishFile()
+			currentFilename = string(source[len(gcovSource):])
+			lines = coverage.Files[currentFilename]
+			counts = coverage.Counts[currentFilename]
 			continue
+		} else if bytes.Equal(source, gcovSource[:len(gcovSource)-1]) {
+			return fmt.Errorf("Bad source on line %d: %s", lineno, string(line))
 		}
-		covLine, err := strconv.Atoi(strings.TrimSpace(string(fields[1])))
-		if err != nil {
+		covLine, ok := parseGcovNumber(bytes.TrimSpace(lineField))
+		if !ok {
 			return fmt.Errorf("Bad line number on line %d: %s", lineno, string(line))
-		} else if covLine > 0 {
-			coverage.Files[currentFilename] = append(coverage.Files[currentFilename], translateGcovCount(bytes.TrimSpace(fields[0])))
+		} else if covLine == 0 || currentFilename == "" {
+			continue
 		}
+		lineCoverage, count := translateGcovCount(bytes.TrimSpace(countField))
+		lines, counts = recordGcovLine(lines, counts, covLine, lineCoverage, count)
 	}
+	finishFile()
 	return nil
 }
 
-// translateGcovCount coverts gcov's format to ours.
+// translateGcovCount coverts gcov's format to ours, along with the number of times the line was executed.
 // AFAICT the format is:
 //       -: Not executable
 //   #####: Not covered
+//   =====: Not covered (only reachable by exceptional paths)
 //      32: line was hit 32 times
-func translateGcovCount(gcov []byte) core.LineCoverage {
+//     32*: as above, but some blocks on the line weren't hit
+func translateGcovCount(gcov []byte) (core.LineCoverage, uint64) {
 	if len(gcov) > 0 && gcov[0] == '-' {
-		return core.NotExecutable
-	} else if i, err := strconv.Atoi(string(gcov)); err == nil && i > 0 {
-		return core.Covered
+		return core.NotExecutable, 0
+	} else if len(gcov) > 0 && gcov[len(gcov)-1] == '*' {
+		gcov = gcov[:len(gcov)-1]
+	}
+	if i, ok := parseGcovNumber(gcov); ok && i > 0 {
+		return core.Covered, i
+	}
+	return core.Uncovered, 0
+}
+
+// parseGcovNumber parses a decimal number from the given bytes. It returns false if it isn't one.
+// This is much the same as strconv but avoids allocating a string for each one.
+func parseGcovNumber(b []byte) (uint64, bool) {
+	if len(b) == 0 {
+		return 0, false
+	}
+	var n uint64
+	for _, c := range b {
+		if c < '0' || c > '9' {
+			return 0, false
+		}
+		n = n*10 + uint64(c-'0')
 	}
-	return core.Uncovered
+	return n, true
 }
 
 // looksLikeGcovCoverageResults returns true if the given data appears to be gcov results.
 func looksLikeGcovCoverageResults(data []byte) bool {
 	return bytes.HasPrefix(data, []byte("        -:    0:Source:")) || bytes.Equal(data, gcovPlaceholder)
 }
+
+// gcovJSON is the subset of gcov's JSON intermediate format (from gcov --json-format) that we use.
+// gcov --stdout writes one of these per line, for each .gcda file it's given.
+type gcovJSON struct {
+	Files []struct {
+		File  string `json:"file"`
+		Lines []struct {
+			LineNumber uint64 `json:"line_number"`
+			Count      uint64 `json:"count"`
+		} `json:"lines"`
+	} `json:"files"`
+}
+
+// gcovJSONKeys are the top-level keys in gcov's JSON format.
+var gcovJSONKeys = map[string]bool{
+	"format_version":            true,
+	"gcc_version":               true,
+	"current_working_directory": true,
+	"data_file":                 true,
+	"files":                     true,
+}
+
+// looksLikeGcovJSONCoverageResults returns true if the given data appears to be gcov's JSON format.
+// That's also a JSON object so we look at the first key to tell it apart from Istanbul's (which are filenames).
+func looksLikeGcovJSONCoverageResults(data []byte) bool {
+	if !bytes.HasPrefix(data, []byte("{")) {
+		return false
+	}
+	decoder := json.NewDecoder(bytes.NewReader(data))
+	if _, err := decoder.Token(); err != nil {
+		return false
+	}
+	key, err := decoder.Token()
+	if err != nil {
+		return false
+	}
+	s, ok := key.(string)
+	return ok && gcovJSONKeys[s]
+}
+
+// parseGcovJSONCoverageResults parses a sequence of gcov JSON documents.
+// Each file's counts are merged between them; this happens for example for headers that are
+// included from several sources, or when the results of several runs are concatenated together.
+func parseGcovJSONCoverageResults(target *core.BuildTarget, coverage *core.TestCoverage, data []byte) error {
+	if coverage.Counts == nil {
+		coverage.Counts = map[string][]uint64{}
+	}
+	decoder := json.NewDecoder(bytes.NewReader(data))
+	for {
+		var doc gcovJSON
+		if err := decoder.Decode(&doc); err == io.EOF {
+			return nil
+		} else if err != nil {
+			return fmt.Errorf("Bad gcov JSON coverage: %s", err)
+		}
+		for _, file := range doc.Files {
+			lines := coverage.Files[file.File]
+			counts := coverage.Counts[file.File]
+			for _, line := range file.Lines {
+				if line.LineNumber == 0 {
+					continue
+				}
+				lineCoverage := core.Uncovered
+				if line.Count > 0 {
+					lineCoverage = core.Covered
+				}
+				lines, counts = recordGcovLine(lines, counts, line.LineNumber, lineCoverage, line.Count)
+			}
+			coverage.Files[file.File] = lines
+			coverage.Counts[file.File] = counts
+		}
+	}
+}
+
+// recordGcovLine records the coverage of a single line (which is 1-indexed) into the given results, merging it
+// with anything already there.
+func recordGcovLine(lines []core.LineCoverage, counts []uint64, line uint64, lineCoverage core.LineCoverage, count uint64) ([]core.LineCoverage, []uint64) {
+	for uint64(len(lines)) < line {
+		lines = append(lines, core.NotExecutable)
+		counts = append(counts, 0)
+	}
+	if lineCoverage > lines[line-1] {
+		lines[line-1] = lineCoverage
+	}
+	counts[line-1] += count
+	return lines, counts
+}
@@ -12,8 +12,7 @@ import (
 )
 
 func looksLikeIstanbulCoverageResults(results []byte) bool {
-	// This works because this is the only JSON format that we accept. If we accept another
-	// we may need to get cleverer about it.
+	// This is checked after gcov's JSON format, which is the only other JSON one we accept.
 	return bytes.HasPrefix(results, []byte("{"))
 }
 
@@ -0,0 +1,89 @@
+// Code for parsing coverage in the LCOV tracefile format, as exported by llvm-cov from
+// Clang's source-based coverage.
+
+package test
+
+import (
+	"bytes"
+	"fmt"
+
+	"github.com/thought-machine/please/src/core"
+)
+
+var (
+	lcovSourceFile = []byte("SF:")
+	lcovLine       = []byte("DA:")
+	lcovEndRecord  = []byte("end_of_record")
+)
+
+// looksLikeLcovCoverageResults returns true if the given data appears to be an LCOV tracefile.
+// These start with an optional test name record, followed by the first source file.
+func looksLikeLcovCoverageResults(data []byte) bool {
+	return bytes.HasPrefix(data, []byte("TN:")) || bytes.HasPrefix(data, lcovSourceFile)
+}
+
+// parseLcovCoverageResults parses an LCOV tracefile. Like gcov this can be large, so it's scanned
+// in place a line at a time.
+// The only records we need are SF (the source file for the following records) and DA (the execution
+// count of one line); function and branch records are ignored.
+func parseLcovCoverageResults(target *core.BuildTarget, coverage *core.TestCoverage, data []byte, run int) error {
+	if coverage.Counts == nil {
+		coverage.Counts = map[string][]uint64{}
+	}
+	currentFilename := ""
+	var lines []core.LineCoverage
+	var counts []uint64
+	finishFile := func() {
+		if currentFilename != "" {
+			coverage.Files[currentFilename] = lines
+			coverage.Counts[currentFilename] = counts
+		}
+		currentFilename = ""
+	}
+	for lineno := 1; len(data) > 0; lineno++ {
+		line := data
+		if idx := bytes.IndexByte(data, '\n'); idx != -1 {
+			line, data = data[:idx], data[idx+1:]
+		} else {
+			data = nil
+		}
+		line = bytes.TrimSpace(line)
+		if bytes.HasPrefix(line, lcovSourceFile) {
+			finishFile()
+			currentFilename = sanitiseFileName(target, string(line[len(lcovSourceFile):]), run)
+			lines = coverage.Files[currentFilename]
+			counts = coverage.Counts[currentFilename]
+		} else if bytes.Equal(line, lcovEndRecord) {
+			finishFile()
+		} else if bytes.HasPrefix(line, lcovLine) {
+			if currentFilename == "" {
+				return fmt.Errorf("Line record outside a source file on line %d: %s", lineno, string(line))
+			}
+			// DA:<line number>,<execution count>[,<checksum>]
+			fields := line[len(lcovLine):]
+			idx := bytes.IndexByte(fields, ',')
+			if idx == -1 {
+				return fmt.Errorf("Bad line record on line %d: %s", lineno, string(line))
+			}
+			covLine, ok := parseGcovNumber(fields[:idx])
+			if !ok || covLine == 0 {
+				return fmt.Errorf("Bad line number on line %d: %s", lineno, string(line))
+			}
+			fields = fields[idx+1:]
+			if idx = bytes.IndexByte(fields, ','); idx != -1 {
+				fields = fields[:idx]
+			}
+			count, ok := parseGcovNumber(fields)
+			if !ok {
+				return fmt.Errorf("Bad execution count on line %d: %s", lineno, string(line))
+			}
+			lineCoverage := core.Uncovered
+			if count > 0 {
+				lineCoverage = core.Covered
+			}
+			lines, counts = recordGcovLine(lines, counts, covLine, lineCoverage, count)
+		}
+	}
+	finishFile()
+	return nil
+}
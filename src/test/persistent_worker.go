@@ -0,0 +1,68 @@
+// Support for tests whose binary can be kept running as a persistent worker.
+//
+// Instead of being started afresh for every run, the binary is started once and then sent a
+// request for each run (including flaky reruns and each shard), so they don't pay for process
+// startup and static initialisation each time. It's told the test directory & environment for
+// each run and writes its results there as it normally would.
+
+package test
+
+import (
+	"fmt"
+	"path"
+	"strings"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/worker"
+)
+
+// persistentTestArgs returns the arguments to send to the test's persistent worker, or false if
+// it shouldn't use one. That requires the test command to just be running the test binary, since
+// we are about to bypass the shell; the arguments are passed as they are, without being expanded.
+func persistentTestArgs(state *core.BuildState, target *core.BuildTarget, command string) ([]string, bool) {
+	if !target.HasLabel(core.PersistentTestWorkerLabel) || len(target.Outputs()) != 1 {
+		return nil, false
+	} else if target.TestSandbox || state.NeedCoverage || state.DebugTests {
+		// Worker processes aren't sandboxed, coverage is only written when the process exits,
+		// and a debugger needs to be started with the test.
+		log.Debug("Not using a persistent worker for %s", target.Label)
+		return nil, false
+	}
+	fields := strings.Fields(command)
+	if len(fields) == 0 || fields[0] != "$TEST" {
+		log.Warning("%s is labelled to use a persistent worker but its test command doesn't start with $TEST", target.Label)
+		return nil, false
+	}
+	return fields[1:], true
+}
+
+// runPersistentTest runs a test by sending a request to its persistent worker.
+// It returns the test's output & an error if it failed, equivalently to running it normally.
+func runPersistentTest(state *core.BuildState, target *core.BuildTarget, run int, shard testShard, env, args []string) ([]byte, error) {
+	dir := path.Join(core.RepoRoot, shard.dir(target, run))
+	binary := path.Join(core.RepoRoot, target.OutDir(), target.Outputs()[0])
+	name := persistentWorkerName(target, run, shard)
+	log.Debug("Running %s#%d with persistent worker %s\n%s", target.Label, run, name, strings.Join(args, " "))
+	resp, err := worker.RunTest(state, target, name, binary, &worker.Request{
+		Rule:    name,
+		TempDir: dir,
+		Options: args,
+		Test:    true,
+		Env:     env,
+	})
+	if err != nil {
+		return nil, err
+	}
+	output := []byte(strings.Join(resp.Messages, "\n"))
+	if !resp.Success {
+		return output, fmt.Errorf("test failed in persistent worker")
+	}
+	return output, nil
+}
+
+// persistentWorkerName returns the name of the worker for a run of a shard of a test. Each has a
+// worker of its own, since with --num_runs they can run concurrently, and a worker's responses are
+// matched to requests by their Rule (which is the same as this).
+func persistentWorkerName(target *core.BuildTarget, run int, shard testShard) string {
+	return fmt.Sprintf("%s#shard_%d_run_%d", target.Label, shard.index, run)
+}
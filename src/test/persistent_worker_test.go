@@ -0,0 +1,42 @@
+package test
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+
+	"github.com/thought-machine/please/src/core"
+)
+
+func TestPersistentTestArgs(t *testing.T) {
+	state := core.NewDefaultBuildState()
+	target := core.NewBuildTarget(core.ParseBuildLabel("//src/test:persistent_test", ""))
+	target.AddOutput("persistent_test")
+
+	_, ok := persistentTestArgs(state, target, "$TEST")
+	assert.False(t, ok, "Targets need to opt in")
+
+	target.AddLabel(core.PersistentTestWorkerLabel)
+	args, ok := persistentTestArgs(state, target, "$TEST --gtest_filter=Foo.*  --gtest_also_run_disabled_tests ")
+	assert.True(t, ok)
+	assert.Equal(t, []string{"--gtest_filter=Foo.*", "--gtest_also_run_disabled_tests"}, args)
+
+	_, ok = persistentTestArgs(state, target, "$(exe //tools:wrapper) $TEST")
+	assert.False(t, ok, "The worker can only be used when the command just runs the test")
+
+	state.NeedCoverage = true
+	_, ok = persistentTestArgs(state, target, "$TEST")
+	assert.False(t, ok, "Coverage is only written when the test exits")
+	state.NeedCoverage = false
+
+	target.TestSandbox = true
+	_, ok = persistentTestArgs(state, target, "$TEST")
+	assert.False(t, ok, "Workers aren't sandboxed")
+}
+
+func TestPersistentWorkerName(t *testing.T) {
+	target := core.NewBuildTarget(core.ParseBuildLabel("//src/test:persistent_test", ""))
+	assert.Equal(t, "//src/test:persistent_test#shard_0_run_1", persistentWorkerName(target, 1, testShard{}))
+	assert.NotEqual(t, persistentWorkerName(target, 1, testShard{index: 1, total: 2}), persistentWorkerName(target, 2, testShard{index: 1, total: 2}),
+		"Concurrent runs of the same shard shouldn't share a worker")
+}
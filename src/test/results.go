@@ -43,6 +43,8 @@ func parseTestResultDatum(data []byte) (core.TestSuite, error) {
 			testSuite.Collapse(suite)
 		}
 		return testSuite, err
+	} else if looksLikeBenchmarkResults(data) {
+		return parseBenchmarkResults(data)
 	} else {
 		return parseGoTestResults(data)
 	}
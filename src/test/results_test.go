@@ -1,7 +1,9 @@
 package test
 
 import (
+	"os"
 	"testing"
+	"time"
 
 	"github.com/stretchr/testify/assert"
 	"github.com/stretchr/testify/require"
@@ -186,3 +188,42 @@ func TestParseGoFileWithLogging(t *testing.T) {
 	assert.Equal(t, 3, results.Passes())
 	assert.Equal(t, 0, results.Failures())
 }
+
+func TestParseBenchmarkResults(t *testing.T) {
+	results, err := parseTestResultsFile("src/test/test_data/benchmark.json")
+	require.NoError(t, err)
+	assert.Equal(t, 4, len(results.TestCases))
+	assert.Equal(t, 3, results.Passes())
+	assert.Equal(t, 1, results.Errors())
+	assert.Equal(t, "BM_Memcpy/4096", results.TestCases[2].Name)
+	assert.Equal(t, 181*time.Microsecond, *results.TestCases[2].Executions[0].Duration)
+}
+
+func TestBenchmarkRegressions(t *testing.T) {
+	current, err := os.ReadFile("src/test/test_data/benchmark.json")
+	require.NoError(t, err)
+	baseline, err := os.ReadFile("src/test/test_data/benchmark_baseline.json")
+	require.NoError(t, err)
+	// BM_StringCreation is compared against the median of its repetitions, and is about 3% slower.
+	regressions, err := benchmarkRegressions(current, baseline, 5)
+	require.NoError(t, err)
+	assert.Equal(t, 1, len(regressions))
+	assert.Contains(t, regressions, "BM_StringCopy")
+	regressions, err = benchmarkRegressions(current, baseline, 1)
+	require.NoError(t, err)
+	assert.Equal(t, 2, len(regressions))
+	assert.Contains(t, regressions, "BM_StringCreation")
+}
+
+func TestCompareBenchmarkBaseline(t *testing.T) {
+	data, err := readTestResultsDir("src/test/test_data/benchmark.json")
+	require.NoError(t, err)
+	results, err := parseTestResults(data)
+	require.NoError(t, err)
+	target := core.NewBuildTarget(core.BuildLabel{PackageName: "src/test", Name: "benchmark"})
+	target.AddLabel(core.BenchmarkBaselineLabel + "src/test/test_data/benchmark_baseline.json")
+	target.AddLabel(core.BenchmarkToleranceLabel + "5")
+	compareBenchmarkBaseline(target, &results, data)
+	assert.Equal(t, 1, results.Failures())
+	assert.Equal(t, "BenchmarkRegression", results.TestCases[1].Executions[0].Failure.Type)
+}
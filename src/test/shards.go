@@ -0,0 +1,180 @@
+// Support for splitting a test into several shards, which are run in parallel.
+//
+// Each shard is an invocation of the same test command which is told which subset of the
+// tests it should run via environment variables. They are retried and cached individually, so
+// a flaky test in one shard doesn't need the others to run again.
+
+package test
+
+import (
+	"bytes"
+	"crypto/sha1"
+	"fmt"
+	"io/ioutil"
+	"os"
+	"path"
+	"sync"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/fs"
+)
+
+// A testShard identifies one shard of a test. The zero value means the test isn't sharded.
+type testShard struct {
+	index, total int
+}
+
+// dir returns the directory this shard runs in for a given run of the target.
+func (shard testShard) dir(target *core.BuildTarget, run int) string {
+	if shard.total == 0 {
+		return target.TestDir(run)
+	}
+	return target.TestShardDir(run, shard.index)
+}
+
+// env returns the environment variables that tell the test which shard it's running.
+// GTEST_* are understood directly by googletest; test mains for other frameworks can use the others.
+func (shard testShard) env() []string {
+	if shard.total == 0 {
+		return nil
+	}
+	return []string{
+		fmt.Sprintf("TEST_SHARD_INDEX=%d", shard.index),
+		fmt.Sprintf("TEST_TOTAL_SHARDS=%d", shard.total),
+		fmt.Sprintf("GTEST_SHARD_INDEX=%d", shard.index),
+		fmt.Sprintf("GTEST_TOTAL_SHARDS=%d", shard.total),
+	}
+}
+
+// hash returns the hash that this shard's results are stored under, given the hash of the whole test.
+func (shard testShard) hash(hash []byte) []byte {
+	h := sha1.New()
+	h.Write(hash)
+	fmt.Fprintf(h, "shard %d of %d", shard.index, shard.total)
+	return h.Sum(nil)
+}
+
+// doShardedRun runs all the shards of a test in parallel and returns their combined results.
+// Each shard takes CPUs from the same pool as build actions while it's running, so there are
+// never more running at once than -j allows.
+// If they all succeed, their results are collected into the test directory for the first run,
+// where they'd normally be written by an unsharded test.
+func doShardedRun(tid int, state *core.BuildState, target *core.BuildTarget, hash []byte, needCoverage bool) (core.TestSuite, *core.TestCoverage) {
+	state.LogBuildResult(tid, target, core.TargetTesting, fmt.Sprintf("Testing (%d shards)...", target.TestShards))
+	suites := make([]core.TestSuite, target.TestShards)
+	coverages := make([]*core.TestCoverage, target.TestShards)
+	var wg sync.WaitGroup
+	for i := range suites {
+		wg.Add(1)
+		go func(shard testShard) {
+			defer wg.Done()
+			suites[shard.index], coverages[shard.index] = runShard(tid, state, target, shard, shard.hash(hash), needCoverage)
+		}(testShard{index: i, total: target.TestShards})
+	}
+	wg.Wait()
+
+	results := core.TestSuite{Cached: true}
+	coverage := core.NewTestCoverage()
+	for i, suite := range suites {
+		results.TimedOut = results.TimedOut || suite.TimedOut
+		results.Properties = suite.Properties
+		// The shards run concurrently so the test took as long as the slowest of them.
+		if suite.Duration > results.Duration {
+			results.Duration = suite.Duration
+		}
+		results.ResourceUsage = results.ResourceUsage.Add(suite.ResourceUsage)
+		results.Cached = results.Cached && suite.Cached
+		results.Add(suite.TestCases...)
+		coverage.Aggregate(coverages[i])
+	}
+	if results.TestCases.AllSucceeded() {
+		if err := collectShardResults(state, target, needCoverage); err != nil {
+			log.Warning("Failed to collect test results for %s: %s", target.Label, err)
+		}
+	}
+	return results, coverage
+}
+
+// runShard runs a single shard of a test, unless it has already succeeded with the same hash.
+func runShard(tid int, state *core.BuildState, target *core.BuildTarget, shard testShard, hash []byte, needCoverage bool) (core.TestSuite, *core.TestCoverage) {
+	resultsFile := target.TestShardResultsFile(shard.index)
+	coverageFile := target.TestShardCoverageFile(shard.index)
+	files := []string{path.Base(resultsFile)}
+	if needCoverage {
+		files = append(files, path.Base(coverageFile))
+	}
+	haveResults := func() bool {
+		return verifyHash(state, resultsFile, hash) && (!needCoverage || verifyHash(state, coverageFile, hash))
+	}
+	if !state.ForceRerun && len(state.TestArgs) == 0 && (haveResults() || retrieveFromCache(state, target, hash, files)) {
+		if results, err := parseTestResultsFile(resultsFile); err == nil && results.TestCases.AllSucceeded() {
+			log.Debug("Not re-running shard %d of %s; got cached results.", shard.index, target.Label)
+			results.Cached = true
+			if needCoverage {
+				return results, parseCoverageFile(target, coverageFile, 1)
+			}
+			return results, core.NewTestCoverage()
+		}
+	}
+	// The coverage from each flaky run is merged together here too.
+	release := state.AcquireCPUs(target)
+	results, coverage := doFlakeRun(tid, state, target, false, shard)
+	release()
+	// As for the whole test, results are only stored if they're complete & successful.
+	if len(state.TestArgs) == 0 && results.TestCases.AllSucceeded() {
+		dir := shard.dir(target, 1)
+		if err := moveOutputFile(state, hash, path.Join(dir, core.TestResultsFile), resultsFile, dummyOutput); err != nil {
+			log.Warning("Failed to move results file for shard %d of %s: %s", shard.index, target.Label, err)
+		} else if err := moveShardCoverage(state, hash, dir, coverageFile, needCoverage); err != nil {
+			log.Warning("Failed to move coverage file for shard %d of %s: %s", shard.index, target.Label, err)
+		} else if state.Cache != nil {
+			state.Cache.Store(target, hash, files)
+		}
+		if state.CleanWorkdirs {
+			if err := fs.ForceRemove(state.ProcessExecutor, dir); err != nil {
+				log.Warning("Failed to remove test directory for shard %d of %s: %s", shard.index, target.Label, err)
+			}
+		}
+	}
+	return results, coverage
+}
+
+// moveShardCoverage moves a shard's coverage file from its test directory, if we need it.
+func moveShardCoverage(state *core.BuildState, hash []byte, dir, coverageFile string, needCoverage bool) error {
+	if !needCoverage {
+		return nil
+	}
+	return moveOutputFile(state, hash, path.Join(dir, core.CoverageFile), coverageFile, dummyCoverage)
+}
+
+// collectShardResults copies the results of each shard into a single directory where the test would
+// have written them if it weren't sharded, so they are stored & parsed together afterwards.
+// If we need coverage, each shard's coverage is concatenated into a single file too; this works
+// for gcov & LCOV (which is what the C++ rules produce) because we merge repeated files while parsing them.
+func collectShardResults(state *core.BuildState, target *core.BuildTarget, needCoverage bool) error {
+	dir := path.Join(target.TestDir(1), core.TestResultsFile)
+	if err := fs.ForceRemove(state.ProcessExecutor, dir); err != nil {
+		return err
+	} else if err := os.MkdirAll(dir, core.DirPermissions); err != nil {
+		return err
+	}
+	var coverage []byte
+	for i := 0; i < target.TestShards; i++ {
+		resultsFile := target.TestShardResultsFile(i)
+		if err := fs.RecursiveCopy(resultsFile, path.Join(dir, path.Base(resultsFile)), 0644); err != nil {
+			return err
+		}
+		if needCoverage {
+			b, err := ioutil.ReadFile(target.TestShardCoverageFile(i))
+			if err != nil {
+				return err
+			} else if !bytes.Equal(b, []byte(dummyCoverage)) && !bytes.Equal(b, gcovPlaceholder) {
+				coverage = append(coverage, b...)
+			}
+		}
+	}
+	if len(coverage) > 0 {
+		return ioutil.WriteFile(path.Join(target.TestDir(1), core.CoverageFile), coverage, 0644)
+	}
+	return nil
+}
@@ -0,0 +1,47 @@
+package test
+
+import (
+	"path"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+
+	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/fs"
+)
+
+func TestShardEnv(t *testing.T) {
+	assert.Nil(t, testShard{}.env())
+	assert.Equal(t, []string{
+		"TEST_SHARD_INDEX=1",
+		"TEST_TOTAL_SHARDS=3",
+		"GTEST_SHARD_INDEX=1",
+		"GTEST_TOTAL_SHARDS=3",
+	}, testShard{index: 1, total: 3}.env())
+}
+
+func TestShardHash(t *testing.T) {
+	hash := []byte("abcdef")
+	assert.NotEqual(t, testShard{index: 0, total: 2}.hash(hash), testShard{index: 1, total: 2}.hash(hash))
+	assert.NotEqual(t, testShard{index: 0, total: 2}.hash(hash), testShard{index: 0, total: 3}.hash(hash))
+	assert.Equal(t, testShard{index: 1, total: 2}.hash(hash), testShard{index: 1, total: 2}.hash(hash))
+}
+
+func TestCollectShardResults(t *testing.T) {
+	state := core.NewDefaultBuildState()
+	target := core.NewBuildTarget(core.ParseBuildLabel("//src/test:sharded_test", ""))
+	target.TestShards = 2
+	require.NoError(t, fs.EnsureDir(target.TestShardResultsFile(0)))
+	require.NoError(t, fs.CopyFile("src/test/test_data/junit.xml", target.TestShardResultsFile(0), 0644))
+	require.NoError(t, fs.CopyFile("src/test/test_data/xmlrunner-junit.xml", target.TestShardResultsFile(1), 0644))
+	require.NoError(t, collectShardResults(state, target, false))
+
+	shard0, err := parseTestResultsFile(target.TestShardResultsFile(0))
+	require.NoError(t, err)
+	shard1, err := parseTestResultsFile(target.TestShardResultsFile(1))
+	require.NoError(t, err)
+	results, err := parseTestResultsFile(path.Join(target.TestDir(1), core.TestResultsFile))
+	require.NoError(t, err)
+	assert.Equal(t, len(shard0.TestCases)+len(shard1.TestCases), len(results.TestCases))
+}
@@ -76,7 +76,7 @@ func test(tid int, state *core.BuildState, label core.BuildLabel, target *core.B
 			state.LogBuildError(tid, label, core.TargetTestFailed, err, "Failed to download test inputs")
 			return
 		}
-		if err := prepareTestDir(state, target, run); err != nil {
+		if err := prepareTestDir(state, target, run, testShard{}); err != nil {
 			state.LogBuildError(tid, label, core.TargetTestFailed, err, "Failed to prepare test directory")
 			return
 		}
@@ -194,7 +194,11 @@ func test(tid int, state *core.BuildState, label core.BuildLabel, target *core.B
 	coverage := &core.TestCoverage{}
 	if state.NumTestRuns == 1 {
 		var results core.TestSuite
-		results, coverage = doFlakeRun(tid, state, target, runRemotely)
+		if target.TestShards > 1 && !runRemotely {
+			results, coverage = doShardedRun(tid, state, target, hash, needCoverage)
+		} else {
+			results, coverage = doFlakeRun(tid, state, target, runRemotely, testShard{})
+		}
 		target.AddTestResults(results)
 
 		if target.Results.TestCases.AllSucceeded() {
@@ -205,13 +209,13 @@ func test(tid int, state *core.BuildState, label core.BuildLabel, target *core.B
 		for run := 1; run <= state.NumTestRuns; run++ {
 			state.LogBuildResult(tid, target, core.TargetTesting, getRunStatus(run, state.NumTestRuns))
 			var results core.TestSuite
-			results, coverage = doTest(tid, state, target, runRemotely, 1) // Sequential tests re-use run 1's test dir
+			results, coverage = doTest(tid, state, target, runRemotely, 1, testShard{}) // Sequential tests re-use run 1's test dir
 			target.AddTestResults(results)
 		}
 	} else {
 		state.LogBuildResult(tid, target, core.TargetTesting, getRunStatus(run, state.NumTestRuns))
 		var results core.TestSuite
-		results, coverage = doTest(tid, state, target, runRemotely, run)
+		results, coverage = doTest(tid, state, target, runRemotely, run, testShard{})
 		target.AddTestResults(results)
 	}
 
@@ -239,7 +243,7 @@ func retrieveFromCache(state *core.BuildState, target *core.BuildTarget, hash []
 }
 
 // doFlakeRun runs a test repeatably until it succeeds or exceeds the max number of flakes for the test
-func doFlakeRun(tid int, state *core.BuildState, target *core.BuildTarget, runRemotely bool) (core.TestSuite, *core.TestCoverage) {
+func doFlakeRun(tid int, state *core.BuildState, target *core.BuildTarget, runRemotely bool, shard testShard) (core.TestSuite, *core.TestCoverage) {
 	coverage := &core.TestCoverage{}
 	results := core.TestSuite{}
 
@@ -247,11 +251,12 @@ func doFlakeRun(tid int, state *core.BuildState, target *core.BuildTarget, runRe
 	for flakes := 1; flakes <= target.Flakiness; flakes++ {
 		state.LogBuildResult(tid, target, core.TargetTesting, getFlakeStatus(flakes, target.Flakiness))
 
-		testSuite, cov := doTest(tid, state, target, runRemotely, 1) // If we're running flakes, numRuns must be 1
+		testSuite, cov := doTest(tid, state, target, runRemotely, 1, shard) // If we're running flakes, numRuns must be 1
 
 		results.TimedOut = results.TimedOut || testSuite.TimedOut
 		results.Properties = testSuite.Properties
 		results.Duration += testSuite.Duration
+		results.ResourceUsage = results.ResourceUsage.Add(testSuite.ResourceUsage)
 		// Each set of executions is treated as a group
 		// So if a test flakes three times, three executions will be part of one test case.
 		results.Add(testSuite.TestCases...)
@@ -334,17 +339,18 @@ func pluralise(word string, quantity int) string {
 	return word + "s"
 }
 
-func prepareTestDir(state *core.BuildState, target *core.BuildTarget, run int) error {
-	if err := fs.ForceRemove(state.ProcessExecutor, target.TestDir(run)); err != nil {
+func prepareTestDir(state *core.BuildState, target *core.BuildTarget, run int, shard testShard) error {
+	dir := shard.dir(target, run)
+	if err := fs.ForceRemove(state.ProcessExecutor, dir); err != nil {
 		return err
 	}
-	if err := os.MkdirAll(target.TestDir(run), core.DirPermissions); err != nil {
+	if err := os.MkdirAll(dir, core.DirPermissions); err != nil {
 		return err
 	}
 	if err := state.EnsureDownloaded(target); err != nil {
 		return err
 	}
-	for out := range core.IterRuntimeFiles(state.Graph, target, true, target.TestDir(run)) {
+	for out := range core.IterRuntimeFiles(state.Graph, target, true, dir) {
 		if err := core.PrepareSourcePair(out); err != nil {
 			return err
 		}
@@ -353,9 +359,9 @@ func prepareTestDir(state *core.BuildState, target *core.BuildTarget, run int) e
 }
 
 // testCommandAndEnv returns the test command & environment for a target.
-func testCommandAndEnv(state *core.BuildState, target *core.BuildTarget, run int) (string, []string, error) {
+func testCommandAndEnv(state *core.BuildState, target *core.BuildTarget, run int, shard testShard) (string, []string, error) {
 	replacedCmd, err := core.ReplaceTestSequences(state, target, target.GetTestCommand(state))
-	env := core.TestEnvironment(state, target, path.Join(core.RepoRoot, target.TestDir(run)))
+	env := append(core.TestEnvironment(state, target, path.Join(core.RepoRoot, shard.dir(target, run))), shard.env()...)
 	if len(state.TestArgs) > 0 {
 		args := strings.Join(state.TestArgs, " ")
 		replacedCmd += " " + args
@@ -364,19 +370,24 @@ func testCommandAndEnv(state *core.BuildState, target *core.BuildTarget, run int
 	return replacedCmd, env, err
 }
 
-func runTest(state *core.BuildState, target *core.BuildTarget, run int) ([]byte, error) {
-	replacedCmd, env, err := testCommandAndEnv(state, target, run)
+func runTest(state *core.BuildState, target *core.BuildTarget, run int, shard testShard, metadata *core.BuildMetadata) ([]byte, error) {
+	replacedCmd, env, err := testCommandAndEnv(state, target, run, shard)
 	if err != nil {
 		return nil, err
 	}
+	if args, ok := persistentTestArgs(state, target, replacedCmd); ok {
+		return runPersistentTest(state, target, run, shard, env, args)
+	}
 	log.Debugf("Running test %s#%d\nENVIRONMENT:\n%s\n%s", target.Label, run, strings.Join(env, "\n"), replacedCmd)
-	_, stderr, err := state.ProcessExecutor.ExecWithTimeoutShellStdStreams(target, target.TestDir(run), env, target.TestTimeout, state.ShowAllOutput, process.NewSandboxConfig(target.TestSandbox, target.TestSandbox), replacedCmd, state.DebugTests)
+	recorder := &process.UsageRecordingTarget{Target: target}
+	_, stderr, err := state.ProcessExecutor.ExecWithTimeoutShellStdStreams(recorder, shard.dir(target, run), env, target.TestTimeout, state.ShowAllOutput, process.NewSandboxConfig(target.TestSandbox, target.TestSandbox), replacedCmd, state.DebugTests)
+	metadata.ResourceUsage = recorder.Usage
 	return stderr, err
 }
 
-func doTest(tid int, state *core.BuildState, target *core.BuildTarget, runRemotely bool, run int) (core.TestSuite, *core.TestCoverage) {
+func doTest(tid int, state *core.BuildState, target *core.BuildTarget, runRemotely bool, run int, shard testShard) (core.TestSuite, *core.TestCoverage) {
 	startTime := time.Now()
-	metadata, resultsData, coverage, err := doTestResults(tid, state, target, runRemotely, run)
+	metadata, resultsData, coverage, err := doTestResults(tid, state, target, runRemotely, run, shard)
 	duration := time.Since(startTime)
 	parsedSuite := parseTestOutput(string(metadata.Stdout), string(metadata.Stderr), err, duration, target, resultsData)
 	return core.TestSuite{
@@ -387,10 +398,12 @@ func doTest(tid int, state *core.BuildState, target *core.BuildTarget, runRemote
 		Properties: parsedSuite.Properties,
 		TestCases:  parsedSuite.TestCases,
 		Cached:     metadata.Cached,
+
+		ResourceUsage: metadata.ResourceUsage,
 	}, coverage
 }
 
-func doTestResults(tid int, state *core.BuildState, target *core.BuildTarget, runRemotely bool, run int) (*core.BuildMetadata, [][]byte, *core.TestCoverage, error) {
+func doTestResults(tid int, state *core.BuildState, target *core.BuildTarget, runRemotely bool, run int, shard testShard) (*core.BuildMetadata, [][]byte, *core.TestCoverage, error) {
 	var err error
 	var metadata *core.BuildMetadata
 
@@ -400,17 +413,16 @@ func doTestResults(tid int, state *core.BuildState, target *core.BuildTarget, ru
 			metadata = new(core.BuildMetadata)
 		}
 	} else {
-		var stdout []byte
-		stdout, err = prepareAndRunTest(tid, state, target, run)
-		metadata = &core.BuildMetadata{Stdout: stdout}
+		metadata = &core.BuildMetadata{}
+		metadata.Stdout, err = prepareAndRunTest(tid, state, target, run, shard, metadata)
 	}
 
-	coverage := parseCoverageFile(target, path.Join(target.TestDir(run), core.CoverageFile), run)
+	coverage := parseCoverageFile(target, path.Join(shard.dir(target, run), core.CoverageFile), run)
 
 	var data [][]byte
 	// If this test is meant to produce an output file and the test ran successfully
 	if !target.NoTestOutput {
-		d, readErr := readTestResultsDir(path.Join(target.TestDir(run), core.TestResultsFile))
+		d, readErr := readTestResultsDir(path.Join(shard.dir(target, run), core.TestResultsFile))
 		if readErr != nil {
 			// If we got an error running the tests, this is probably to be expected and not worth warning about
 			if err == nil {
@@ -424,12 +436,12 @@ func doTestResults(tid int, state *core.BuildState, target *core.BuildTarget, ru
 }
 
 // prepareAndRunTest sets up a test directory and runs the test.
-func prepareAndRunTest(tid int, state *core.BuildState, target *core.BuildTarget, run int) (stdout []byte, err error) {
-	if err = prepareTestDir(state, target, run); err != nil {
+func prepareAndRunTest(tid int, state *core.BuildState, target *core.BuildTarget, run int, shard testShard, metadata *core.BuildMetadata) (stdout []byte, err error) {
+	if err = prepareTestDir(state, target, run, shard); err != nil {
 		state.LogBuildError(tid, target.Label, core.TargetTestFailed, err, "Failed to prepare test directory for %s: %s", target.Label, err)
 		return []byte{}, err
 	}
-	return runTest(state, target, run)
+	return runTest(state, target, run, shard, metadata)
 }
 
 func parseTestOutput(stdout string, stderr string, runError error, duration time.Duration, target *core.BuildTarget, resultsData [][]byte) core.TestSuite {
@@ -515,6 +527,8 @@ func parseTestOutput(stdout string, stderr string, runError error, duration time
 		results.Add(failSuite("Test returned 0 but still reported failures", "ReturnValue", "").TestCases...)
 	}
 
+	// Benchmarks that have regressed against their baseline fail, even though they ran successfully.
+	compareBenchmarkBaseline(target, &results, resultsData)
 	return results
 }
 
@@ -17,6 +17,14 @@ import (
 	"io"
 
 	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/process"
+)
+
+// Names of the test suite properties recording the resources used by a test.
+const (
+	userTimeProperty   = "plz.user_time"
+	systemTimeProperty = "plz.system_time"
+	maxRSSProperty     = "plz.max_rss"
 )
 
 func looksLikeJUnitXMLTestResults(b []byte) bool {
@@ -90,6 +98,8 @@ func toCoreTestSuite(xmlTestSuite *jUnitXMLTestSuite) core.TestSuite {
 		Duration:   xmlTestSuite.Duration(),
 		Cached:     toCoreCached(xmlTestSuite.Properties),
 		Properties: toCoreProperties(xmlTestSuite.Properties),
+
+		ResourceUsage: toCoreResourceUsage(xmlTestSuite.Properties),
 	}
 	for _, test := range xmlTestSuite.TestCases {
 		result := core.TestCase{
@@ -114,10 +124,31 @@ func toCoreCached(properties jUnitXMLProperties) bool {
 	return false
 }
 
+// toCoreResourceUsage reads back the resource usage properties written by toXMLProperties.
+func toCoreResourceUsage(properties jUnitXMLProperties) process.ResourceUsage {
+	usage := process.ResourceUsage{}
+	for _, prop := range properties.Property {
+		switch prop.Name {
+		case userTimeProperty:
+			usage.User = parseSeconds(prop.Value)
+		case systemTimeProperty:
+			usage.System = parseSeconds(prop.Value)
+		case maxRSSProperty:
+			usage.MaxRSS, _ = strconv.ParseInt(prop.Value, 10, 64)
+		}
+	}
+	return usage
+}
+
+func parseSeconds(s string) time.Duration {
+	f, _ := strconv.ParseFloat(s, 64)
+	return time.Duration(f * float64(time.Second))
+}
+
 func toCoreProperties(properties jUnitXMLProperties) map[string]string {
 	props := make(map[string]string)
 	for _, prop := range properties.Property {
-		if prop.Name == "cached" {
+		if prop.Name == "cached" || prop.Name == userTimeProperty || prop.Name == systemTimeProperty || prop.Name == maxRSSProperty {
 			continue
 		}
 		props[prop.Name] = prop.Value
@@ -505,7 +536,7 @@ func mustSerialiseResults(graph *core.BuildGraph, storeOutputOnSuccess bool) []b
 	return b
 }
 
-func toXMLProperties(props map[string]string, cached bool) jUnitXMLProperties {
+func toXMLProperties(props map[string]string, cached bool, usage process.ResourceUsage) jUnitXMLProperties {
 	out := jUnitXMLProperties{}
 	for k, v := range props {
 		out.Property = append(out.Property, jUnitXMLProperty{
@@ -519,6 +550,21 @@ func toXMLProperties(props map[string]string, cached bool) jUnitXMLProperties {
 			Value: strconv.FormatBool(cached),
 		})
 	}
+	if usage.CPU() > 0 {
+		out.Property = append(out.Property, jUnitXMLProperty{
+			Name:  userTimeProperty,
+			Value: strconv.FormatFloat(usage.User.Seconds(), 'f', 3, 64),
+		}, jUnitXMLProperty{
+			Name:  systemTimeProperty,
+			Value: strconv.FormatFloat(usage.System.Seconds(), 'f', 3, 64),
+		})
+	}
+	if usage.MaxRSS > 0 {
+		out.Property = append(out.Property, jUnitXMLProperty{
+			Name:  maxRSSProperty,
+			Value: strconv.FormatInt(usage.MaxRSS, 10),
+		})
+	}
 	return out
 }
 
@@ -532,7 +578,7 @@ func toXMLTestSuite(testSuite *core.TestSuite, storeOutputOnSuccess bool) *jUnit
 		Failures:   testSuite.Failures(),
 		Skipped:    testSuite.Skips(),
 		timed:      timed{testSuite.Duration.Seconds()},
-		Properties: toXMLProperties(testSuite.Properties, testSuite.Cached),
+		Properties: toXMLProperties(testSuite.Properties, testSuite.Cached, testSuite.ResourceUsage),
 	}
 	for _, testCase := range testSuite.TestCases {
 		xmlTest := toXMLTestCase(testCase, storeOutputOnSuccess)
@@ -12,6 +12,7 @@ import (
 	"github.com/stretchr/testify/assert"
 
 	"github.com/thought-machine/please/src/core"
+	"github.com/thought-machine/please/src/process"
 )
 
 func TestParseJUnitXMLResultsOneSuccessfulTest(t *testing.T) {
@@ -34,6 +35,21 @@ func TestParseJUnitXMLResultsOneSuccessfulTest(t *testing.T) {
 	assert.Equal(t, 500*time.Millisecond, *testCase.Duration())
 }
 
+func TestXMLResourceUsageRoundTrip(t *testing.T) {
+	suite := &core.TestSuite{
+		Name:       "suite",
+		Properties: map[string]string{"k": "v"},
+		ResourceUsage: process.ResourceUsage{
+			User:   1500 * time.Millisecond,
+			System: 250 * time.Millisecond,
+			MaxRSS: 1 << 30,
+		},
+	}
+	result := toCoreTestSuite(toXMLTestSuite(suite, false))
+	assert.Equal(t, suite.ResourceUsage, result.ResourceUsage)
+	assert.Equal(t, suite.Properties, result.Properties)
+}
+
 func TestUpload(t *testing.T) {
 	results := map[string][]byte{}
 	s := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
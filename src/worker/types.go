@@ -1,5 +1,9 @@
 package worker
 
+// TestWorkerEnvVar is set in the environment of a test binary that's started as a persistent worker.
+// It should read requests from stdin to run its tests, rather than running them all and exiting.
+const TestWorkerEnvVar = "PLZ_TEST_WORKER"
+
 // A Request is the message that's sent to a worker indicating that it should start a build.
 type Request struct {
 	// The label of the rule to build, i.e. //src/worker:worker
@@ -14,6 +18,8 @@ type Request struct {
 	Options []string `json:"opts"`
 	// True if this message relates to a test.
 	Test bool `json:"test"`
+	// Environment variables to run the test with, as KEY=VALUE. Only set for requests to persistent test workers.
+	Env []string `json:"env,omitempty"`
 }
 
 // A Response is sent back from the worker on completion.
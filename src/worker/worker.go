@@ -9,6 +9,7 @@ import (
 	"os/exec"
 	"strings"
 	"sync"
+	"time"
 
 	"gopkg.in/op/go-logging.v1"
 
@@ -26,6 +27,7 @@ type workerServer struct {
 	process       *exec.Cmd
 	stderr        *stderrLogger
 	state         *core.BuildState
+	name          string
 	closing       bool
 }
 
@@ -39,10 +41,31 @@ func BuildRemotely(state *core.BuildState, target *core.BuildTarget, worker stri
 }
 
 func buildRemotely(state *core.BuildState, target *core.BuildTarget, worker, msg string, req *Request) (*Response, error) {
-	w, err := getOrStartWorker(state, worker)
+	w, err := getOrStartWorker(state, worker, worker, nil)
 	if err != nil {
 		return nil, err
 	}
+	return w.send(state, target, req, target.BuildTimeout)
+}
+
+// RunTest runs a test using its own binary as a persistent worker, which is started if it isn't
+// already running. name identifies the worker process, so tests that can run concurrently
+// (e.g. different shards of one test) should use different names to get their own.
+// The worker is stopped if the test times out, since we can't tell what state it's been left in.
+func RunTest(state *core.BuildState, target *core.BuildTarget, name, binary string, req *Request) (*Response, error) {
+	w, err := getOrStartWorker(state, name, binary, []string{TestWorkerEnvVar + "=1"})
+	if err != nil {
+		return nil, err
+	}
+	resp, err := w.send(state, target, req, target.TestTimeout)
+	if err == context.DeadlineExceeded {
+		stop(name, w)
+	}
+	return resp, err
+}
+
+// send sends a single request to this worker and waits for its response.
+func (w *workerServer) send(state *core.BuildState, target *core.BuildTarget, req *Request, timeout time.Duration) (*Response, error) {
 	ch := make(chan *Response, 2)
 	w.responseMutex.Lock()
 	w.responses[req.Rule] = ch
@@ -55,7 +78,7 @@ func buildRemotely(state *core.BuildState, target *core.BuildTarget, worker, msg
 	}
 
 	// Time out this request appropriately
-	ctx, cancel := context.WithTimeout(context.Background(), target.BuildTimeout)
+	ctx, cancel := context.WithTimeout(context.Background(), timeout)
 	defer cancel()
 	w.requests <- req
 	select {
@@ -79,11 +102,11 @@ func EnsureWorkerStarted(state *core.BuildState, worker, test string, target *co
 	return resp, err
 }
 
-// getOrStartWorker either retrieves an existing worker process or starts a new one.
-func getOrStartWorker(state *core.BuildState, worker string) (*workerServer, error) {
+// getOrStartWorker either retrieves an existing worker process with the given name or starts a new one.
+func getOrStartWorker(state *core.BuildState, name, worker string, env []string) (*workerServer, error) {
 	workerMutex.Lock()
 	defer workerMutex.Unlock()
-	if w, present := workerMap[worker]; present {
+	if w, present := workerMap[name]; present {
 		return w, nil
 	}
 	// Need to create a new process
@@ -95,7 +118,7 @@ func getOrStartWorker(state *core.BuildState, worker string) (*workerServer, err
 		worker = path
 	}
 	cmd := state.ProcessExecutor.ExecCommand(process.NoSandbox, worker)
-	cmd.Env = core.GeneralBuildEnvironment(state)
+	cmd.Env = append(core.GeneralBuildEnvironment(state), env...)
 	stdin, err := cmd.StdinPipe()
 	if err != nil {
 		return nil, err
@@ -115,8 +138,9 @@ func getOrStartWorker(state *core.BuildState, worker string) (*workerServer, err
 		process:   cmd,
 		stderr:    stderr,
 		state:     state,
+		name:      name,
 	}
-	workerMap[worker] = w
+	workerMap[name] = w
 	go w.sendRequests(stdin)
 	go w.readResponses(stdout)
 	go w.wait()
@@ -170,6 +194,12 @@ func (w *workerServer) dispatchResponse(response *Response) {
 // wait waits for the process to terminate. If it dies unexpectedly this handles various failures.
 func (w *workerServer) wait() {
 	if err := w.process.Wait(); !w.closing {
+		// Forget about it so the next request starts a new one.
+		workerMutex.Lock()
+		if workerMap[w.name] == w {
+			delete(workerMap, w.name)
+		}
+		workerMutex.Unlock()
 		if err != nil {
 			log.Error("Worker process died unexpectedly: %s", err)
 		} else {
@@ -217,6 +247,19 @@ func (l *stderrLogger) Write(msg []byte) (int, error) {
 	return len(msg), nil
 }
 
+// stop stops a single worker process, if it's still the one running under that name.
+func stop(name string, w *workerServer) {
+	workerMutex.Lock()
+	defer workerMutex.Unlock()
+	if workerMap[name] == w {
+		log.Debug("Terminating worker %s", name)
+		delete(workerMap, name)
+	}
+	w.closing = true
+	w.stderr.Suppress = true
+	w.state.ProcessExecutor.KillProcess(w.process)
+}
+
 // StopAll stops any running worker processes.
 // This should be called before the process terminates to ensure they are all correctly cleaned up.
 func StopAll() {
@@ -0,0 +1,30 @@
+// Tests for cc_embed_file, which embeds files with .incbin (optionally compressed).
+
+#include <cstdint>
+#include <string>
+#include <UnitTest++/UnitTest++.h>
+#include "test/cc_rules/gcc/embedded_file_4.h"
+#include "test/cc_rules/gcc/embedded_file_5.h"
+
+namespace plz {
+
+TEST(EmbeddedFile4) {
+    CHECK_EQUAL(18ul, embedded_file_4_size());
+    CHECK_EQUAL("testing message 1\n", std::string(embedded_file_4_view()));
+    CHECK_EQUAL(embedded_file_4_start() + embedded_file_4_size(), embedded_file_4_end());
+}
+
+TEST(EmbeddedFile4Alignment) {
+    CHECK_EQUAL(64, EMBEDDED_FILE_4_ALIGNMENT);
+    CHECK_EQUAL(0ul, reinterpret_cast<uintptr_t>(embedded_file_4_start()) % EMBEDDED_FILE_4_ALIGNMENT);
+}
+
+// This one is decompressed when it's first used.
+TEST(EmbeddedFile5) {
+    CHECK_EQUAL(18ul, embedded_file_5_size());
+    CHECK_EQUAL("testing message 3\n", std::string(embedded_file_5_view()));
+    CHECK_EQUAL(embedded_file_5_start(), embedded_file_5_start());
+    CHECK_EQUAL(0ul, reinterpret_cast<uintptr_t>(embedded_file_5_start()) % EMBEDDED_FILE_5_ALIGNMENT);
+}
+
+}
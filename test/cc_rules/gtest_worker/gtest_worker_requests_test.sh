@@ -0,0 +1,31 @@
+#!/bin/sh
+# Sends two requests with different filters to one instance of the gtest worker, and checks that
+# each only ran the tests it asked for, so nothing from the first leaked into the second.
+set -eu
+
+BIN=test/cc_rules/gtest_worker/gtest_worker_bin
+DIR="$PWD"
+
+OUT="$(printf '%s\n%s\n' \
+    "{\"rule\":\"a\",\"temp_dir\":\"$DIR\",\"env\":[\"GTEST_FILTER=GTestWorker.Number1\",\"RESULTS_FILE=$DIR/a.xml\"]}" \
+    "{\"rule\":\"b\",\"temp_dir\":\"$DIR\",\"opts\":[\"--gtest_filter=GTestWorker.Number2\"],\"env\":[\"RESULTS_FILE=$DIR/b.xml\"]}" \
+    | PLZ_TEST_WORKER=1 "$BIN")"
+
+check() {
+    if ! echo "$1" | grep -q "$2"; then
+        echo "Expected $2 in: $1"
+        exit 1
+    elif echo "$1" | grep -q "$3"; then
+        echo "Didn't expect $3 in: $1"
+        exit 1
+    fi
+}
+
+A="$(echo "$OUT" | sed -n 1p)"
+B="$(echo "$OUT" | sed -n 2p)"
+check "$A" '"rule":"a","success":true' '"rule":"b"'
+check "$A" 'GTestWorker.Number1' 'GTestWorker.Number2'
+check "$B" '"rule":"b","success":true' '"rule":"a"'
+check "$B" 'GTestWorker.Number2' 'GTestWorker.Number1'
+check "$(cat a.xml)" 'Number1' 'Number2'
+check "$(cat b.xml)" 'Number2' 'Number1'
@@ -0,0 +1,18 @@
+// Test that runs under the persistent gtest worker main.
+
+#include "gtest/gtest.h"
+
+#include "test/cc_rules/lib1.h"
+#include "test/cc_rules/lib2.h"
+
+namespace plz {
+
+TEST(GTestWorker, Number1) {
+  EXPECT_EQ(107, get_number_1());
+}
+
+TEST(GTestWorker, Number2) {
+  EXPECT_EQ(215, get_number_2());
+}
+
+}
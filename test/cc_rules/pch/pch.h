@@ -0,0 +1,16 @@
+#ifndef TEST_CC_RULES_PCH_PCH_H
+#define TEST_CC_RULES_PCH_PCH_H
+
+#include <map>
+#include <string>
+
+namespace plz {
+
+inline int pch_number() {
+    std::map<std::string, int> m{{"pch", 42}};
+    return m["pch"];
+}
+
+}
+
+#endif  // TEST_CC_RULES_PCH_PCH_H
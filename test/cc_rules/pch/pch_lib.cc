@@ -0,0 +1,10 @@
+// Deliberately doesn't include pch.h; it should be included implicitly.
+#include "test/cc_rules/pch/pch_lib.h"
+
+namespace plz {
+
+int get_pch_number() {
+    return pch_number();
+}
+
+}
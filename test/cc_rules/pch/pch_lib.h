@@ -0,0 +1,10 @@
+#ifndef TEST_CC_RULES_PCH_PCH_LIB_H
+#define TEST_CC_RULES_PCH_PCH_LIB_H
+
+namespace plz {
+
+int get_pch_number();
+
+}
+
+#endif  // TEST_CC_RULES_PCH_PCH_LIB_H
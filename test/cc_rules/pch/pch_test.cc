@@ -0,0 +1,15 @@
+#include <UnitTest++/UnitTest++.h>
+#include "test/cc_rules/pch/pch_lib.h"
+
+namespace plz {
+
+TEST(LibraryUsesPrecompiledHeader) {
+    CHECK_EQUAL(42, get_pch_number());
+}
+
+TEST(DependentsUsePrecompiledHeader) {
+    // pch.h is not included here either.
+    CHECK_EQUAL(42, pch_number());
+}
+
+}
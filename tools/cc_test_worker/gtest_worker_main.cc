@@ -0,0 +1,335 @@
+// A main for googletest tests which can also be kept running by Please as a persistent worker.
+//
+// When $PLZ_TEST_WORKER is set, instead of running the tests once it reads requests from stdin
+// (one JSON object per line, as described in src/worker/types.go) and runs the tests for each,
+// in the given directory and environment, so later runs skip starting the binary and running
+// its static initialisers again. Otherwise it behaves exactly like gtest_main.
+//
+// Each request calls RUN_ALL_TESTS() again in the same process, which googletest doesn't formally
+// support; in practice it reruns the selected tests much like --gtest_repeat does, with each test's
+// fixture and each suite's SetUpTestSuite / TearDownTestSuite run afresh. Anything else the tests
+// keep in static or global state persists between requests though, so only tests that would also
+// pass with --gtest_repeat should use this.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace plz {
+
+// A Request is the subset of the worker request that we use.
+struct Request {
+  std::string rule;
+  std::string temp_dir;
+  std::vector<std::string> opts;
+  std::vector<std::string> env;
+};
+
+// A very small JSON reader; it only needs to understand the requests that Please sends us.
+class Reader {
+ public:
+  explicit Reader(const std::string& s) : s_(s), i_(0) {}
+
+  bool ReadRequest(Request* req) {
+    if (!Accept('{')) return false;
+    if (Peek() == '}') return Accept('}');
+    do {
+      std::string key;
+      if (!ReadString(&key) || !Accept(':')) return false;
+      bool ok;
+      if (key == "rule") {
+        ok = ReadString(&req->rule);
+      } else if (key == "temp_dir") {
+        ok = ReadString(&req->temp_dir);
+      } else if (key == "opts") {
+        ok = ReadStrings(&req->opts);
+      } else if (key == "env") {
+        ok = ReadStrings(&req->env);
+      } else {
+        ok = Skip();
+      }
+      if (!ok) return false;
+    } while (Accept(','));
+    return Accept('}');
+  }
+
+ private:
+  char Peek() {
+    while (i_ < s_.size() && isspace(s_[i_])) ++i_;
+    return i_ < s_.size() ? s_[i_] : '\0';
+  }
+
+  bool Accept(char c) {
+    if (Peek() != c) return false;
+    ++i_;
+    return true;
+  }
+
+  bool ReadLiteral(const char* lit) {
+    Peek();
+    for (; *lit; ++lit, ++i_) {
+      if (i_ >= s_.size() || s_[i_] != *lit) return false;
+    }
+    return true;
+  }
+
+  bool ReadString(std::string* out) {
+    if (!Accept('"')) return false;
+    out->clear();
+    while (i_ < s_.size()) {
+      char c = s_[i_++];
+      if (c == '"') return true;
+      if (c != '\\') {
+        out->push_back(c);
+        continue;
+      } else if (i_ >= s_.size()) {
+        return false;
+      }
+      switch (c = s_[i_++]) {
+        case 'b': out->push_back('\b'); break;
+        case 'f': out->push_back('\f'); break;
+        case 'n': out->push_back('\n'); break;
+        case 'r': out->push_back('\r'); break;
+        case 't': out->push_back('\t'); break;
+        case 'u': {
+          uint32_t cp;
+          if (!ReadHex(&cp)) return false;
+          if (cp >= 0xD800 && cp < 0xDC00) {
+            uint32_t low;
+            if (!ReadLiteral("\\u") || !ReadHex(&low)) return false;
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          }
+          AppendUTF8(cp, out);
+          break;
+        }
+        default: out->push_back(c); break;
+      }
+    }
+    return false;
+  }
+
+  bool ReadHex(uint32_t* out) {
+    if (i_ + 4 > s_.size()) return false;
+    *out = std::stoul(s_.substr(i_, 4), nullptr, 16);
+    i_ += 4;
+    return true;
+  }
+
+  static void AppendUTF8(uint32_t cp, std::string* out) {
+    if (cp < 0x80) {
+      out->push_back(cp);
+    } else if (cp < 0x800) {
+      out->push_back(0xC0 | (cp >> 6));
+      out->push_back(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+      out->push_back(0xE0 | (cp >> 12));
+      out->push_back(0x80 | ((cp >> 6) & 0x3F));
+      out->push_back(0x80 | (cp & 0x3F));
+    } else {
+      out->push_back(0xF0 | (cp >> 18));
+      out->push_back(0x80 | ((cp >> 12) & 0x3F));
+      out->push_back(0x80 | ((cp >> 6) & 0x3F));
+      out->push_back(0x80 | (cp & 0x3F));
+    }
+  }
+
+  bool ReadStrings(std::vector<std::string>* out) {
+    out->clear();
+    if (Peek() == 'n') return ReadLiteral("null");
+    if (!Accept('[')) return false;
+    if (Accept(']')) return true;
+    do {
+      out->emplace_back();
+      if (!ReadString(&out->back())) return false;
+    } while (Accept(','));
+    return Accept(']');
+  }
+
+  // Skip skips over a value of any type that we aren't interested in.
+  bool Skip() {
+    std::string ignored;
+    switch (Peek()) {
+      case '"': return ReadString(&ignored);
+      case '[':
+        ++i_;
+        if (Accept(']')) return true;
+        do {
+          if (!Skip()) return false;
+        } while (Accept(','));
+        return Accept(']');
+      case '{':
+        ++i_;
+        if (Accept('}')) return true;
+        do {
+          if (!ReadString(&ignored) || !Accept(':') || !Skip()) return false;
+        } while (Accept(','));
+        return Accept('}');
+      case 't': return ReadLiteral("true");
+      case 'f': return ReadLiteral("false");
+      case 'n': return ReadLiteral("null");
+      default:
+        while (i_ < s_.size() && strchr("+-.0123456789eE", s_[i_])) ++i_;
+        return true;
+    }
+  }
+
+  const std::string& s_;
+  size_t i_;
+};
+
+std::string Quote(const std::string& s) {
+  std::string out = "\"";
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out + "\"";
+}
+
+std::string ReadFile(const std::string& filename) {
+  std::ifstream f(filename, std::ios::binary);
+  std::stringstream ss;
+  ss << f.rdbuf();
+  return ss.str();
+}
+
+// Worker runs the tests repeatedly on request.
+class Worker {
+ public:
+  Worker() {
+    // Our stdout is for responses only, so anything else that gets written to it goes to stderr.
+    responses_ = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    // googletest only decides where to write its XML once, so we have it write to a fixed
+    // file of our own and copy that to where each request wants it afterwards.
+    char dir[] = "/tmp/plz_gtest_worker_XXXXXX";
+    if (mkdtemp(dir)) {
+      results_file_ = std::string(dir) + "/test.results";
+      ::testing::GTEST_FLAG(output) = "xml:" + results_file_;
+    }
+  }
+
+  int Run() {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+      Request req;
+      if (!Reader(line).ReadRequest(&req)) {
+        std::cerr << "Failed to parse request: " << line << std::endl;
+        return 1;
+      }
+      std::string output;
+      const bool success = RunTests(req, &output);
+      fprintf(responses_, "{\"rule\":%s,\"success\":%s,\"messages\":[%s]}\n",
+              Quote(req.rule).c_str(), success ? "true" : "false", Quote(output).c_str());
+      fflush(responses_);
+    }
+    unlink(results_file_.c_str());
+    rmdir(results_file_.substr(0, results_file_.rfind('/')).c_str());
+    return 0;
+  }
+
+ private:
+  bool RunTests(const Request& req, std::string* output) {
+    // Anything the last request set shouldn't leak into this one.
+    for (const std::string& name : env_) {
+      unsetenv(name.c_str());
+    }
+    env_.clear();
+    for (const std::string& var : req.env) {
+      const size_t eq = var.find('=');
+      if (eq != std::string::npos) {
+        env_.push_back(var.substr(0, eq));
+        setenv(env_.back().c_str(), var.substr(eq + 1).c_str(), 1);
+      }
+    }
+    if (chdir(req.temp_dir.c_str()) != 0) {
+      *output = "Failed to change to test directory " + req.temp_dir;
+      return false;
+    }
+    const char* filter = getenv("GTEST_FILTER");
+    ::testing::GTEST_FLAG(filter) = filter ? filter : "*";
+    ::testing::GTEST_FLAG(also_run_disabled_tests) = false;
+    for (const std::string& opt : req.opts) {
+      if (opt.rfind("--gtest_filter=", 0) == 0) {
+        ::testing::GTEST_FLAG(filter) = opt.substr(strlen("--gtest_filter="));
+      } else if (opt == "--gtest_also_run_disabled_tests") {
+        ::testing::GTEST_FLAG(also_run_disabled_tests) = true;
+      }
+    }
+    unlink(results_file_.c_str());
+
+    // Capture everything the tests write while they run.
+    FILE* capture = tmpfile();
+    if (!capture) {
+      *output = std::string("Failed to create a file to capture the tests' output: ") + strerror(errno);
+      return false;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    const int saved_stderr = dup(STDERR_FILENO);
+    dup2(fileno(capture), STDOUT_FILENO);
+    dup2(fileno(capture), STDERR_FILENO);
+    const int result = RUN_ALL_TESTS();
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+    dup2(saved_stderr, STDOUT_FILENO);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+
+    rewind(capture);
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), capture)) > 0;) {
+      output->append(buf, n);
+    }
+    fclose(capture);
+
+    const char* results = getenv("RESULTS_FILE");
+    if (results && !results_file_.empty()) {
+      std::ofstream(results, std::ios::binary) << ReadFile(results_file_);
+    }
+    return result == 0;
+  }
+
+  FILE* responses_;
+  std::string results_file_;
+  std::vector<std::string> env_;
+};
+
+}  // namespace plz
+
+int main(int argc, char** argv) {
+  if (!getenv("PLZ_TEST_WORKER")) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+  }
+  // Anything the tests start (e.g. re-executing this binary for threadsafe death tests) runs normally.
+  unsetenv("PLZ_TEST_WORKER");
+  // The worker has to be set up first since googletest reads some of its flags during initialisation.
+  plz::Worker worker;
+  testing::InitGoogleTest(&argc, argv);
+  return worker.Run();
+}
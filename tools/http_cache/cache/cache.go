@@ -34,7 +34,7 @@ func (c *Cache) ServeHTTP(resp http.ResponseWriter, req *http.Request) {
 			resp.WriteHeader(http.StatusInternalServerError)
 			_, _ = resp.Write([]byte(fmt.Sprintf("failed to store in cache: %v", err)))
 		}
-	} else if req.Method == http.MethodGet {
+	} else if req.Method == http.MethodGet || req.Method == http.MethodHead {
 		http.ServeFile(resp, req, filepath.Join(c.Dir, uri))
 	}
 }
@@ -24,7 +24,8 @@ var mtime = time.Date(2000, time.January, 1, 0, 0, 0, 0, time.UTC)
 // Create creates a new ar archive from the given sources.
 // If combine is true they are treated as existing ar files and combined.
 // If rename is true the srcs are renamed as gcc would (i.e. the extension is replaced by .o).
-func Create(srcs []string, out string, combine, rename bool) error {
+// If index is true a symbol index is written into it, which is always a GNU-style archive.
+func Create(srcs []string, out string, combine, rename, index bool) error {
 	// Rename the sources as gcc would.
 	if rename {
 		for i, src := range srcs {
@@ -37,6 +38,19 @@ func Create(srcs []string, out string, combine, rename bool) error {
 		}
 	}
 
+	// Any thin archives are replaced by whatever they refer to, since we're writing a full one.
+	plain := map[string]bool{}
+	if combine {
+		expanded, err := expandThinArchives(srcs, plain)
+		if err != nil {
+			return err
+		}
+		srcs = expanded
+	}
+	if index {
+		return createIndexed(srcs, out, combine, plain)
+	}
+
 	log.Debug("Writing ar to %s", out)
 	f, err := os.Create(out)
 	if err != nil {
@@ -52,7 +66,7 @@ func Create(srcs []string, out string, combine, rename bool) error {
 			return err
 		}
 	} else {
-		if err := w.WriteGlobalHeaderForLongFiles(allSourceNames(srcs, combine)); err != nil {
+		if err := w.WriteGlobalHeaderForLongFiles(allSourceNames(srcs, combine, plain)); err != nil {
 			return err
 		}
 	}
@@ -62,7 +76,7 @@ func Create(srcs []string, out string, combine, rename bool) error {
 		if err != nil {
 			return err
 		}
-		if combine {
+		if combine && !plain[src] {
 			// Read archive & write its contents in
 			r := ar.NewReader(f)
 			for {
@@ -95,8 +109,12 @@ func Create(srcs []string, out string, combine, rename bool) error {
 			if err != nil {
 				return err
 			}
+			name := src
+			if plain[src] {
+				name = path.Base(src)
+			}
 			hdr := &ar.Header{
-				Name:    src,
+				Name:    name,
 				ModTime: mtime,
 				Mode:    int64(info.Mode()),
 				Size:    info.Size(),
@@ -124,13 +142,40 @@ func Find() ([]string, error) {
 	})
 }
 
+// expandThinArchives replaces any thin archives in the given sources with the archives and files
+// they refer to. The latter are added to the given set.
+func expandThinArchives(srcs []string, plain map[string]bool) ([]string, error) {
+	ret := make([]string, 0, len(srcs))
+	for _, src := range srcs {
+		if !isThin(src) {
+			ret = append(ret, src)
+			continue
+		}
+		archives, files, err := expandThin(src)
+		if err != nil {
+			return nil, err
+		}
+		log.Debug("expanded thin archive %s to %s %s", src, archives, files)
+		ret = append(ret, archives...)
+		ret = append(ret, files...)
+		for _, file := range files {
+			plain[file] = true
+		}
+	}
+	return ret, nil
+}
+
 // allSourceNames returns the name of all source files that we will add to the archive.
-func allSourceNames(srcs []string, combine bool) []string {
+func allSourceNames(srcs []string, combine bool, plain map[string]bool) []string {
 	if !combine {
 		return srcs
 	}
 	ret := []string{}
 	for _, src := range srcs {
+		if plain[src] {
+			ret = append(ret, path.Base(src))
+			continue
+		}
 		f, err := os.Open(src)
 		if err == nil {
 			r := ar.NewReader(f)
@@ -141,6 +186,7 @@ func allSourceNames(srcs []string, combine bool) []string {
 				}
 				ret = append(ret, hdr.Name)
 			}
+			f.Close()
 		}
 	}
 	return ret
@@ -0,0 +1,56 @@
+package ar
+
+import (
+	"fmt"
+	"os"
+	"testing"
+)
+
+// setupCombine writes a set of archives to combine, roughly modelled on a cc_static_library of a
+// few hundred libraries with a couple of dozen objects each.
+func setupCombine(b *testing.B) []string {
+	obj, err := os.ReadFile("tools/jarcat/ar/test_data/indexed.o")
+	if err != nil {
+		b.Fatalf("%s", err)
+	}
+	// Pad them out a bit so they're closer to the size of real objects.
+	obj = append(obj, make([]byte, 32*1024)...)
+	if err := os.MkdirAll("combine_benchmark", 0755); err != nil {
+		b.Fatalf("%s", err)
+	}
+	srcs := make([]string, 200)
+	for i := range srcs {
+		objs := make([]string, 20)
+		for j := range objs {
+			objs[j] = fmt.Sprintf("combine_benchmark/%d_%d.o", i, j)
+			if err := os.WriteFile(objs[j], obj, 0644); err != nil {
+				b.Fatalf("%s", err)
+			}
+		}
+		srcs[i] = fmt.Sprintf("combine_benchmark/%d.a", i)
+		if err := Create(objs, srcs[i], false, false, true); err != nil {
+			b.Fatalf("%s", err)
+		}
+	}
+	return srcs
+}
+
+func BenchmarkCombine(b *testing.B) {
+	srcs := setupCombine(b)
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if err := Create(srcs, "combine_benchmark/out.a", true, false, false); err != nil {
+			b.Fatalf("%s", err)
+		}
+	}
+}
+
+func BenchmarkCombineIndexed(b *testing.B) {
+	srcs := setupCombine(b)
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		if err := Create(srcs, "combine_benchmark/out.a", true, false, true); err != nil {
+			b.Fatalf("%s", err)
+		}
+	}
+}
@@ -0,0 +1,334 @@
+package ar
+
+import (
+	"bytes"
+	"debug/elf"
+	"encoding/binary"
+	"fmt"
+	"math"
+	"os"
+	"path"
+	"runtime"
+	"strconv"
+	"strings"
+	"sync"
+	"syscall"
+)
+
+// A member is a single file within an archive that we're writing.
+type member struct {
+	// The name of the member, and the name we write into its header (which may refer to the long name table).
+	Name, HeaderName string
+	// The file containing the member's contents, and their offset & size within it.
+	Src          string
+	Offset, Size int64
+}
+
+// createIndexed writes a GNU-style archive of the given sources, which begins with a symbol index of
+// everything that they define. This is equivalent to what ranlib (or ar s) would write afterwards.
+func createIndexed(srcs []string, out string, combine bool, plain map[string]bool) error {
+	files := newFileCache()
+	defer files.Close()
+	if err := files.Map(srcs); err != nil {
+		return err
+	}
+	members := make([][]member, len(srcs))
+	if err := parallel(len(srcs), func(i int) error {
+		src := srcs[i]
+		if combine && !plain[src] {
+			ms, err := readMembers(src, files.Get(src))
+			members[i] = ms
+			return err
+		}
+		name := src
+		if plain[src] {
+			name = path.Base(src)
+		}
+		members[i] = []member{{Name: name, Src: src, Size: int64(len(files.Get(src)))}}
+		return nil
+	}); err != nil {
+		return err
+	}
+	var all []member
+	var names bytes.Buffer
+	for _, ms := range members {
+		for _, m := range ms {
+			if len(m.Name) < 16 && !strings.ContainsAny(m.Name, "/ ") {
+				m.HeaderName = m.Name + "/"
+			} else {
+				m.HeaderName = "/" + strconv.Itoa(names.Len())
+				names.WriteString(m.Name + "/\n")
+			}
+			all = append(all, m)
+		}
+	}
+	return writeIndexed(files, out, arMagic, names.Bytes(), all, false)
+}
+
+// writeIndexed writes an archive with a symbol index of the given members, whose sources must already be
+// mapped into the given cache. If thin is true, their contents aren't written, only their headers.
+func writeIndexed(files *fileCache, out, magic string, names []byte, members []member, thin bool) error {
+	symbols := make([][]string, len(members))
+	if err := parallel(len(members), func(i int) error {
+		m := members[i]
+		syms, err := memberSymbols(files.Get(m.Src)[m.Offset : m.Offset+m.Size])
+		if err != nil {
+			return fmt.Errorf("failed to read symbols from %s in %s: %w", m.Name, m.Src, err)
+		}
+		symbols[i] = syms
+		return nil
+	}); err != nil {
+		return err
+	}
+	numSymbols := 0
+	symtabSize := int64(4)
+	for _, syms := range symbols {
+		numSymbols += len(syms)
+		for _, sym := range syms {
+			symtabSize += 4 + int64(len(sym)) + 1
+		}
+	}
+	// Now we know how big the symbol table is, we know where each member will be written to.
+	var prelude bytes.Buffer
+	prelude.WriteString(magic)
+	prelude.WriteString(formatHeader("/", 0, symtabSize))
+	offset := int64(prelude.Len()) + symtabSize + symtabSize%2
+	if len(names) > 0 {
+		offset += headerSize + int64(len(names)) + int64(len(names)%2)
+	}
+	offsets := make([]int64, len(members))
+	for i, m := range members {
+		if offset > math.MaxUint32 {
+			return fmt.Errorf("archive is too large to index")
+		} else if len(m.HeaderName) > 16 {
+			return fmt.Errorf("archive is too large to refer to member %s", m.HeaderName)
+		}
+		offsets[i] = offset
+		offset += headerSize
+		if !thin {
+			offset += m.Size + m.Size%2
+		}
+	}
+	binary.Write(&prelude, binary.BigEndian, uint32(numSymbols))
+	for i, syms := range symbols {
+		for range syms {
+			binary.Write(&prelude, binary.BigEndian, uint32(offsets[i]))
+		}
+	}
+	for _, syms := range symbols {
+		for _, sym := range syms {
+			prelude.WriteString(sym)
+			prelude.WriteByte(0)
+		}
+	}
+	if symtabSize%2 == 1 {
+		prelude.WriteByte(0)
+	}
+	if len(names) > 0 {
+		// The name table only has a name and a size; the other fields are left blank.
+		fmt.Fprintf(&prelude, "%-48s%-10d`\n", "//", len(names))
+		prelude.Write(names)
+		if len(names)%2 == 1 {
+			prelude.WriteByte('\n')
+		}
+	}
+
+	// Everything is written into the output through a single mapping of it, so each member can be
+	// copied in independently once we know where it's going.
+	log.Debug("Writing ar to %s with %d members and %d symbols", out, len(members), numSymbols)
+	f, err := os.Create(out)
+	if err != nil {
+		return err
+	}
+	defer f.Close()
+	if err := f.Truncate(offset); err != nil {
+		return err
+	}
+	buf, err := syscall.Mmap(int(f.Fd()), 0, int(offset), syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED)
+	if err != nil {
+		return fmt.Errorf("failed to map %s: %w", out, err)
+	}
+	copy(buf, prelude.Bytes())
+	parallel(len(members), func(i int) error {
+		m := members[i]
+		start := offsets[i]
+		copy(buf[start:], formatHeader(m.HeaderName, 0644, m.Size))
+		if !thin {
+			start += headerSize
+			copy(buf[start:start+m.Size], files.Get(m.Src)[m.Offset:m.Offset+m.Size])
+			if m.Size%2 == 1 {
+				buf[start+m.Size] = '\n'
+			}
+		}
+		return nil
+	})
+	if err := syscall.Munmap(buf); err != nil {
+		return err
+	}
+	return f.Close()
+}
+
+// formatHeader returns the header for a single member of an archive.
+func formatHeader(name string, mode, size int64) string {
+	return fmt.Sprintf("%-16s%-12d%-6d%-6d%-8o%-10d`\n", name, mtime.Unix(), 0, 0, mode, size)
+}
+
+// readMembers returns all the members of an existing (non-thin) archive, excluding its symbol & name tables.
+func readMembers(filename string, data []byte) ([]member, error) {
+	if !bytes.HasPrefix(data, []byte(arMagic)) {
+		return nil, fmt.Errorf("%s is not an ar archive", filename)
+	}
+	var members []member
+	var names []byte
+	offset := int64(len(arMagic))
+	for offset < int64(len(data)) {
+		if offset+headerSize > int64(len(data)) {
+			return nil, fmt.Errorf("failed to read %s: truncated header", filename)
+		}
+		name, size, err := parseHeader(data[offset : offset+headerSize])
+		if err != nil {
+			return nil, fmt.Errorf("failed to read %s: %w", filename, err)
+		}
+		offset += headerSize
+		next := offset + size + size%2
+		if offset+size > int64(len(data)) {
+			return nil, fmt.Errorf("failed to read %s: truncated member %s", filename, name)
+		} else if name == "//" {
+			names = data[offset : offset+size]
+			offset = next
+			continue
+		} else if strings.HasPrefix(name, "#1/") {
+			// BSD-style names are written at the start of the contents.
+			n, err := strconv.Atoi(name[3:])
+			if err != nil || int64(n) > size {
+				return nil, fmt.Errorf("invalid member name %s in %s", name, filename)
+			}
+			name = strings.TrimRight(string(data[offset:offset+int64(n)]), "\x00")
+			offset += int64(n)
+			size -= int64(n)
+		} else if !isSymbolTable(name) {
+			if name, _, err = thinMemberName(name, names); err != nil {
+				return nil, fmt.Errorf("invalid member in %s: %w", filename, err)
+			}
+		}
+		if !isSymbolTable(name) {
+			members = append(members, member{Name: name, Src: filename, Offset: offset, Size: size})
+		}
+		offset = next
+	}
+	return members, nil
+}
+
+// memberSymbols returns the names of all the global symbols that the given archive member defines.
+// Anything that isn't an ELF object (e.g. LLVM bitcode) is assumed not to define any.
+func memberSymbols(data []byte) ([]string, error) {
+	if !bytes.HasPrefix(data, []byte(elf.ELFMAG)) {
+		return nil, nil
+	}
+	f, err := elf.NewFile(bytes.NewReader(data))
+	if err != nil {
+		return nil, err
+	}
+	syms, err := f.Symbols()
+	if err == elf.ErrNoSymbols {
+		return nil, nil
+	} else if err != nil {
+		return nil, err
+	}
+	ret := []string{}
+	for _, sym := range syms {
+		// STB_LOOS is STB_GNU_UNIQUE, which GNU ar also indexes.
+		if bind := elf.ST_BIND(sym.Info); (bind == elf.STB_GLOBAL || bind == elf.STB_WEAK || bind == elf.STB_LOOS) && sym.Section != elf.SHN_UNDEF && sym.Name != "" {
+			ret = append(ret, sym.Name)
+		}
+	}
+	return ret, nil
+}
+
+// parallel calls f for each integer in [0, n) across as many goroutines as there are CPUs.
+// It returns the first error encountered, if any.
+func parallel(n int, f func(i int) error) error {
+	workers := runtime.NumCPU()
+	if workers > n {
+		workers = n
+	}
+	ch := make(chan int, n)
+	for i := 0; i < n; i++ {
+		ch <- i
+	}
+	close(ch)
+	var wg sync.WaitGroup
+	var once sync.Once
+	var err error
+	wg.Add(workers)
+	for i := 0; i < workers; i++ {
+		go func() {
+			defer wg.Done()
+			for j := range ch {
+				if e := f(j); e != nil {
+					once.Do(func() { err = e })
+				}
+			}
+		}()
+	}
+	wg.Wait()
+	return err
+}
+
+// A fileCache holds the contents of files mapped into memory while we read members out of them.
+type fileCache struct {
+	files map[string][]byte
+}
+
+func newFileCache() *fileCache {
+	return &fileCache{files: map[string][]byte{}}
+}
+
+// Map maps all the given files into memory. It is not safe to call concurrently.
+func (c *fileCache) Map(filenames []string) error {
+	for _, filename := range filenames {
+		if _, present := c.files[filename]; present {
+			continue
+		}
+		data, err := mmap(filename)
+		if err != nil {
+			return err
+		}
+		c.files[filename] = data
+	}
+	return nil
+}
+
+// Get returns the contents of a file, which must have already been mapped.
+func (c *fileCache) Get(filename string) []byte {
+	return c.files[filename]
+}
+
+// Close unmaps all the files.
+func (c *fileCache) Close() {
+	for _, data := range c.files {
+		if len(data) > 0 {
+			syscall.Munmap(data)
+		}
+	}
+}
+
+// mmap maps the contents of a file into memory, read-only.
+func mmap(filename string) ([]byte, error) {
+	f, err := os.Open(filename)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+	info, err := f.Stat()
+	if err != nil {
+		return nil, err
+	} else if info.Size() == 0 {
+		return nil, nil // Can't map empty files
+	}
+	data, err := syscall.Mmap(int(f.Fd()), 0, int(info.Size()), syscall.PROT_READ, syscall.MAP_SHARED)
+	if err != nil {
+		return nil, fmt.Errorf("failed to map %s: %w", filename, err)
+	}
+	return data, nil
+}
@@ -0,0 +1,61 @@
+package ar
+
+import (
+	"bytes"
+	"encoding/binary"
+	"fmt"
+	"os"
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+const testObject = "tools/jarcat/ar/test_data/indexed.o"
+
+func TestCreateIndexed(t *testing.T) {
+	writeArchive(t, "test_index_other.a", "a.txt", "abc")
+	err := createIndexed([]string{testObject, "test_index_other.a"}, "test_index.a", true, map[string]bool{testObject: true})
+	require.NoError(t, err)
+
+	b, err := os.ReadFile("test_index.a")
+	require.NoError(t, err)
+	members, err := readMembers("test_index.a", b)
+	require.NoError(t, err)
+	require.Equal(t, 2, len(members))
+	assert.Equal(t, "indexed.o", members[0].Name)
+	assert.Equal(t, "a.txt", members[1].Name)
+
+	// The symbol table should contain each global symbol defined in the object, referring to its header.
+	name, size, err := readHeader(bytes.NewReader(b[len(arMagic):]))
+	require.NoError(t, err)
+	assert.Equal(t, "/", name)
+	symtab := b[len(arMagic)+headerSize : len(arMagic)+headerSize+int(size)]
+	n := int(binary.BigEndian.Uint32(symtab))
+	require.Equal(t, 4, n)
+	for i := 0; i < n; i++ {
+		assert.EqualValues(t, members[0].Offset-headerSize, binary.BigEndian.Uint32(symtab[4+4*i:]))
+	}
+	assert.ElementsMatch(t, []string{"defined_func", "defined_var", "weak_func", "calls"}, strings.Split(strings.TrimRight(string(symtab[4+4*n:]), "\x00"), "\x00"))
+}
+
+func TestCreateThinIndexed(t *testing.T) {
+	require.NoError(t, os.MkdirAll("test_thin_indexed", 0755))
+	err := createIndexed([]string{testObject}, "test_thin_indexed/_lib#a.ar", false, map[string]bool{testObject: true})
+	require.NoError(t, err)
+	err = CreateThin([]string{"test_thin_indexed/_lib#a.ar"}, "test_thin_indexed/lib.a")
+	require.NoError(t, err)
+
+	b, err := os.ReadFile("test_thin_indexed/_lib#a.ar")
+	require.NoError(t, err)
+	members, err := readMembers("test_thin_indexed/_lib#a.ar", b)
+	require.NoError(t, err)
+	// The symbols should refer to the member's header in the thin archive, which comes after the name table.
+	b, err = os.ReadFile("test_thin_indexed/lib.a")
+	require.NoError(t, err)
+	symtab := b[len(thinMagic)+headerSize:]
+	require.Equal(t, uint32(4), binary.BigEndian.Uint32(symtab))
+	offset := binary.BigEndian.Uint32(symtab[4:])
+	assert.Equal(t, fmt.Sprintf("%-16s", fmt.Sprintf("/0:%d", members[0].Offset-headerSize)), string(b[offset:offset+16]))
+}
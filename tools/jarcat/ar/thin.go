@@ -0,0 +1,164 @@
+package ar
+
+import (
+	"bufio"
+	"bytes"
+	"fmt"
+	"io"
+	"os"
+	"path/filepath"
+	"strconv"
+	"strings"
+)
+
+// These are the magic strings at the start of a regular & a thin (GNU-style) ar archive.
+const (
+	arMagic   = "!<arch>\n"
+	thinMagic = "!<thin>\n"
+)
+
+// headerSize is the size of the header preceding each member of an archive.
+const headerSize = 60
+
+// CreateThin creates a new thin archive from the given ar files. Rather than copying the contents
+// of their members, it refers to them by their offsets within the source archives, whose paths are
+// recorded relative to the output; they must therefore stay alongside it.
+func CreateThin(srcs []string, out string) error {
+	files := newFileCache()
+	defer files.Close()
+	if err := files.Map(srcs); err != nil {
+		return err
+	}
+	var names bytes.Buffer
+	var members []member
+	for _, src := range srcs {
+		log.Debug("ar source file: %s", src)
+		rel, err := filepath.Rel(filepath.Dir(out), src)
+		if err != nil {
+			return err
+		}
+		ms, err := readMembers(src, files.Get(src))
+		if err != nil {
+			return err
+		}
+		nameOffset := names.Len()
+		names.WriteString(rel + "/\n")
+		for _, m := range ms {
+			// This refers to the member's header, not its contents.
+			m.HeaderName = fmt.Sprintf("/%d:%d", nameOffset, m.Offset-headerSize)
+			members = append(members, m)
+		}
+	}
+	return writeIndexed(files, out, thinMagic, names.Bytes(), members, true)
+}
+
+// readHeader reads a member header from an archive and returns its name and size.
+func readHeader(r io.Reader) (string, int64, error) {
+	var hdr [headerSize]byte
+	if _, err := io.ReadFull(r, hdr[:]); err == io.ErrUnexpectedEOF {
+		return "", 0, fmt.Errorf("truncated header")
+	} else if err != nil {
+		return "", 0, err
+	}
+	return parseHeader(hdr[:])
+}
+
+// parseHeader parses a member header and returns its name and size.
+func parseHeader(hdr []byte) (string, int64, error) {
+	if string(hdr[58:]) != "`\n" {
+		return "", 0, fmt.Errorf("invalid header")
+	}
+	size, err := strconv.ParseInt(strings.TrimSpace(string(hdr[48:58])), 10, 64)
+	if err != nil {
+		return "", 0, fmt.Errorf("invalid member size: %w", err)
+	}
+	return strings.TrimRight(string(hdr[:16]), " "), size, nil
+}
+
+// isSymbolTable returns true if the given member name is that of an archive's symbol table.
+func isSymbolTable(name string) bool {
+	return name == "/" || name == "/SYM64/" || name == "__.SYMDEF SORTED" || name == "__.SYMDEF"
+}
+
+// isThin returns true if the given file is a thin archive.
+func isThin(filename string) bool {
+	f, err := os.Open(filename)
+	if err != nil {
+		return false
+	}
+	defer f.Close()
+	var magic [len(thinMagic)]byte
+	_, err = io.ReadFull(f, magic[:])
+	return err == nil && string(magic[:]) == thinMagic
+}
+
+// expandThin returns the files that a thin archive refers to, relative to the current directory.
+// Archives that it refers to members of are returned first, and files it refers to directly second.
+func expandThin(filename string) ([]string, []string, error) {
+	f, err := os.Open(filename)
+	if err != nil {
+		return nil, nil, err
+	}
+	defer f.Close()
+	r := bufio.NewReader(f)
+	if _, err := r.Discard(len(thinMagic)); err != nil {
+		return nil, nil, err
+	}
+	dir := filepath.Dir(filename)
+	var names []byte
+	var archives, files []string
+	seen := map[string]bool{}
+	for {
+		name, size, err := readHeader(r)
+		if err == io.EOF {
+			return archives, files, nil
+		} else if err != nil {
+			return nil, nil, fmt.Errorf("failed to read %s: %w", filename, err)
+		}
+		// Only the symbol & name tables have any contents.
+		if isSymbolTable(name) || name == "//" {
+			data := make([]byte, size+size%2)
+			if _, err := io.ReadFull(r, data); err != nil {
+				return nil, nil, fmt.Errorf("failed to read %s: %w", filename, err)
+			}
+			if name == "//" {
+				names = data
+			}
+			continue
+		}
+		member, nested, err := thinMemberName(name, names)
+		if err != nil {
+			return nil, nil, fmt.Errorf("invalid member in %s: %w", filename, err)
+		}
+		member = filepath.Join(dir, member)
+		if !nested {
+			files = append(files, member)
+		} else if !seen[member] {
+			seen[member] = true
+			archives = append(archives, member)
+		}
+	}
+}
+
+// thinMemberName returns the path that a member of a thin archive refers to, and whether it is
+// a member of another archive (i.e. the name is of the form /<name offset>:<member offset>).
+func thinMemberName(name string, names []byte) (string, bool, error) {
+	if !strings.HasPrefix(name, "/") {
+		return strings.TrimSuffix(name, "/"), false, nil
+	}
+	name = strings.TrimPrefix(name, "/")
+	nested := false
+	if idx := strings.IndexByte(name, ':'); idx != -1 {
+		name = name[:idx]
+		nested = true
+	}
+	offset, err := strconv.Atoi(name)
+	if err != nil || offset >= len(names) {
+		return "", false, fmt.Errorf("invalid name offset %s", name)
+	}
+	end := bytes.Index(names[offset:], []byte("/\n"))
+	if end == -1 {
+		return "", false, fmt.Errorf("unterminated name at offset %d", offset)
+	}
+	return string(names[offset : offset+end]), nested, nil
+}
@@ -0,0 +1,75 @@
+package ar
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+// writeArchive writes a regular archive with the given member names & contents.
+func writeArchive(t *testing.T, filename string, members ...string) {
+	var b strings.Builder
+	b.WriteString(arMagic)
+	for i := 0; i < len(members); i += 2 {
+		fmt.Fprintf(&b, "%-16s%-12d%-6d%-6d%-8o%-10d`\n", members[i]+"/", 0, 0, 0, 0644, len(members[i+1]))
+		b.WriteString(members[i+1])
+		if len(members[i+1])%2 == 1 {
+			b.WriteByte('\n')
+		}
+	}
+	require.NoError(t, os.MkdirAll(filepath.Dir(filename), 0755))
+	require.NoError(t, os.WriteFile(filename, []byte(b.String()), 0644))
+}
+
+func TestReadMembers(t *testing.T) {
+	writeArchive(t, "test_members.a", "a.o", "abc", "b.o", "defg")
+	b, err := os.ReadFile("test_members.a")
+	require.NoError(t, err)
+	members, err := readMembers("test_members.a", b)
+	require.NoError(t, err)
+	assert.Equal(t, []member{
+		{Name: "a.o", Src: "test_members.a", Offset: 8 + 60, Size: 3},
+		{Name: "b.o", Src: "test_members.a", Offset: 8 + 60 + 4 + 60, Size: 4},
+	}, members)
+}
+
+func TestCreateThin(t *testing.T) {
+	writeArchive(t, "test_thin/pkg/_lib#a.ar", "a.o", "abc", "b.o", "defg")
+	writeArchive(t, "test_thin/pkg/_lib#c.ar", "c.o", "hi")
+	err := CreateThin([]string{"test_thin/pkg/_lib#a.ar", "test_thin/pkg/_lib#c.ar"}, "test_thin/pkg/lib.a")
+	require.NoError(t, err)
+	assert.True(t, isThin("test_thin/pkg/lib.a"))
+	assert.False(t, isThin("test_thin/pkg/_lib#a.ar"))
+
+	b, err := os.ReadFile("test_thin/pkg/lib.a")
+	require.NoError(t, err)
+	// The members should refer to their source archives & not have any contents of their own.
+	// None of these are objects so it doesn't index anything.
+	assert.Equal(t, thinMagic+fmt.Sprintf("%-16s%-12d%-6d%-6d%-8o%-10d`\n", "/", mtime.Unix(), 0, 0, 0, 4)+"\x00\x00\x00\x00"+
+		fmt.Sprintf("%-48s%-10d`\n", "//", 22)+"_lib#a.ar/\n_lib#c.ar/\n"+
+		fmt.Sprintf("%-16s%-12d%-6d%-6d%-8o%-10d`\n", "/0:8", mtime.Unix(), 0, 0, 0644, 3)+
+		fmt.Sprintf("%-16s%-12d%-6d%-6d%-8o%-10d`\n", "/0:72", mtime.Unix(), 0, 0, 0644, 4)+
+		fmt.Sprintf("%-16s%-12d%-6d%-6d%-8o%-10d`\n", "/11:8", mtime.Unix(), 0, 0, 0644, 2), string(b))
+
+	archives, files, err := expandThin("test_thin/pkg/lib.a")
+	require.NoError(t, err)
+	assert.Equal(t, []string{"test_thin/pkg/_lib#a.ar", "test_thin/pkg/_lib#c.ar"}, archives)
+	assert.Equal(t, 0, len(files))
+}
+
+func TestExpandThinFiles(t *testing.T) {
+	require.NoError(t, os.MkdirAll("test_thin_files", 0755))
+	contents := thinMagic + fmt.Sprintf("%-48s%-10d`\n", "//", 18) + "../a_long_name.o/\n" +
+		fmt.Sprintf("%-16s%-12d%-6d%-6d%-8o%-10d`\n", "/0", 0, 0, 0, 0644, 3) +
+		fmt.Sprintf("%-16s%-12d%-6d%-6d%-8o%-10d`\n", "c.o/", 0, 0, 0, 0644, 4)
+	require.NoError(t, os.WriteFile("test_thin_files/lib.a", []byte(contents), 0644))
+	archives, files, err := expandThin("test_thin_files/lib.a")
+	require.NoError(t, err)
+	assert.Equal(t, 0, len(archives))
+	assert.Equal(t, []string{"a_long_name.o", "test_thin_files/c.o"}, files)
+}
@@ -13,12 +13,15 @@ import (
 	"io/ioutil"
 	"os"
 	"path/filepath"
+	"strings"
 
+	"github.com/klauspost/compress/zstd"
 	"gopkg.in/op/go-logging.v1"
 
 	"github.com/thought-machine/please/src/cli"
 	"github.com/thought-machine/please/src/fs"
 	"github.com/thought-machine/please/tools/jarcat/ar"
+	"github.com/thought-machine/please/tools/jarcat/p1689"
 	"github.com/thought-machine/please/tools/jarcat/tar"
 	"github.com/thought-machine/please/tools/jarcat/unzip"
 	"github.com/thought-machine/please/tools/jarcat/zip"
@@ -114,7 +117,22 @@ var opts = struct {
 		Rename  bool     `short:"r" long:"rename" description:"Rename source files as gcc would (i.e. change extension to .o)"`
 		Combine bool     `short:"c" long:"combine" description:"Treat source files as .a files and combines them"`
 		Find    bool     `short:"f" long:"find" description:"Find all .a files under the current directory & combine those (implies --combine)"`
+		Index   bool     `short:"s" long:"index" description:"Write a symbol index into the archive, as ranlib would. The archive is always written in GNU format."`
+		Thin    bool     `short:"t" long:"thin" description:"Create a thin archive that refers to the members of the source .a files rather than copying them in (implies --combine and --index)"`
 	} `command:"ar" alias:"a" description:"Creates a new ar archive."`
+
+	Modules struct {
+		Scan string            `long:"scan" required:"true" description:"P1689 dependency scan of the source being compiled"`
+		BMIs map[string]string `long:"bmi" key-value-delimiter:"=" description:"Use a different compiled interface in place of one named in the scans"`
+		Args struct {
+			Interfaces []string `positional-arg-name:"interfaces" description:"P1689 dependency scans of the available module interfaces"`
+		} `positional-args:"true"`
+	} `command:"modules" description:"Prints the -fmodule-file flags needed to compile a C++ source, given the dependency scans of it and the available module interfaces."`
+
+	Zstd struct {
+		In  string `short:"i" long:"in" env:"SRCS" description:"File to compress" required:"true"`
+		Out string `short:"o" long:"out" env:"OUT" description:"Output filename" required:"true"`
+	} `command:"zstd" description:"Compresses a single file with zstd."`
 }{
 	Usage: `
 Jarcat is a binary shipped with Please that helps it operate on .jar and .zip files.
@@ -166,6 +184,30 @@ func main() {
 			log.Fatalf("Error extracting zipfile: %s", err)
 		}
 		os.Exit(0)
+	} else if command == "modules" {
+		scan, err := p1689.Load(opts.Modules.Scan)
+		must(err)
+		interfaces := make([]*p1689.File, len(opts.Modules.Args.Interfaces))
+		for i, filename := range opts.Modules.Args.Interfaces {
+			interfaces[i], err = p1689.Load(filename)
+			must(err)
+		}
+		files, err := p1689.ModuleFiles(scan, interfaces)
+		if err != nil {
+			log.Fatalf("%s", err)
+		}
+		for name, file := range files {
+			if bmi, present := opts.Modules.BMIs[file]; present {
+				files[name] = bmi
+			}
+		}
+		fmt.Println(strings.Join(p1689.Flags(files), " "))
+		os.Exit(0)
+	} else if command == "zstd" {
+		if err := compressZstd(opts.Zstd.In, opts.Zstd.Out); err != nil {
+			log.Fatalf("Error compressing %s: %s", opts.Zstd.In, err)
+		}
+		os.Exit(0)
 	} else if command == "ar" {
 		if opts.Ar.Find {
 			srcs, err := ar.Find()
@@ -175,7 +217,13 @@ func main() {
 			opts.Ar.Srcs = srcs
 			opts.Ar.Combine = true
 		}
-		if err := ar.Create(opts.Ar.Srcs, opts.Ar.Out, opts.Ar.Combine, opts.Ar.Rename); err != nil {
+		if opts.Ar.Thin {
+			if err := ar.CreateThin(opts.Ar.Srcs, opts.Ar.Out); err != nil {
+				log.Fatalf("Error creating thin archive: %s", err)
+			}
+			os.Exit(0)
+		}
+		if err := ar.Create(opts.Ar.Srcs, opts.Ar.Out, opts.Ar.Combine, opts.Ar.Rename, opts.Ar.Index); err != nil {
 			log.Fatalf("Error combining archives: %s", err)
 		}
 		os.Exit(0)
@@ -257,3 +305,17 @@ func main() {
 		}
 	}
 }
+
+// compressZstd compresses a single file with zstd. It favours compression over speed since the
+// output is typically embedded somewhere and read many more times than it's written.
+func compressZstd(in, out string) error {
+	b, err := ioutil.ReadFile(in)
+	if err != nil {
+		return err
+	}
+	enc, err := zstd.NewWriter(nil, zstd.WithEncoderLevel(zstd.SpeedBetterCompression))
+	if err != nil {
+		return err
+	}
+	return ioutil.WriteFile(out, enc.EncodeAll(b, nil), 0644)
+}
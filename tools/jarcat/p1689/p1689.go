@@ -0,0 +1,101 @@
+// Package p1689 reads C++ module dependency scans in the P1689 format (as written by
+// clang-scan-deps -format=p1689) and works out which module interfaces a source needs.
+package p1689
+
+import (
+	"encoding/json"
+	"fmt"
+	"os"
+	"sort"
+	"strings"
+)
+
+// A File is the contents of a single P1689 dependency file.
+type File struct {
+	Rules []Rule `json:"rules"`
+}
+
+// A Rule describes the modules that one translation unit provides and requires.
+type Rule struct {
+	PrimaryOutput string   `json:"primary-output"`
+	Provides      []Module `json:"provides"`
+	Requires      []Module `json:"requires"`
+}
+
+// A Module is a reference to a module by its name.
+type Module struct {
+	LogicalName string `json:"logical-name"`
+}
+
+// Load reads a P1689 file.
+func Load(filename string) (*File, error) {
+	b, err := os.ReadFile(filename)
+	if err != nil {
+		return nil, err
+	}
+	f := &File{}
+	if err := json.Unmarshal(b, f); err != nil {
+		return nil, fmt.Errorf("invalid dependency scan %s: %w", filename, err)
+	}
+	return f, nil
+}
+
+// ModuleFiles returns the module interfaces needed to compile the translation unit described by scan,
+// which must be provided by the given scans of module interfaces. The result maps each module's name
+// to the file its interface is compiled to (i.e. its primary output).
+// Modules required by those interfaces are included too, since the compiler needs to find all of them.
+func ModuleFiles(scan *File, interfaces []*File) (map[string]string, error) {
+	providers := map[string]Rule{}
+	for _, f := range interfaces {
+		for _, rule := range f.Rules {
+			for _, provided := range rule.Provides {
+				providers[provided.LogicalName] = rule
+			}
+		}
+	}
+	ret := map[string]string{}
+	var missing []string
+	var require func(rules []Rule, by string)
+	require = func(rules []Rule, by string) {
+		for _, rule := range rules {
+			for _, required := range rule.Requires {
+				name := required.LogicalName
+				if _, present := ret[name]; present || rule.provides(name) {
+					continue
+				}
+				provider, present := providers[name]
+				if !present {
+					missing = append(missing, fmt.Sprintf("%s (imported by %s)", name, by))
+					continue
+				}
+				ret[name] = provider.PrimaryOutput
+				require([]Rule{provider}, name)
+			}
+		}
+	}
+	require(scan.Rules, "this source")
+	if len(missing) > 0 {
+		return nil, fmt.Errorf("no dependency provides modules %s", strings.Join(missing, ", "))
+	}
+	return ret, nil
+}
+
+// provides returns true if this rule provides the given module itself.
+func (rule Rule) provides(name string) bool {
+	for _, provided := range rule.Provides {
+		if provided.LogicalName == name {
+			return true
+		}
+	}
+	return false
+}
+
+// Flags returns the compiler flags that tell it where to find each of the given modules.
+func Flags(files map[string]string) []string {
+	flags := make([]string, 0, len(files))
+	for name, file := range files {
+		flags = append(flags, "-fmodule-file="+name+"="+file)
+	}
+	sort.Strings(flags)
+	return flags
+}
@@ -0,0 +1,53 @@
+package p1689
+
+import (
+	"testing"
+
+	"github.com/stretchr/testify/assert"
+	"github.com/stretchr/testify/require"
+)
+
+func mustLoad(t *testing.T, names ...string) []*File {
+	files := make([]*File, len(names))
+	for i, name := range names {
+		f, err := Load("tools/jarcat/p1689/test_data/" + name + ".ddi")
+		require.NoError(t, err)
+		files[i] = f
+	}
+	return files
+}
+
+func TestModuleFiles(t *testing.T) {
+	// The implementation unit of f1 imports q1, and implicitly requires f1's interface too.
+	// hello is available but not needed so isn't returned.
+	files, err := ModuleFiles(mustLoad(t, "f1_impl")[0], mustLoad(t, "f1", "q1", "hello"))
+	require.NoError(t, err)
+	assert.Equal(t, map[string]string{
+		"f1": "test/modules/f1.pcm",
+		"q1": "test/modules/q1.pcm",
+	}, files)
+	assert.Equal(t, []string{"-fmodule-file=f1=test/modules/f1.pcm", "-fmodule-file=q1=test/modules/q1.pcm"}, Flags(files))
+}
+
+func TestModuleFilesTransitive(t *testing.T) {
+	// q1 is included because f1's interface imports it.
+	files, err := ModuleFiles(&File{Rules: []Rule{{Requires: []Module{{LogicalName: "f1"}}}}}, mustLoad(t, "f1", "q1"))
+	require.NoError(t, err)
+	assert.Equal(t, map[string]string{
+		"f1": "test/modules/f1.pcm",
+		"q1": "test/modules/q1.pcm",
+	}, files)
+}
+
+func TestModuleFilesMissing(t *testing.T) {
+	_, err := ModuleFiles(mustLoad(t, "main")[0], mustLoad(t, "f1", "q1"))
+	assert.Error(t, err)
+	assert.Contains(t, err.Error(), "missing (imported by this source)")
+}
+
+func TestProvidedBySelf(t *testing.T) {
+	// An interface doesn't need its own module.
+	files, err := ModuleFiles(mustLoad(t, "q1")[0], mustLoad(t, "q1"))
+	require.NoError(t, err)
+	assert.Equal(t, 0, len(files))
+}
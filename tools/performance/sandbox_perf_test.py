@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+#
+# Runs a performance test measuring the overhead of starting processes in the sandbox,
+# with both please_sandbox and plz sandbox.
+
+import datetime
+import json
+import subprocess
+
+from third_party.python import colorlog
+from third_party.python.absl import app, flags
+
+handler = colorlog.StreamHandler()
+handler.setFormatter(colorlog.ColoredFormatter('%(log_color)s%(levelname)s: %(message)s'))
+log = colorlog.getLogger(__name__)
+log.addHandler(handler)
+log.propagate = False  # Needed to stop double logging?
+
+flags.DEFINE_string('plz', 'plz', 'Binary to run to invoke plz')
+flags.DEFINE_string('benchmark', 'plz-out/bin/tools/sandbox/spawn_benchmark', 'Sandbox benchmark binary to run')
+flags.DEFINE_string('please_sandbox', 'plz-out/bin/tools/sandbox/please_sandbox', 'please_sandbox binary to test')
+flags.DEFINE_integer('number', 1000, 'Number of processes to start for each set of namespaces')
+flags.DEFINE_integer('parallelism', 1, 'Number of processes to start at once')
+flags.DEFINE_string('output', 'sandbox_results.json', 'File to write results to')
+flags.DEFINE_string('revision', 'unknown', 'Git revision')
+FLAGS = flags.FLAGS
+
+
+def run(name: str, args: list) -> list:
+    """Runs the benchmark against one sandbox command and returns its results."""
+    log.info('Benchmarking %s', name)
+    cmd = [FLAGS.benchmark, '--json', '-n', str(FLAGS.number), '-j', str(FLAGS.parallelism)] + args
+    results = json.loads(subprocess.run(cmd, check=True, stdout=subprocess.PIPE).stdout.decode('utf-8'))
+    for result in results:
+        log.info('network %s, mount %s, sandbox_dirs %s: p50 %0.3fms, p99 %0.3fms, %0.1f runs/s',
+                 result['network'], result['mount'], result['sandbox_dirs'],
+                 result['p50_ms'], result['p99_ms'], result['runs_per_sec'])
+    return results
+
+
+def main(argv):
+    results = {
+        'please_sandbox': run('please_sandbox', [FLAGS.please_sandbox]),
+        # plz sandbox is started in its namespaces by Please, which the benchmark does in its place.
+        'plz_sandbox': run('plz sandbox', ['--namespace', FLAGS.plz, 'sandbox']),
+    }
+    log.info('Generating results')
+    with open(FLAGS.output, 'w') as f:
+        json.dump({
+            'revision': FLAGS.revision,
+            'timestamp': datetime.datetime.now().isoformat(),
+            'sandbox': results,
+        }, f)
+        f.write('\n')
+
+
+if __name__ == '__main__':
+    app.run(main)
@@ -0,0 +1,63 @@
+// env_benchmark is a micro-benchmark of change_env_vars, which rewrites the environment for every
+// sandboxed action. It builds an environment resembling a large build action (hundreds of
+// TOOLS_* / SRCS_* variables, about half of them pointing into the build directory) and reports
+// the average time taken to rewrite it into both a shorter and a longer directory.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "src/sandbox/sandbox.h"
+
+#define NUM_VARS 1000
+#define ITERATIONS 2000
+
+static const char* old_dir = "/home/user/git/please/plz-out/tmp/src/core/core_test._build";
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// reset restores env to the original set of variables. It returns the time taken to do so.
+static double reset(char** env, char* const* original, char* buf) {
+    const double start = now();
+    for (int i = 0; i < NUM_VARS; ++i) {
+        env[i] = strcpy(buf, original[i]);
+        buf += strlen(buf) + 1;
+    }
+    return now() - start;
+}
+
+static void run(char** env, char* const* original, char* buf, const char* new_dir) {
+    double total = 0.0;
+    for (int i = 0; i < ITERATIONS; ++i) {
+        const double overhead = reset(env, original, buf);
+        const double start = now() - overhead;
+        change_env_vars(env, old_dir, new_dir);
+        total += now() - start - overhead;
+    }
+    printf("change_env_vars %d vars -> %s: %.0f ns/op\n", NUM_VARS, new_dir, total / ITERATIONS);
+}
+
+int main() {
+    char* original[NUM_VARS];
+    size_t size = 0;
+    for (int i = 0; i < NUM_VARS; ++i) {
+        char var[512];
+        if (i % 2 == 0) {
+            snprintf(var, sizeof(var), "SRCS_%d=%s/src/core/file_%d.go", i, old_dir, i);
+        } else {
+            snprintf(var, sizeof(var), "TOOLS_%d=/home/user/git/please/plz-out/bin/tools/tool_%d", i, i);
+        }
+        original[i] = strdup(var);
+        size += strlen(var) + 1;
+    }
+    char* env[NUM_VARS + 1];
+    env[NUM_VARS] = NULL;
+    char* buf = malloc(size);
+    run(env, original, buf, "/tmp/plz_sandbox");
+    run(env, original, buf, "/home/user/git/please/plz-out/tmp/src/core/core_test._build/a/much/longer/dir");
+    return 0;
+}
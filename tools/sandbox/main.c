@@ -1,5 +1,6 @@
 // please_sandbox is a very small binary to implement sandboxing
-// of tests (and possibly other build actions) via cgroups.
+// of tests (and possibly other build actions) via namespaces, and
+// optionally to limit their resources via cgroups.
 // Essentially this is a very lightweight replacement for Docker
 // where we would use it for tests to avoid port clashes etc.
 //
@@ -9,16 +10,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "tools/sandbox/sandbox.h"
+#include "src/sandbox/sandbox.h"
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
         fputs("please_sandbox implements sandboxing for Please.\n", stderr);
         fputs("It takes no flags, it simply executes the command given as arguments.\n", stderr);
         fputs("Usage: please_sandbox command args...\n", stderr);
+        fputs("Alternatively it can run as a long-lived server accepting commands on a Unix socket:\n", stderr);
+        fputs("       please_sandbox --server socket_path\n", stderr);
         return 1;
     }
 
+    if (argc == 3 && strcmp(argv[1], "--server") == 0) {
+        return serve(argv[2]);
+    }
+
     // Network namespace is sandboxed by default but it can be opted out if `SHARE_NETWORK=1` env is set
     const char* share_network_env = getenv("SHARE_NETWORK");
     const bool unshare_network = share_network_env == NULL || strcmp(share_network_env, "1");
@@ -4,7 +4,7 @@
 // disabling in order to gain network access (which is by far the most common case for that),
 // but it's still useful to contain the other namespaces.
 #include <stdio.h>
-#include "tools/sandbox/sandbox.h"
+#include "src/sandbox/sandbox.h"
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
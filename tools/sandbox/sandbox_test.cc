@@ -3,7 +3,7 @@
 #include <cstring>
 
 extern "C" {
-#include "tools/sandbox/sandbox.h"
+#include "src/sandbox/sandbox.h"
 }
 
 namespace plz {
@@ -56,4 +56,55 @@ TEST(ChangeEnvVars) {
   CHECK_EQUAL(expected[4], env[4]);
 }
 
+
+TEST(ChangeEnvVarsToLongerDir) {
+  char* env[] = {
+    strdup("TMP_DIR=/tmp/x"),
+    strdup("RESULTS_FILE=/tmp/x/test.results"),
+    strdup("OTHER=/tmp/y"),
+    strdup("PATH=/usr/bin:/tmp/x/bin"),
+    NULL
+  };
+  change_env_vars(env, "/tmp/x", "/tmp/plz_sandbox");
+  CHECK_EQUAL("TMP_DIR=/tmp/plz_sandbox", env[0]);
+  CHECK_EQUAL("RESULTS_FILE=/tmp/plz_sandbox/test.results", env[1]);
+  CHECK_EQUAL("OTHER=/tmp/y", env[2]);
+  CHECK_EQUAL("PATH=/usr/bin:/tmp/x/bin", env[3]);
+  CHECK(env[4] == NULL);
+}
+
+TEST(ChangeEnvVarsToSameLengthDir) {
+  char* env[] = {
+    strdup("TMP_DIR=/tmp/abc/x"),
+    strdup("EMPTY="),
+    NULL
+  };
+  change_env_vars(env, "/tmp/abc", "/tmp/xyz");
+  CHECK_EQUAL("TMP_DIR=/tmp/xyz/x", env[0]);
+  CHECK_EQUAL("EMPTY=", env[1]);
+}
+
+TEST(ChangeEnvVarsAliasingOldDir) {
+  // The old dir usually comes from getenv("TMP_DIR"), so points into one of the variables being changed.
+  char* env[] = {
+    strdup("TMP_DIR=/home/peter/git/please/plz-out/tmp/my_test"),
+    strdup("RESULTS_FILE=/home/peter/git/please/plz-out/tmp/my_test/test.results"),
+    NULL
+  };
+  change_env_vars(env, env[0] + strlen("TMP_DIR="), "/tmp/plz_sandbox");
+  CHECK_EQUAL("TMP_DIR=/tmp/plz_sandbox", env[0]);
+  CHECK_EQUAL("RESULTS_FILE=/tmp/plz_sandbox/test.results", env[1]);
+}
+
+TEST(ChangeEnvVarsAliasingOldDirToLongerDir) {
+  char* env[] = {
+    strdup("TMP_DIR=/tmp/x"),
+    strdup("RESULTS_FILE=/tmp/x/test.results"),
+    NULL
+  };
+  change_env_vars(env, env[0] + strlen("TMP_DIR="), "/tmp/plz_sandbox");
+  CHECK_EQUAL("TMP_DIR=/tmp/plz_sandbox", env[0]);
+  CHECK_EQUAL("RESULTS_FILE=/tmp/plz_sandbox/test.results", env[1]);
+}
+
 }
@@ -0,0 +1,260 @@
+// spawn_benchmark measures the overhead of starting a process in the sandbox, which is paid by
+// every sandboxed action. It repeatedly runs /bin/true under the given sandbox command (e.g.
+// please_sandbox, or plz sandbox) for each combination of SHARE_NETWORK, SHARE_MOUNT and
+// SANDBOX_DIRS, and reports percentiles of the time from spawning the command to its exit along
+// with the throughput achieved.
+//
+// plz sandbox expects Please to have already started it in new namespaces; --namespace does the
+// same here, with the same flags as Please uses (see ExecCommand in src/process/exec_linux.go).
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STACK_SIZE (64 * 1024)
+#define WARMUP 10
+#define MAX_ARGS 64
+
+// A benchmark is one combination of namespaces to run the command with.
+typedef struct {
+    char* argv[MAX_ARGS + 2];
+    char* envp[5];
+    int flags;
+    uid_t uid;
+    gid_t gid;
+    bool namespace;
+    bool net, mount, dirs;
+    int iterations;
+    int next;
+    double* samples;
+} benchmark;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int write_file(const char* path, const char* contents) {
+    const int fd = open(path, O_WRONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    const ssize_t len = strlen(contents);
+    const ssize_t n = write(fd, contents, len);
+    close(fd);
+    return n == len ? 0 : -1;
+}
+
+// child is the entry point of each spawned process. In a new user namespace it maps its ids
+// to root, as Please does, and then execs the command.
+static int child(void* p) {
+    const benchmark* b = p;
+    if (b->namespace) {
+        char map[64];
+        snprintf(map, sizeof(map), "0 %d 1\n", b->uid);
+        if (write_file("/proc/self/uid_map", map) != 0 || write_file("/proc/self/setgroups", "deny") != 0) {
+            perror("map uid");
+            return 126;
+        }
+        snprintf(map, sizeof(map), "0 %d 1\n", b->gid);
+        if (write_file("/proc/self/gid_map", map) != 0) {
+            perror("map gid");
+            return 126;
+        }
+    }
+    execvpe(b->argv[0], b->argv, b->envp);
+    perror("exec");
+    return 127;
+}
+
+// spawn_one runs the command once and returns the time taken in nanoseconds, or -1 on failure.
+static double spawn_one(benchmark* b, char* stack) {
+    const double start = now();
+    const pid_t pid = clone(child, stack + STACK_SIZE, b->flags | SIGCHLD, b);
+    if (pid == -1) {
+        perror("clone");
+        return -1;
+    }
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        perror("waitpid");
+        return -1;
+    }
+    const double duration = now() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s exited with status %d\n", b->argv[0], WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return -1;
+    }
+    return duration;
+}
+
+static void* worker(void* p) {
+    benchmark* b = p;
+    char* stack = malloc(STACK_SIZE);
+    for (int i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED); i < b->iterations;
+         i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED)) {
+        if ((b->samples[i] = spawn_one(b, stack)) < 0) {
+            exit(1);
+        }
+    }
+    free(stack);
+    return NULL;
+}
+
+static int compare(const void* a, const void* b) {
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int n, int p) {
+    return sorted[(n - 1) * p / 100] / 1e6;
+}
+
+// run runs one benchmark with the given number of workers and prints its results.
+static void run(benchmark* b, int parallelism, bool json, bool first) {
+    char* stack = malloc(STACK_SIZE);
+    for (int i = 0; i < WARMUP; ++i) {
+        if (spawn_one(b, stack) < 0) {
+            exit(1);
+        }
+    }
+    free(stack);
+    b->next = 0;
+    pthread_t threads[parallelism];
+    const double start = now();
+    for (int i = 0; i < parallelism; ++i) {
+        pthread_create(&threads[i], NULL, worker, b);
+    }
+    for (int i = 0; i < parallelism; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    const double elapsed = now() - start;
+    qsort(b->samples, b->iterations, sizeof(double), compare);
+    const double throughput = b->iterations / (elapsed / 1e9);
+    if (json) {
+        printf("%s\n  {\"network\": %s, \"mount\": %s, \"sandbox_dirs\": %s, \"runs\": %d, \"parallelism\": %d, "
+               "\"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f, \"runs_per_sec\": %.1f}",
+               first ? "[" : ",", b->net ? "true" : "false", b->mount ? "true" : "false", b->dirs ? "true" : "false",
+               b->iterations, parallelism, percentile(b->samples, b->iterations, 50),
+               percentile(b->samples, b->iterations, 90), percentile(b->samples, b->iterations, 99),
+               percentile(b->samples, b->iterations, 100), throughput);
+    } else {
+        printf("network %-6s mount %-6s sandbox_dirs %-3s: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms, %.1f runs/s\n",
+               b->net ? "new" : "shared", b->mount ? "new" : "shared", b->dirs ? "yes" : "no",
+               percentile(b->samples, b->iterations, 50), percentile(b->samples, b->iterations, 90),
+               percentile(b->samples, b->iterations, 99), percentile(b->samples, b->iterations, 100), throughput);
+    }
+}
+
+static void usage() {
+    fputs("Usage: spawn_benchmark [-n iterations] [-j parallelism] [--namespace] [--json] command args...\n", stderr);
+    fputs("Runs /bin/true under the given sandbox command, e.g. please_sandbox or plz sandbox.\n", stderr);
+    fputs("  -n, --iterations   Number of times to run it for each set of namespaces (default 1000)\n", stderr);
+    fputs("  -j, --parallelism  Number to run at once (default 1)\n", stderr);
+    fputs("  --namespace        Start the command in new namespaces as Please does, as plz sandbox needs\n", stderr);
+    fputs("  --json             Write the results as JSON\n", stderr);
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option options[] = {
+        {"iterations", required_argument, NULL, 'n'},
+        {"parallelism", required_argument, NULL, 'j'},
+        {"namespace", no_argument, NULL, 'N'},
+        {"json", no_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0},
+    };
+    int iterations = 1000, parallelism = 1, opt;
+    bool namespace = false, json = false;
+    while ((opt = getopt_long(argc, argv, "+n:j:", options, NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'j':
+            parallelism = atoi(optarg);
+            break;
+        case 'N':
+            namespace = true;
+            break;
+        case 'J':
+            json = true;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (optind == argc || argc - optind > MAX_ARGS || iterations < 1 || parallelism < 1) {
+        usage();
+        return 1;
+    }
+
+    // The directories are made in the current one rather than /tmp, since (like the build directories
+    // under plz-out) TMP_DIR has to be elsewhere for the sandbox to mount its own /tmp.
+    char cwd[PATH_MAX], tmp_dir[PATH_MAX + 32], masked_dir[PATH_MAX + 32];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        perror("getcwd");
+        return 1;
+    }
+    snprintf(tmp_dir, sizeof(tmp_dir), "%s/.spawn_benchmark_XXXXXX", cwd);
+    snprintf(masked_dir, sizeof(masked_dir), "%s/.spawn_benchmark_masked_XXXXXX", cwd);
+    if (!mkdtemp(tmp_dir) || !mkdtemp(masked_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char tmp_var[sizeof(tmp_dir) + 8], dirs_var[sizeof(masked_dir) + 13];
+    snprintf(tmp_var, sizeof(tmp_var), "TMP_DIR=%s", tmp_dir);
+    snprintf(dirs_var, sizeof(dirs_var), "SANDBOX_DIRS=%s", masked_dir);
+
+    benchmark b = {
+        .uid = getuid(),
+        .gid = getgid(),
+        .namespace = namespace,
+        .iterations = iterations,
+        .samples = malloc(iterations * sizeof(double)),
+    };
+    for (int i = optind; i < argc; ++i) {
+        b.argv[i - optind] = argv[i];
+    }
+    b.argv[argc - optind] = "/bin/true";
+    bool first = true;
+    for (int net = 1; net >= 0; --net) {
+        for (int mount = 1; mount >= 0; --mount) {
+            // $SANDBOX_DIRS only has any effect in a new mount namespace.
+            for (int dirs = 0; dirs <= mount; ++dirs) {
+                b.net = net;
+                b.mount = mount;
+                b.dirs = dirs;
+                b.flags = 0;
+                if (namespace) {
+                    b.flags = CLONE_NEWUSER | CLONE_NEWUTS | CLONE_NEWIPC | CLONE_NEWPID;
+                    b.flags |= (net ? CLONE_NEWNET : 0) | (mount ? CLONE_NEWNS : 0);
+                }
+                b.envp[0] = tmp_var;
+                b.envp[1] = net ? "SHARE_NETWORK=0" : "SHARE_NETWORK=1";
+                b.envp[2] = mount ? "SHARE_MOUNT=0" : "SHARE_MOUNT=1";
+                b.envp[3] = dirs ? dirs_var : NULL;
+                b.envp[4] = NULL;
+                run(&b, parallelism, json, first);
+                first = false;
+            }
+        }
+    }
+    if (json) {
+        puts("\n]");
+    }
+    rmdir(tmp_dir);
+    rmdir(masked_dir);
+    return 0;
+}